@@ -0,0 +1,67 @@
+// Throughput of each residue encoding kernel on a synthetic FASTA body.
+//
+//   ./bench_encoder [megabytes]
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "residue_encoder.hpp"
+
+
+// 60-column sequence lines with the occasional X, like a UniProt record body.
+std::string make_fasta_body(size_t size) {
+  std::mt19937 rng(42);
+  std::uniform_int_distribution<int> letter(0, 19);
+  std::uniform_int_distribution<int> rare(0, 999);
+  std::string body;
+  body.reserve(size);
+  while (body.size() < size) {
+    for (int i = 0; i < 60 && body.size() < size; i++) {
+      body.push_back(rare(rng) == 0 ? 'X' : kAlphabet[letter(rng)]);
+    }
+    body.push_back('\n');
+  }
+  return body;
+}
+
+
+int main(int argc, char** argv) {
+  size_t megabytes = argc > 1 ? std::stoul(argv[1]) : 256;
+  std::string body = make_fasta_body(megabytes << 20);
+  std::vector<uint8_t> expected(body.size());
+  std::vector<uint8_t> codes(body.size());
+  size_t expected_count = encode_residues(EncoderIsa::kScalar, body.data(),
+                                          body.size(), expected.data());
+
+  std::cout << "input " << megabytes << " MB, " << expected_count
+            << " residues" << std::endl;
+  for (EncoderIsa isa: {EncoderIsa::kScalar, EncoderIsa::kSse42,
+                        EncoderIsa::kAvx2, EncoderIsa::kAvx512}) {
+    if (!encoder_isa_supported(isa)) {
+      std::cout << encoder_isa_name(isa) << "\tnot supported" << std::endl;
+      continue;
+    }
+    double best = 0;
+    size_t count = 0;
+    for (int rep = 0; rep < 5; rep++) {
+      auto start = std::chrono::steady_clock::now();
+      count = encode_residues(isa, body.data(), body.size(), codes.data());
+      std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+      best = std::max(best, body.size() / elapsed.count() / 1e9);
+    }
+    bool matches = count == expected_count &&
+      memcmp(codes.data(), expected.data(), count) == 0;
+    std::cout << encoder_isa_name(isa) << "\t" << best << " GB/s"
+              << (matches ? "" : "\tMISMATCH") << std::endl;
+    if (!matches) {
+      return 1;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,219 @@
+// Load time of a SequenceStore archive with one-byte, 5-bit packed and
+// rANS coded residues, open time of the same sequences in a container
+// through MappedContainer and through the header-only Reader, throughput of
+// verifying it, of reversing byte order and of each unpack kernel. The
+// files are written next to path; point it at the storage the proteomes
+// live on.
+//
+//   ./bench_load [megabytes] [path]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <cereal/types/vector.hpp>
+#include <cereal/archives/binary.hpp>
+
+#include "container.hpp"
+#include "converge_encoder/reader.hpp"
+#include "crc32c.hpp"
+#include "residue_packing.hpp"
+#include "sequence_store.hpp"
+
+
+// Sequences of 50-1500 random residues, about size residues in all. They
+// are uniform, so rANS sizes here are a worst case: real proteomes have
+// skewed residue and context frequencies.
+SequenceStore make_sequences(size_t size) {
+  std::mt19937 rng(42);
+  std::uniform_int_distribution<int> letter(0, 19);
+  std::uniform_int_distribution<int> length(50, 1500);
+  SequenceStore sequences;
+  std::vector<Residue> seq;
+  while (sequences.total_residues() < size) {
+    seq.resize(length(rng));
+    for (Residue& residue: seq) {
+      residue = static_cast<Residue>(letter(rng));
+    }
+    sequences.push_back(seq.data(), seq.size());
+  }
+  return sequences;
+}
+
+
+size_t file_size(const std::string& filename) {
+  std::ifstream file(filename, std::ios_base::binary | std::ios_base::ate);
+  return static_cast<size_t>(file.tellg());
+}
+
+
+int main(int argc, char** argv) {
+  size_t megabytes = argc > 1 ? std::stoul(argv[1]) : 256;
+  std::string path = argc > 2 ? argv[2] : "bench_load";
+  SequenceStore expected = make_sequences(megabytes << 20);
+  size_t residues = expected.total_residues();
+  std::cout << "input " << residues << " residues, " << expected.size()
+            << " sequences" << std::endl;
+
+  for (ResidueEncoding encoding: {ResidueEncoding::kBytes,
+                                  ResidueEncoding::kPacked,
+                                  ResidueEncoding::kRans}) {
+    const char* name = encoding == ResidueEncoding::kBytes ? "bytes" :
+                       encoding == ResidueEncoding::kPacked ? "packed" :
+                       "rans";
+    std::string filename = path + "." + name;
+    expected.set_encoding(encoding);
+    {
+      std::ofstream file(filename, std::ios_base::binary);
+      cereal::BinaryOutputArchive archive(file);
+      archive(expected);
+    }
+    double best = 1e300;
+    bool matches = true;
+    for (int rep = 0; rep < 3; rep++) {
+      SequenceStore sequences;
+      auto start = std::chrono::steady_clock::now();
+      {
+        std::ifstream file(filename, std::ios_base::binary);
+        cereal::BinaryInputArchive archive(file);
+        archive(sequences);
+      }
+      std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+      best = std::min(best, elapsed.count());
+      matches = matches && sequences == expected;
+    }
+    size_t size = file_size(filename);
+    std::remove(filename.c_str());
+    std::cout << name << "\t" << size / 1e6 << " MB\tload " << best
+              << " s\t" << residues / best / 1e9 << " Gresidues/s"
+              << (matches ? "" : "\tMISMATCH") << std::endl;
+    if (!matches) {
+      return 1;
+    }
+  }
+
+  // A container is usable as soon as it is mapped; the view check walks the
+  // sequences, so it is left out of the timing.
+  std::string filename = path + ".container";
+  {
+    ContainerWriter container(filename);
+    container.add_sequences(SectionId::kSequenceOffsets, SectionId::kResidues,
+                            expected);
+    container.close();
+  }
+  double best = 1e300;
+  bool matches = true;
+  for (int rep = 0; rep < 3; rep++) {
+    auto start = std::chrono::steady_clock::now();
+    MappedContainer container(filename);
+    SequenceView sequences = container.sequences();
+    std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+    best = std::min(best, elapsed.count());
+    matches = matches && sequences.size() == expected.size() &&
+      memcmp(sequences.residues, expected.residues().data(), residues) == 0;
+  }
+  std::cout << "container\t" << file_size(filename) / 1e6 << " MB\topen "
+            << best << " s" << (matches ? "" : "\tMISMATCH") << std::endl;
+  if (!matches) {
+    std::remove(filename.c_str());
+    return 1;
+  }
+
+  best = 1e300;
+  for (int rep = 0; rep < 3; rep++) {
+    auto start = std::chrono::steady_clock::now();
+    converge_encoder::Reader reader(filename.c_str());
+    converge_encoder::ProteomeView proteome = reader.proteome();
+    std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+    best = std::min(best, elapsed.count());
+    matches = matches && proteome.size() == expected.size() &&
+      proteome.total_residues() == residues;
+    for (size_t i = 0; matches && i < proteome.size(); i++) {
+      matches = proteome[i].size() == expected[i].size &&
+        memcmp(proteome[i].data(), expected[i].data, expected[i].size) == 0;
+    }
+  }
+  std::cout << "reader\t" << file_size(filename) / 1e6 << " MB\topen "
+            << best << " s" << (matches ? "" : "\tMISMATCH") << std::endl;
+  if (!matches) {
+    std::remove(filename.c_str());
+    return 1;
+  }
+
+  // Verification is bound by how fast the sections stream through the CRC,
+  // so a warm page cache shows the kernel's throughput.
+  best = 1e300;
+  bool intact = true;
+  for (int rep = 0; rep < 3; rep++) {
+    MappedContainer container(filename);
+    auto start = std::chrono::steady_clock::now();
+    intact = container.verify() && intact;
+    std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+    best = std::min(best, elapsed.count());
+  }
+  std::cout << "verify " << crc32c_implementation() << "\t"
+            << file_size(filename) / best / 1e9 << " GB/s"
+            << (intact ? "" : "\tCORRUPT") << std::endl;
+  std::remove(filename.c_str());
+  if (!intact) {
+    return 1;
+  }
+
+  // What opening a container from a host of the other byte order adds:
+  // reversing its 8-byte words in place.
+  std::vector<uint64_t> words(residues / sizeof(uint64_t));
+  memcpy(words.data(), expected.residues().data(),
+         words.size() * sizeof(uint64_t));
+  best = 1e300;
+  for (int rep = 0; rep < 4; rep++) {
+    auto start = std::chrono::steady_clock::now();
+    reverse_bytes(words.data(), words.size(), sizeof(uint64_t));
+    std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+    best = std::min(best, elapsed.count());
+  }
+  matches = memcmp(words.data(), expected.residues().data(),
+                   words.size() * sizeof(uint64_t)) == 0;
+  std::cout << "reverse bytes\t" << words.size() * sizeof(uint64_t) / best / 1e9
+            << " GB/s" << (matches ? "" : "\tMISMATCH") << std::endl;
+  if (!matches) {
+    return 1;
+  }
+
+  std::vector<uint8_t> packed(packed_size(residues));
+  pack_residues(expected.residues().data(), residues, packed.data());
+  std::vector<uint8_t> codes(residues);
+  for (EncoderIsa isa: {EncoderIsa::kScalar, EncoderIsa::kSse42,
+                        EncoderIsa::kAvx2, EncoderIsa::kAvx512}) {
+    if (!encoder_isa_supported(isa)) {
+      std::cout << encoder_isa_name(isa) << "\tnot supported" << std::endl;
+      continue;
+    }
+    double best = 0;
+    for (int rep = 0; rep < 5; rep++) {
+      auto start = std::chrono::steady_clock::now();
+      unpack_residues(isa, packed.data(), residues, codes.data());
+      std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+      best = std::max(best, residues / elapsed.count() / 1e9);
+    }
+    bool matches =
+      memcmp(codes.data(), expected.residues().data(), residues) == 0;
+    std::cout << "unpack " << encoder_isa_name(isa) << "\t" << best
+              << " Gresidues/s" << (matches ? "" : "\tMISMATCH") << std::endl;
+    if (!matches) {
+      return 1;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,78 @@
+// Scaling of parse_fasta_parallel() over a synthetic proteome held in
+// memory, at 1/2/4/8/16/32 threads.
+//
+//   ./bench_parse [megabytes]
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "fasta_parser.hpp"
+#include "residue_encoder.hpp"
+
+
+// UniProt-like records: a header line, then 60-column sequence lines.
+std::string make_proteome(size_t size) {
+  std::mt19937 rng(42);
+  std::uniform_int_distribution<int> letter(0, 19);
+  std::uniform_int_distribution<int> length(50, 1500);
+  std::string fasta;
+  fasta.reserve(size + 2048);
+  for (size_t record = 0; fasta.size() < size; record++) {
+    fasta += ">sp|P" + std::to_string(record) + "|PROT" +
+             std::to_string(record) + "_HUMAN Synthetic protein\n";
+    int residues = length(rng);
+    for (int i = 0; i < residues; i++) {
+      fasta.push_back(kAlphabet[letter(rng)]);
+      if (i % 60 == 59 || i + 1 == residues) {
+        fasta.push_back('\n');
+      }
+    }
+  }
+  return fasta;
+}
+
+
+int main(int argc, char** argv) {
+  size_t megabytes = argc > 1 ? std::stoul(argv[1]) : 256;
+  std::string fasta = make_proteome(megabytes << 20);
+  const char* begin = fasta.data();
+  const char* end = begin + fasta.size();
+
+  HeaderStore expected_headers;
+  SequenceStore expected_sequences;
+  parse_fasta(begin, end, expected_headers, expected_sequences);
+  std::cout << "input " << megabytes << " MB, " << expected_sequences.size()
+            << " records" << std::endl;
+
+  double serial_seconds = 0;
+  for (size_t threads: {1, 2, 4, 8, 16, 32}) {
+    double best = 1e300;
+    bool matches = true;
+    for (int rep = 0; rep < 3; rep++) {
+      HeaderStore headers;
+      SequenceStore sequences;
+      auto start = std::chrono::steady_clock::now();
+      parse_fasta_parallel(begin, end, headers, sequences, threads);
+      std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+      best = std::min(best, elapsed.count());
+      matches = matches && headers == expected_headers &&
+                sequences == expected_sequences;
+    }
+    if (threads == 1) {
+      serial_seconds = best;
+    }
+    std::cout << threads << " threads\t" << best << " s\t"
+              << fasta.size() / best / 1e9 << " GB/s\tspeedup "
+              << serial_seconds / best << (matches ? "" : "\tMISMATCH")
+              << std::endl;
+    if (!matches) {
+      return 1;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,104 @@
+// Seed window extraction throughput over random sequences, for the widths
+// with a fixed-size kernel and for neighbours that take the generic loop:
+// copying each window out, and locating it as SeedSets does. Then every
+// fixed-size width at once in one pass over the sequences, against one
+// pass per width.
+//
+//   ./bench_seeds [megabytes]
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "seed_windows.hpp"
+#include "sequence_store.hpp"
+
+
+int main(int argc, char** argv) {
+  size_t megabytes = argc > 1 ? std::stoul(argv[1]) : 64;
+  std::mt19937 rng(42);
+  std::uniform_int_distribution<int> letter(0, 19);
+  std::uniform_int_distribution<int> length(50, 1500);
+  SequenceStore sequences;
+  while (sequences.total_residues() < megabytes << 20) {
+    std::vector<Residue> residues(length(rng));
+    for (Residue& residue: residues) {
+      residue = static_cast<Residue>(letter(rng));
+    }
+    sequences.push_back(residues.data(), residues.size());
+  }
+  std::cout << "input " << megabytes << " MB, " << sequences.size()
+            << " sequences, stride 10" << std::endl;
+
+  for (size_t width: {8, 9, 12, 13, 16, 17, 20, 21, 30, 31, 40, 41}) {
+    SeedWindowing windowing{width, 10};
+    double best = 1e300;
+    size_t windows = 0;
+    for (int rep = 0; rep < 3; rep++) {
+      SequenceStore seeds;
+      auto start = std::chrono::steady_clock::now();
+      for (size_t i = 0; i < sequences.size(); i++) {
+        split_windows(sequences[i], windowing, seeds);
+      }
+      std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+      best = std::min(best, elapsed.count());
+      windows = seeds.size();
+    }
+    double positions_best = 1e300;
+    for (int rep = 0; rep < 3; rep++) {
+      SequenceStore sources = sequences;
+      auto start = std::chrono::steady_clock::now();
+      SeedSets seeds(std::move(sources), {windowing});
+      std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+      positions_best = std::min(positions_best, elapsed.count());
+      if (seeds[0].size() != windows) {
+        std::cout << "width " << width << " MISMATCH" << std::endl;
+        return 1;
+      }
+    }
+    std::cout << "width " << width << "\tcopies " << best << " s\t"
+              << windows / best / 1e6 << " M windows/s\tpositions "
+              << positions_best << " s\t"
+              << windows / positions_best / 1e6 << " M windows/s"
+              << std::endl;
+  }
+
+  std::vector<SeedWindowing> windowings{{8, 4}, {12, 6}, {16, 8}, {20, 10},
+                                        {30, 10}, {40, 20}};
+  double separate_best = 1e300;
+  double together_best = 1e300;
+  for (int rep = 0; rep < 3; rep++) {
+    double separate = 0;
+    size_t separate_windows = 0;
+    for (const SeedWindowing& windowing: windowings) {
+      SequenceStore sources = sequences;
+      auto start = std::chrono::steady_clock::now();
+      SeedSets seeds(std::move(sources), {windowing});
+      std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+      separate += elapsed.count();
+      separate_windows += seeds.window_count();
+    }
+    separate_best = std::min(separate_best, separate);
+    SequenceStore sources = sequences;
+    auto start = std::chrono::steady_clock::now();
+    SeedSets seeds(std::move(sources), windowings);
+    std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+    together_best = std::min(together_best, elapsed.count());
+    if (seeds.window_count() != separate_windows) {
+      std::cout << "all widths MISMATCH" << std::endl;
+      return 1;
+    }
+  }
+  std::cout << windowings.size() << " widths\tone pass each "
+            << separate_best << " s\tone pass " << together_best << " s"
+            << std::endl;
+  return 0;
+}
@@ -0,0 +1,153 @@
+#ifndef CONVERGE_ENCODER_BYTE_ORDER_HPP_
+#define CONVERGE_ENCODER_BYTE_ORDER_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#elif defined(__GNUC__) && defined(__VSX__)
+#include <altivec.h>
+// Not the C++ keywords: altivec.h defines these for C.
+#undef bool
+#undef vector
+#undef pixel
+#endif
+
+// Containers are written in the writer's byte order, which the header
+// records as kByteOrderMark. A reader on a host of the other order reverses
+// each multi-byte element once, a whole section at a time, rather than
+// converting element by element as a portable archive does.
+constexpr uint32_t kByteOrderMark = 0x01020304;
+constexpr bool kHostLittleEndian =
+  __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__;
+
+namespace byte_order_detail {
+
+template <class T, T (*Swap)(T)>
+inline void reverse_scalar(uint8_t* p, size_t count) {
+  for (size_t i = 0; i < count; i++, p += sizeof(T)) {
+    T value;
+    memcpy(&value, p, sizeof(T));
+    value = Swap(value);
+    memcpy(p, &value, sizeof(T));
+  }
+}
+
+inline uint16_t bswap16(uint16_t value) { return __builtin_bswap16(value); }
+inline uint32_t bswap32(uint32_t value) { return __builtin_bswap32(value); }
+inline uint64_t bswap64(uint64_t value) { return __builtin_bswap64(value); }
+
+inline void reverse_elements(uint8_t* p, size_t count, size_t element_size) {
+  switch (element_size) {
+    case 2: reverse_scalar<uint16_t, bswap16>(p, count); break;
+    case 4: reverse_scalar<uint32_t, bswap32>(p, count); break;
+    case 8: reverse_scalar<uint64_t, bswap64>(p, count); break;
+    default:
+      for (size_t i = 0; i < count; i++, p += element_size) {
+        for (size_t lo = 0, hi = element_size - 1; lo < hi; lo++, hi--) {
+          uint8_t byte = p[lo];
+          p[lo] = p[hi];
+          p[hi] = byte;
+        }
+      }
+  }
+}
+
+// Shuffle that reverses each element_size-byte group of a 16-byte lane.
+inline void reverse_shuffle(size_t element_size, uint8_t order[16]) {
+  for (size_t i = 0; i < 16; i++) {
+    order[i] = static_cast<uint8_t>(
+      i / element_size * element_size + element_size - 1 - i % element_size);
+  }
+}
+
+#if defined(__GNUC__) && defined(__x86_64__)
+
+// The kernels return how many elements they reversed; the rest of the
+// section is left to reverse_elements().
+__attribute__((target("ssse3")))
+inline size_t reverse_ssse3(uint8_t* p, size_t count, size_t element_size) {
+  uint8_t order[16];
+  reverse_shuffle(element_size, order);
+  __m128i shuffle = _mm_loadu_si128(reinterpret_cast<const __m128i*>(order));
+  size_t bytes = count * element_size / 16 * 16;
+  for (size_t i = 0; i < bytes; i += 16) {
+    __m128i* block = reinterpret_cast<__m128i*>(p + i);
+    _mm_storeu_si128(block, _mm_shuffle_epi8(_mm_loadu_si128(block), shuffle));
+  }
+  return bytes / element_size;
+}
+
+__attribute__((target("avx2")))
+inline size_t reverse_avx2(uint8_t* p, size_t count, size_t element_size) {
+  uint8_t order[16];
+  reverse_shuffle(element_size, order);
+  __m256i shuffle = _mm256_broadcastsi128_si256(
+    _mm_loadu_si128(reinterpret_cast<const __m128i*>(order)));
+  size_t bytes = count * element_size / 32 * 32;
+  for (size_t i = 0; i < bytes; i += 32) {
+    __m256i* block = reinterpret_cast<__m256i*>(p + i);
+    _mm256_storeu_si256(
+      block, _mm256_shuffle_epi8(_mm256_loadu_si256(block), shuffle));
+  }
+  return bytes / element_size;
+}
+
+#elif defined(__GNUC__) && defined(__VSX__)
+
+// POWER7 and later, either byte order: vec_perm numbers bytes in memory
+// order under both, so the same shuffle applies.
+inline size_t reverse_vsx(uint8_t* p, size_t count, size_t element_size) {
+  uint8_t order[16];
+  reverse_shuffle(element_size, order);
+  __vector unsigned char shuffle = vec_xl(0, order);
+  size_t bytes = count * element_size / 16 * 16;
+  for (size_t i = 0; i < bytes; i += 16) {
+    __vector unsigned char block = vec_xl(0, p + i);
+    vec_xst(vec_perm(block, block, shuffle), 0, p + i);
+  }
+  return bytes / element_size;
+}
+
+#endif
+
+}  // namespace byte_order_detail
+
+
+// Reverses the bytes of each of the count elements of element_size bytes
+// at data. 2-, 4- and 8-byte elements use the widest shuffle the CPU has:
+// AVX2 or SSSE3 on x86-64, VSX on POWER. Elsewhere, and for other element
+// sizes, they are swapped one at a time.
+inline void reverse_bytes(void* data, size_t count, size_t element_size) {
+  auto p = static_cast<uint8_t*>(data);
+  if (element_size < 2) {
+    return;
+  }
+  size_t done = 0;
+#if defined(__GNUC__) && defined(__x86_64__)
+  if (element_size == 2 || element_size == 4 || element_size == 8) {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+      done = byte_order_detail::reverse_avx2(p, count, element_size);
+    } else if (__builtin_cpu_supports("ssse3")) {
+      done = byte_order_detail::reverse_ssse3(p, count, element_size);
+    }
+  }
+#elif defined(__GNUC__) && defined(__VSX__)
+  if (element_size == 2 || element_size == 4 || element_size == 8) {
+    done = byte_order_detail::reverse_vsx(p, count, element_size);
+  }
+#endif
+  byte_order_detail::reverse_elements(p + done * element_size, count - done,
+                                      element_size);
+}
+
+
+template <class T>
+inline void reverse_bytes(T& value) {
+  reverse_bytes(&value, 1, sizeof(T));
+}
+
+#endif  // CONVERGE_ENCODER_BYTE_ORDER_HPP_
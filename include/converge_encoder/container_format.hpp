@@ -0,0 +1,176 @@
+#ifndef CONVERGE_ENCODER_CONTAINER_FORMAT_HPP_
+#define CONVERGE_ENCODER_CONTAINER_FORMAT_HPP_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "converge_encoder/byte_order.hpp"
+
+// Single-file layout of everything converge loads, usable in place from a
+// read-only mapping instead of being deserialized:
+//
+//   ContainerHeader      64 bytes at offset 0
+//   sections             each starting on a 64-byte boundary
+//   SectionEntry[]       the directory, 64-byte aligned after the last
+//                        section
+//
+// Sections are raw arrays in the writer's byte order; CSR columns are split
+// into an offsets section (uint64_t, one more than the entry count) and an
+// elements section.
+//
+// Since version 2 every section carries the CRC32C of its bytes, and the
+// header and directory carry their own, so a container can be checked by
+// streaming through it once. Version 1 files, which have none, still open.
+//
+// Since version 3 the header records the writer's byte order and word
+// sizes. Earlier versions were always little-endian with 8-byte words.
+//
+// Since version 4 a container grows by segments. Appending writes the new
+// sequences and their headers as sections tagged with the next segment
+// number after the existing ones, followed by a new directory; segment 0
+// is what the container was first written with. Sequence numbers run on
+// across segments. A tombstone bitmap marks deleted sequences until a
+// compaction drops them. Of the manifest and the bitmap, which describe
+// the whole container, the one of the highest segment holds.
+//
+// Since version 5 the seed sections hold the seed sequences once and a
+// windows section locates each seed window in them, instead of a copy of
+// every window. Without a windows section the seed sections are the
+// windows themselves.
+//
+// Since version 6 there may be several window sets, of different lengths
+// and strides, cut from the same seed sequences. Their windows follow one
+// another in the windows section, and a seed set section records where
+// each set's run starts. Without one there is a single set, whose length
+// and stride are in the manifest.
+
+constexpr char kContainerMagic[8] = {'C', 'V', 'G', 'E', 'N', 'C', '\r',
+                                     '\n'};
+constexpr uint32_t kContainerVersion = 6;
+constexpr size_t kSectionAlignment = 64;
+
+enum class SectionId : uint32_t {
+  kSequenceOffsets = 1,
+  kResidues = 2,
+  kHeaderOffsets = 3,
+  kHeaders = 4,
+  kDatabaseOffsets = 5,
+  kDatabases = 6,
+  kAccessionOffsets = 7,
+  kAccessions = 8,
+  kEntryNameOffsets = 9,
+  kEntryNames = 10,
+  // The seed sequences, or before version 5 the seed windows.
+  kSeedOffsets = 11,
+  kSeedResidues = 12,
+  // kAlphabet.size() x kAlphabet.size() doubles, row-major.
+  kMatrix = 13,
+  // DuplicateGroups, only with --dedup.
+  kGroupOffsets = 14,
+  kGroupMembers = 15,
+  // Encoding parameters, one "key=value" line each.
+  kManifest = 16,
+  // uint64_t words, bit i % 64 of word i / 64 set if sequence i is deleted.
+  kTombstones = 17,
+  // SeedWindow pairs, with element size 4.
+  kSeedWindows = 18,
+  // SeedSetEntry records, with element size 8.
+  kSeedSets = 19,
+};
+
+struct ContainerHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t section_count;
+  uint64_t directory_offset;
+  // End of the directory. A shorter file is truncated; bytes past it are
+  // left over from an interrupted update and are ignored.
+  uint64_t file_size;
+  // CRC32C of this header with header_crc32c zeroed, and of the directory.
+  uint32_t header_crc32c;
+  uint32_t directory_crc32c;
+  // kByteOrderMark as the writer stored it; 0 before version 3.
+  uint32_t byte_order;
+  // sizeof(uint64_t) of the offsets and sizeof(double) of the matrix.
+  uint8_t offset_size;
+  uint8_t real_size;
+  uint8_t reserved[18];
+};
+static_assert(sizeof(ContainerHeader) == kSectionAlignment,
+              "the first section must start right after the header");
+
+struct SectionEntry {
+  uint32_t id;
+  uint32_t element_size;
+  uint64_t offset;
+  uint64_t size;
+  uint32_t crc32c;
+  uint32_t segment;
+};
+static_assert(sizeof(SectionEntry) == 32, "directory entries are 32 bytes");
+
+// A seed window: the residues of seed sequence source from start on, as
+// many as the seed length.
+struct SeedWindow {
+  uint32_t source;
+  uint32_t start;
+};
+static_assert(sizeof(SeedWindow) == 8, "seed windows are two 32-bit words");
+
+// A seed window set: window_count windows of window_length residues, from
+// first_window on in the windows section.
+struct SeedSetEntry {
+  uint64_t window_length;
+  uint64_t window_stride;
+  uint64_t first_window;
+  uint64_t window_count;
+};
+static_assert(sizeof(SeedSetEntry) == 32, "seed set entries are 32 bytes");
+
+
+// Whether a container with this header was written on a host of the other
+// byte order; false if its byte_order is not a byte order mark at all.
+inline bool foreign_byte_order(const ContainerHeader& header) {
+  if (header.byte_order == 0) {
+    return !kHostLittleEndian;
+  }
+  return header.byte_order == __builtin_bswap32(kByteOrderMark);
+}
+
+inline bool known_byte_order(const ContainerHeader& header) {
+  return header.byte_order == 0 || header.byte_order == kByteOrderMark ||
+         header.byte_order == __builtin_bswap32(kByteOrderMark);
+}
+
+// Bring a foreign header or directory into host order.
+inline void reverse_header(ContainerHeader& header) {
+  reverse_bytes(header.version);
+  reverse_bytes(header.section_count);
+  reverse_bytes(header.directory_offset);
+  reverse_bytes(header.file_size);
+  reverse_bytes(header.header_crc32c);
+  reverse_bytes(header.directory_crc32c);
+  reverse_bytes(header.byte_order);
+}
+
+inline void reverse_entries(SectionEntry* entries, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    reverse_bytes(entries[i].id);
+    reverse_bytes(entries[i].element_size);
+    reverse_bytes(entries[i].offset);
+    reverse_bytes(entries[i].size);
+    reverse_bytes(entries[i].crc32c);
+    reverse_bytes(entries[i].segment);
+  }
+}
+
+// Residue code i stands for kResidueLetters[i]; the matrix section is
+// indexed the same way.
+constexpr char kResidueLetters[] = "ACDEFGHIKLMNPQRSTVWY";
+constexpr size_t kResidueCodes = sizeof(kResidueLetters) - 1;
+
+// Manifest key whose value, if present, must be the kAlphabet letters in
+// code order for the container to open.
+constexpr char kManifestAlphabet[] = "alphabet";
+
+#endif  // CONVERGE_ENCODER_CONTAINER_FORMAT_HPP_
@@ -0,0 +1,328 @@
+#ifndef CONVERGE_ENCODER_CONTAINER_LAYOUT_HPP_
+#define CONVERGE_ENCODER_CONTAINER_LAYOUT_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <string_view>
+
+#include "converge_encoder/container_format.hpp"
+
+// The one parser of the container format, shared by the header-only
+// converge_encoder::Reader and the encoder's MappedContainer: it checks a
+// mapped container's header, directory and section bounds, reverses a
+// foreign one into host order, and looks sections and manifest entries
+// up. Malformed files are reported on std::cerr as "File <name> ..." and
+// terminate. Nothing is allocated.
+class ContainerLayout {
+ public:
+  // CRC32C of size bytes at data, continuing from crc.
+  using Checksum = uint32_t (*)(const void* data, size_t size, uint32_t crc);
+
+  // filename is only kept for messages and must outlive the layout.
+  explicit ContainerLayout(const char* filename) : filename_(filename) {}
+
+  // Parses the size bytes at data. With checksum, the header and directory
+  // CRCs of version 2 and later are checked as well. A foreign container
+  // is reversed in place; make_writable() is called once first and returns
+  // data made writable. The manifest's alphabet, if any, must be
+  // kResidueLetters.
+  template <class MakeWritable>
+  void open(const char* data, size_t size, Checksum checksum,
+            MakeWritable make_writable) {
+    data_ = data;
+    if (size < sizeof(ContainerHeader)) {
+      fail("is too short for a container");
+    }
+    // The raw header is kept for its CRC, which covers the bytes as written.
+    ContainerHeader raw;
+    memcpy(&raw, data, sizeof(raw));
+    if (memcmp(raw.magic, kContainerMagic, sizeof(kContainerMagic)) != 0) {
+      fail("is not a container");
+    }
+    if (!known_byte_order(raw)) {
+      fail("has an unknown byte order");
+    }
+    foreign_ = foreign_byte_order(raw);
+    header_ = raw;
+    if (foreign_) {
+      reverse_header(header_);
+    }
+    if (header_.version < 1 || header_.version > kContainerVersion) {
+      fail("has unsupported container version ", header_.version);
+    }
+    if (checksum != nullptr && header_.version >= 2) {
+      raw.header_crc32c = 0;
+      if (checksum(&raw, sizeof(raw), 0) != header_.header_crc32c) {
+        fail("has a corrupt header");
+      }
+    }
+    if (header_.version >= 3 && (header_.offset_size != sizeof(uint64_t) ||
+                                 header_.real_size != sizeof(double))) {
+      fail("has ", int(header_.offset_size), "-byte offsets and ",
+           int(header_.real_size), "-byte reals");
+    }
+    // Bytes past the directory are left over from an interrupted update.
+    if (header_.file_size > size) {
+      fail("is truncated");
+    }
+    if (header_.directory_offset % alignof(SectionEntry) != 0 ||
+        header_.directory_offset > header_.file_size ||
+        (header_.file_size - header_.directory_offset) /
+          sizeof(SectionEntry) < header_.section_count) {
+      fail("has a corrupt section directory");
+    }
+    directory_ = reinterpret_cast<const SectionEntry*>(
+      data + header_.directory_offset);
+    if (checksum != nullptr && header_.version >= 2 &&
+        checksum(directory_, header_.section_count * sizeof(SectionEntry),
+                 0) != header_.directory_crc32c) {
+      fail("has a corrupt section directory");
+    }
+    // A container from a host of the other byte order is brought into host
+    // order once, in the process's private copy of the pages it touches.
+    char* writable = foreign_ ? make_writable() : nullptr;
+    if (foreign_) {
+      reverse_entries(reinterpret_cast<SectionEntry*>(
+        writable + header_.directory_offset), header_.section_count);
+    }
+    segment_count_ = 1;
+    for (size_t i = 0; i < header_.section_count; i++) {
+      const SectionEntry& entry = directory_[i];
+      if (entry.offset % kSectionAlignment != 0 ||
+          entry.offset > header_.directory_offset ||
+          entry.size > header_.directory_offset - entry.offset ||
+          entry.element_size == 0 || entry.size % entry.element_size != 0) {
+        fail("has a corrupt entry for section ", entry.id);
+      }
+      if (entry.segment >= segment_count_) {
+        segment_count_ = entry.segment + 1;
+      }
+      if (foreign_) {
+        reverse_bytes(writable + entry.offset, entry.size / entry.element_size,
+                      entry.element_size);
+      }
+    }
+    // Residue codes only mean something under the alphabet they were
+    // encoded with.
+    std::string_view alphabet;
+    if (manifest_value(kManifestAlphabet, alphabet) &&
+        alphabet != std::string_view(kResidueLetters, kResidueCodes)) {
+      fail("was encoded with alphabet ", alphabet);
+    }
+  }
+
+  ContainerLayout(const ContainerLayout&) = delete;
+  ContainerLayout& operator=(const ContainerLayout&) = delete;
+
+  // The header in host order.
+  const ContainerHeader& header() const { return header_; }
+  uint32_t version() const { return header_.version; }
+  bool foreign() const { return foreign_; }
+  uint32_t segment_count() const { return segment_count_; }
+  size_t section_count() const { return header_.section_count; }
+  const SectionEntry* directory() const { return directory_; }
+  const char* data(const SectionEntry& entry) const {
+    return data_ + entry.offset;
+  }
+
+  // The section of the segment, or nullptr.
+  const SectionEntry* find(SectionId id, uint32_t segment) const {
+    for (size_t i = 0; i < header_.section_count; i++) {
+      if (directory_[i].id == static_cast<uint32_t>(id) &&
+          directory_[i].segment == segment) {
+        return &directory_[i];
+      }
+    }
+    return nullptr;
+  }
+
+  // Terminates if there is no such section.
+  const SectionEntry& section(SectionId id, uint32_t segment) const {
+    const SectionEntry* entry = find(id, segment);
+    if (entry == nullptr) {
+      fail("has no section ", static_cast<uint32_t>(id), " in segment ",
+           segment);
+    }
+    return *entry;
+  }
+
+  // The section of the highest segment that has one, or nullptr.
+  const SectionEntry* latest(SectionId id) const {
+    const SectionEntry* latest = nullptr;
+    for (size_t i = 0; i < header_.section_count; i++) {
+      if (directory_[i].id == static_cast<uint32_t>(id) &&
+          (latest == nullptr || directory_[i].segment > latest->segment)) {
+        latest = &directory_[i];
+      }
+    }
+    return latest;
+  }
+
+  // The section's elements, which must be sizeof(T) bytes each.
+  template <class T>
+  const T* typed(const SectionEntry& entry, size_t& count) const {
+    if (entry.element_size != sizeof(T)) {
+      fail("has section ", entry.id, " with element size ",
+           entry.element_size);
+    }
+    count = static_cast<size_t>(entry.size / sizeof(T));
+    return reinterpret_cast<const T*>(data_ + entry.offset);
+  }
+
+  // A CSR column of count entries: offsets into the elements section. Only
+  // the last offset is checked, so that opening a column does not touch
+  // every page of its offsets.
+  template <class T>
+  const uint64_t* csr(SectionId offsets_id, SectionId elements_id,
+                      uint32_t segment, const T*& elements,
+                      size_t& count) const {
+    size_t offset_count;
+    size_t element_count;
+    const uint64_t* offsets = typed<uint64_t>(section(offsets_id, segment),
+                                              offset_count);
+    elements = typed<T>(section(elements_id, segment), element_count);
+    if (offset_count == 0 || offsets[offset_count - 1] > element_count) {
+      fail("has offsets past the end of section ",
+           static_cast<uint32_t>(elements_id));
+    }
+    count = offset_count - 1;
+    return offsets;
+  }
+
+  // Empty if nothing was ever deleted.
+  const uint64_t* tombstones(size_t& word_count) const {
+    const SectionEntry* entry = latest(SectionId::kTombstones);
+    word_count = 0;
+    return entry == nullptr ? nullptr : typed<uint64_t>(*entry, word_count);
+  }
+
+  const double* matrix() const {
+    size_t count;
+    const double* values = typed<double>(section(SectionId::kMatrix, 0),
+                                         count);
+    if (count != kResidueCodes * kResidueCodes) {
+      fail("has a matrix of ", count, " values");
+    }
+    return values;
+  }
+
+  size_t seed_set_count() const {
+    const SectionEntry* entry = find(SectionId::kSeedSets, 0);
+    return entry == nullptr
+             ? 1 : static_cast<size_t>(entry->size / sizeof(SeedSetEntry));
+  }
+
+  // Where seed window set set lies in the windows section. Before version
+  // 5 there is none, and windows is nullptr; the seed sequences are then
+  // the windows. Without a seed set section the one set's length and
+  // stride are the manifest's, 0 if it has none. The windows themselves
+  // are not checked.
+  void seed_set(size_t set, const SeedWindow*& windows, size_t& count,
+                size_t& length, size_t& stride) const {
+    if (set >= seed_set_count()) {
+      fail("has no seed set ", set);
+    }
+    const SectionEntry* windows_entry = find(SectionId::kSeedWindows, 0);
+    const SectionEntry* sets_entry = find(SectionId::kSeedSets, 0);
+    windows = nullptr;
+    count = 0;
+    if (windows_entry != nullptr) {
+      size_t words;
+      windows = reinterpret_cast<const SeedWindow*>(
+        typed<uint32_t>(*windows_entry, words));
+      count = words / 2;
+    }
+    if (windows_entry == nullptr || sets_entry == nullptr) {
+      length = manifest_number("seed_length");
+      stride = manifest_number("seed_stride");
+      return;
+    }
+    size_t fields;
+    const SeedSetEntry& entry = reinterpret_cast<const SeedSetEntry*>(
+      typed<uint64_t>(*sets_entry, fields))[set];
+    if (entry.first_window > count ||
+        entry.window_count > count - entry.first_window) {
+      fail("has seed set ", set, " past the end of the windows");
+    }
+    windows += entry.first_window;
+    count = static_cast<size_t>(entry.window_count);
+    length = static_cast<size_t>(entry.window_length);
+    stride = static_cast<size_t>(entry.window_stride);
+  }
+
+  // Calls visit(key, value) on each "key=value" line of the manifest, in
+  // order, while it returns true. Of several segments' manifests, the last
+  // one counts.
+  template <class Visit>
+  void visit_manifest(Visit visit) const {
+    const SectionEntry* entry = latest(SectionId::kManifest);
+    if (entry == nullptr) {
+      return;
+    }
+    size_t size;
+    const char* text = typed<char>(*entry, size);
+    std::string_view rest(text, size);
+    while (!rest.empty()) {
+      size_t newline = rest.find('\n');
+      std::string_view line = rest.substr(0, newline);
+      rest = newline == std::string_view::npos ? std::string_view()
+                                               : rest.substr(newline + 1);
+      size_t equals = line.find('=');
+      if (equals == std::string_view::npos) {
+        fail("has a malformed manifest line: ", line);
+      }
+      if (!visit(line.substr(0, equals), line.substr(equals + 1))) {
+        return;
+      }
+    }
+  }
+
+  // Sets value and returns true if the manifest has key.
+  bool manifest_value(std::string_view key, std::string_view& value) const {
+    bool found = false;
+    visit_manifest([&](std::string_view entry_key,
+                       std::string_view entry_value) {
+      found = entry_key == key;
+      if (found) {
+        value = entry_value;
+      }
+      return !found;
+    });
+    return found;
+  }
+
+  // The manifest's decimal value for key, 0 if it has none.
+  size_t manifest_number(std::string_view key) const {
+    size_t number = 0;
+    std::string_view value;
+    if (manifest_value(key, value)) {
+      for (char digit: value) {
+        if (digit < '0' || digit > '9') {
+          fail("has a manifest value that is not a number: ", value);
+        }
+        number = number * 10 + static_cast<size_t>(digit - '0');
+      }
+    }
+    return number;
+  }
+
+  template <class... Parts>
+  [[noreturn]] void fail(const Parts&... parts) const {
+    std::cerr << "File " << filename_ << " ";
+    (std::cerr << ... << parts) << std::endl;
+    std::terminate();
+  }
+
+ private:
+  const char* filename_;
+  const char* data_ = nullptr;
+  ContainerHeader header_{};
+  const SectionEntry* directory_ = nullptr;
+  bool foreign_ = false;
+  uint32_t segment_count_ = 1;
+};
+
+#endif  // CONVERGE_ENCODER_CONTAINER_LAYOUT_HPP_
@@ -0,0 +1,528 @@
+#ifndef CONVERGE_ENCODER_READER_HPP_
+#define CONVERGE_ENCODER_READER_HPP_
+
+// Header-only reader for converge containers (--format container), for
+// tools that want the proteome, seeds and matrix without linking the
+// encoder. Opening maps the file and checks its header, directory and
+// section bounds; nothing is copied or allocated, and every view points
+// into the mapping, so views stay valid as long as the Reader does.
+// Containers written on a host of the other byte order are reversed in
+// bulk on open. Checksums are left to --verify. An appended-to container
+// has several segments, each a ProteomeView, and tombstones for deleted
+// sequences.
+//
+//   converge_encoder::Reader reader("output/converge_container");
+//   for (auto sequence: reader.proteome()) {
+//     for (auto window: converge_encoder::windows(sequence, 30, 10)) {
+//       ...
+//     }
+//   }
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <iterator>
+#include <string_view>
+
+#include "converge_encoder/container_format.hpp"
+#include "converge_encoder/container_layout.hpp"
+
+namespace converge_encoder {
+
+// A contiguous run of T, as std::span<const T> in C++20.
+template <class T>
+class Span {
+ public:
+  using value_type = T;
+  using iterator = const T*;
+
+  Span() = default;
+  Span(const T* data, size_t size) : data_(data), size_(size) {}
+
+  const T* data() const { return data_; }
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  const T* begin() const { return data_; }
+  const T* end() const { return data_ + size_; }
+  const T& operator[](size_t i) const { return data_[i]; }
+  Span subspan(size_t offset, size_t count) const {
+    return Span(data_ + offset, count);
+  }
+
+ private:
+  const T* data_ = nullptr;
+  size_t size_ = 0;
+};
+
+using ResidueSpan = Span<uint8_t>;
+
+
+// Walks a CSR column: offsets[i] to offsets[i + 1] into elements.
+template <class T, class Value>
+class CsrIterator {
+ public:
+  using iterator_category = std::random_access_iterator_tag;
+  using value_type = Value;
+  using difference_type = std::ptrdiff_t;
+  using pointer = void;
+  using reference = Value;
+
+  CsrIterator() = default;
+  CsrIterator(const uint64_t* offsets, const T* elements)
+    : offsets_(offsets), elements_(elements) {}
+
+  Value operator*() const {
+    return Value(elements_ + offsets_[0],
+                 static_cast<size_t>(offsets_[1] - offsets_[0]));
+  }
+  Value operator[](difference_type n) const { return *(*this + n); }
+  CsrIterator& operator++() { ++offsets_; return *this; }
+  CsrIterator operator++(int) {
+    CsrIterator old = *this;
+    ++offsets_;
+    return old;
+  }
+  CsrIterator& operator--() { --offsets_; return *this; }
+  CsrIterator operator--(int) {
+    CsrIterator old = *this;
+    --offsets_;
+    return old;
+  }
+  CsrIterator& operator+=(difference_type n) { offsets_ += n; return *this; }
+  CsrIterator& operator-=(difference_type n) { offsets_ -= n; return *this; }
+  CsrIterator operator+(difference_type n) const {
+    return CsrIterator(offsets_ + n, elements_);
+  }
+  CsrIterator operator-(difference_type n) const {
+    return CsrIterator(offsets_ - n, elements_);
+  }
+  difference_type operator-(const CsrIterator& other) const {
+    return offsets_ - other.offsets_;
+  }
+  bool operator==(const CsrIterator& other) const {
+    return offsets_ == other.offsets_;
+  }
+  bool operator!=(const CsrIterator& other) const {
+    return offsets_ != other.offsets_;
+  }
+  bool operator<(const CsrIterator& other) const {
+    return offsets_ < other.offsets_;
+  }
+
+ private:
+  const uint64_t* offsets_ = nullptr;
+  const T* elements_ = nullptr;
+};
+
+
+// The windows of length residues starting every stride residues that fit
+// in a sequence; none if it is shorter than length.
+class WindowRange {
+ public:
+  class iterator {
+   public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = ResidueSpan;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = ResidueSpan;
+
+    iterator() = default;
+    iterator(const uint8_t* start, size_t length, size_t stride)
+      : start_(start), length_(length), stride_(stride) {}
+
+    ResidueSpan operator*() const { return ResidueSpan(start_, length_); }
+    iterator& operator++() { start_ += stride_; return *this; }
+    iterator operator++(int) {
+      iterator old = *this;
+      start_ += stride_;
+      return old;
+    }
+    bool operator==(const iterator& other) const {
+      return start_ == other.start_;
+    }
+    bool operator!=(const iterator& other) const {
+      return start_ != other.start_;
+    }
+
+   private:
+    const uint8_t* start_ = nullptr;
+    size_t length_ = 0;
+    size_t stride_ = 1;
+  };
+
+  WindowRange(ResidueSpan sequence, size_t length, size_t stride)
+    : sequence_(sequence), length_(length), stride_(stride) {}
+
+  size_t size() const {
+    return length_ == 0 || sequence_.size() < length_
+             ? 0 : (sequence_.size() - length_) / stride_ + 1;
+  }
+  iterator begin() const {
+    return iterator(sequence_.data(), length_, stride_);
+  }
+  iterator end() const {
+    return iterator(sequence_.data() + size() * stride_, length_, stride_);
+  }
+  ResidueSpan operator[](size_t i) const {
+    return sequence_.subspan(i * stride_, length_);
+  }
+
+ private:
+  ResidueSpan sequence_;
+  size_t length_;
+  size_t stride_;
+};
+
+inline WindowRange windows(ResidueSpan sequence, size_t length,
+                           size_t stride) {
+  return WindowRange(sequence, length, stride);
+}
+
+
+// Sequences of residue codes stored as an offsets and a residues section.
+class SequenceSetView {
+ public:
+  using iterator = CsrIterator<uint8_t, ResidueSpan>;
+
+  SequenceSetView() = default;
+  SequenceSetView(const uint64_t* offsets, const uint8_t* residues,
+                  size_t count)
+    : offsets_(offsets), residues_(residues), count_(count) {}
+
+  size_t size() const { return count_; }
+  bool empty() const { return count_ == 0; }
+  ResidueSpan operator[](size_t i) const { return *(begin() + i); }
+  iterator begin() const { return iterator(offsets_, residues_); }
+  iterator end() const { return iterator(offsets_ + count_, residues_); }
+
+  // The raw sections, for consumers that scan every residue at once.
+  Span<uint64_t> offsets() const {
+    return Span<uint64_t>(offsets_, count_ + 1);
+  }
+  ResidueSpan residues() const {
+    return ResidueSpan(residues_ + offsets_[0], total_residues());
+  }
+  size_t total_residues() const {
+    return static_cast<size_t>(offsets_[count_] - offsets_[0]);
+  }
+
+ private:
+  const uint64_t* offsets_ = nullptr;
+  const uint8_t* residues_ = nullptr;
+  size_t count_ = 0;
+};
+
+
+// The proteome, with its header lines if the container has them.
+class ProteomeView : public SequenceSetView {
+ public:
+  using HeaderIterator = CsrIterator<char, std::string_view>;
+
+  ProteomeView() = default;
+  ProteomeView(const SequenceSetView& sequences, const uint64_t* header_offsets,
+               const char* headers)
+    : SequenceSetView(sequences), header_offsets_(header_offsets),
+      headers_(headers) {}
+
+  bool has_headers() const { return header_offsets_ != nullptr; }
+  // Only if has_headers().
+  std::string_view header(size_t i) const {
+    return *(HeaderIterator(header_offsets_, headers_) + i);
+  }
+
+ private:
+  const uint64_t* header_offsets_ = nullptr;
+  const char* headers_ = nullptr;
+};
+
+
+// One set of seed windows, each window_length() residues and starting
+// every window_stride() residues, in the order they were cut from the seed
+// sequences. Windows are spans into sources(), the seed sequences, located
+// by windows(); containers before version 5 store each window as a
+// sequence of its own, and windows() is empty.
+class SeedSetView {
+ public:
+  class iterator {
+   public:
+    using iterator_category = std::random_access_iterator_tag;
+    using value_type = ResidueSpan;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = ResidueSpan;
+
+    iterator() = default;
+    iterator(const SequenceSetView& sources, const SeedWindow* windows,
+             size_t length, size_t i)
+      : sources_(sources), windows_(windows), length_(length), i_(i) {}
+
+    ResidueSpan operator*() const {
+      return window(sources_, windows_, length_, i_);
+    }
+    ResidueSpan operator[](difference_type n) const {
+      return window(sources_, windows_, length_, i_ + n);
+    }
+    iterator& operator++() { ++i_; return *this; }
+    iterator operator++(int) { iterator old = *this; ++i_; return old; }
+    iterator& operator--() { --i_; return *this; }
+    iterator operator--(int) { iterator old = *this; --i_; return old; }
+    iterator& operator+=(difference_type n) { i_ += n; return *this; }
+    iterator& operator-=(difference_type n) { i_ -= n; return *this; }
+    iterator operator+(difference_type n) const {
+      return iterator(sources_, windows_, length_, i_ + n);
+    }
+    iterator operator-(difference_type n) const {
+      return iterator(sources_, windows_, length_, i_ - n);
+    }
+    difference_type operator-(const iterator& other) const {
+      return static_cast<difference_type>(i_) -
+             static_cast<difference_type>(other.i_);
+    }
+    bool operator==(const iterator& other) const { return i_ == other.i_; }
+    bool operator!=(const iterator& other) const { return i_ != other.i_; }
+    bool operator<(const iterator& other) const { return i_ < other.i_; }
+
+   private:
+    SequenceSetView sources_;
+    const SeedWindow* windows_ = nullptr;
+    size_t length_ = 0;
+    size_t i_ = 0;
+  };
+
+  SeedSetView() = default;
+  SeedSetView(const SequenceSetView& sources, const SeedWindow* windows,
+              size_t window_count, size_t window_length, size_t window_stride)
+    : sources_(sources), windows_(windows), window_count_(window_count),
+      window_length_(window_length), window_stride_(window_stride) {}
+
+  size_t size() const {
+    return windows_ == nullptr ? sources_.size() : window_count_;
+  }
+  bool empty() const { return size() == 0; }
+  ResidueSpan operator[](size_t i) const {
+    return window(sources_, windows_, window_length_, i);
+  }
+  iterator begin() const {
+    return iterator(sources_, windows_, window_length_, 0);
+  }
+  iterator end() const {
+    return iterator(sources_, windows_, window_length_, size());
+  }
+
+  const SequenceSetView& sources() const { return sources_; }
+  Span<SeedWindow> windows() const {
+    return Span<SeedWindow>(windows_, window_count_);
+  }
+  // 0 if the container does not record them.
+  size_t window_length() const { return window_length_; }
+  size_t window_stride() const { return window_stride_; }
+
+ private:
+  static ResidueSpan window(const SequenceSetView& sources,
+                            const SeedWindow* windows, size_t length,
+                            size_t i) {
+    if (windows == nullptr) {
+      return sources[i];
+    }
+    return sources[windows[i].source].subspan(windows[i].start, length);
+  }
+
+  SequenceSetView sources_;
+  const SeedWindow* windows_ = nullptr;
+  size_t window_count_ = 0;
+  size_t window_length_ = 0;
+  size_t window_stride_ = 0;
+};
+
+
+// Bit i is set if sequence i, numbered across segments, is deleted.
+class TombstoneView {
+ public:
+  TombstoneView() = default;
+  TombstoneView(const uint64_t* words, size_t word_count)
+    : words_(words), word_count_(word_count) {}
+
+  bool operator[](uint64_t i) const {
+    return i / 64 < word_count_ && (words_[i / 64] >> (i % 64) & 1) != 0;
+  }
+  Span<uint64_t> words() const { return Span<uint64_t>(words_, word_count_); }
+
+ private:
+  const uint64_t* words_ = nullptr;
+  size_t word_count_ = 0;
+};
+
+
+// Row-major substitution scores, indexed by residue code.
+class MatrixView {
+ public:
+  MatrixView() = default;
+  MatrixView(const double* values, size_t rows, size_t cols)
+    : values_(values), rows_(rows), cols_(cols) {}
+
+  size_t rows() const { return rows_; }
+  size_t cols() const { return cols_; }
+  Span<double> operator[](size_t row) const {
+    return Span<double>(values_ + row * cols_, cols_);
+  }
+  double operator()(size_t row, size_t col) const {
+    return values_[row * cols_ + col];
+  }
+  Span<double> values() const { return Span<double>(values_, rows_ * cols_); }
+
+ private:
+  const double* values_ = nullptr;
+  size_t rows_ = 0;
+  size_t cols_ = 0;
+};
+
+
+// Read-only mapping of a container. Malformed files are reported on
+// std::cerr and terminate, as elsewhere in converge.
+class Reader {
+ public:
+  explicit Reader(const char* filename) : layout_(filename_) {
+    // Kept for error messages; copied since the caller's string may go.
+    strncpy(filename_, filename, sizeof(filename_) - 1);
+    int fd = ::open(filename, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      layout_.fail("failed to open");
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+      ::close(fd);
+      layout_.fail("failed to open");
+    }
+    size_ = static_cast<size_t>(info.st_size);
+    if (size_ > 0) {
+      void* data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (data == MAP_FAILED) {
+        ::close(fd);
+        layout_.fail("failed to map");
+      }
+      data_ = static_cast<const char*>(data);
+    }
+    ::close(fd);
+    // A container from a host of the other byte order is reversed into
+    // host order in place, in the mapping's private copy of its pages.
+    layout_.open(data_, size_, nullptr, [this] {
+      if (mprotect(const_cast<char*>(data_), size_,
+                   PROT_READ | PROT_WRITE) != 0) {
+        layout_.fail("failed to map");
+      }
+      return const_cast<char*>(data_);
+    });
+    if (layout_.foreign()) {
+      mprotect(const_cast<char*>(data_), size_, PROT_READ);
+    }
+  }
+
+  ~Reader() {
+    if (data_ != nullptr) {
+      munmap(const_cast<char*>(data_), size_);
+    }
+  }
+
+  Reader(const Reader&) = delete;
+  Reader& operator=(const Reader&) = delete;
+
+  uint32_t version() const { return layout_.version(); }
+
+  // Segments are numbered from 0; each append adds one.
+  uint32_t segment_count() const { return layout_.segment_count(); }
+
+  bool has_section(SectionId id, uint32_t segment = 0) const {
+    return layout_.find(id, segment) != nullptr;
+  }
+
+  // The raw bytes of a section; empty if there is none.
+  Span<char> section(SectionId id, uint32_t segment = 0) const {
+    const SectionEntry* entry = layout_.find(id, segment);
+    return entry == nullptr
+             ? Span<char>()
+             : Span<char>(layout_.data(*entry),
+                          static_cast<size_t>(entry->size));
+  }
+
+  // The sequences of one segment; those of segment k are numbered on from
+  // the last of segment k - 1.
+  ProteomeView proteome(uint32_t segment = 0) const {
+    SequenceSetView sequences = sequence_set(SectionId::kSequenceOffsets,
+                                             SectionId::kResidues, segment);
+    if (!has_section(SectionId::kHeaderOffsets, segment)) {
+      return ProteomeView(sequences, nullptr, nullptr);
+    }
+    const char* headers;
+    size_t count;
+    const uint64_t* offsets = layout_.csr(SectionId::kHeaderOffsets,
+                                          SectionId::kHeaders, segment,
+                                          headers, count);
+    if (count != sequences.size()) {
+      layout_.fail("has a header count that differs from its sequence count");
+    }
+    return ProteomeView(sequences, offsets, headers);
+  }
+
+  // Sequences deleted since the container was last compacted.
+  TombstoneView tombstones() const {
+    size_t count;
+    const uint64_t* words = layout_.tombstones(count);
+    return TombstoneView(words, count);
+  }
+
+  // Seed window sets are numbered in the order they were asked for.
+  size_t seed_set_count() const { return layout_.seed_set_count(); }
+
+  SeedSetView seeds(size_t set = 0) const {
+    const SeedWindow* windows;
+    size_t count;
+    size_t length;
+    size_t stride;
+    layout_.seed_set(set, windows, count, length, stride);
+    return SeedSetView(
+      sequence_set(SectionId::kSeedOffsets, SectionId::kSeedResidues, 0),
+      windows, count, length, stride);
+  }
+
+  MatrixView matrix() const {
+    return MatrixView(layout_.matrix(), kResidueCodes, kResidueCodes);
+  }
+
+  // Sets value and returns true if the manifest has key. Of several
+  // segments' manifests, the last one counts.
+  bool manifest_value(std::string_view key, std::string_view& value) const {
+    return layout_.manifest_value(key, value);
+  }
+
+  // The manifest's decimal value for key, 0 if it has none.
+  size_t manifest_number(std::string_view key) const {
+    return layout_.manifest_number(key);
+  }
+
+ private:
+  SequenceSetView sequence_set(SectionId offsets_id, SectionId residues_id,
+                               uint32_t segment) const {
+    const uint8_t* residues;
+    size_t count;
+    const uint64_t* offsets = layout_.csr(offsets_id, residues_id, segment,
+                                          residues, count);
+    return SequenceSetView(offsets, residues, count);
+  }
+
+  char filename_[4096] = {};
+  const char* data_ = nullptr;
+  size_t size_ = 0;
+  ContainerLayout layout_;
+};
+
+}  // namespace converge_encoder
+
+#endif  // CONVERGE_ENCODER_READER_HPP_
@@ -1,16 +1,32 @@
+#include <algorithm>
 #include <assert.h>
+#include <cstdio>
 #include <fstream>
 #include <iostream>
 #include <map>
 #include <math.h>
+#include <memory>
 #include <set>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include <cereal/types/vector.hpp>
 #include <cereal/types/string.hpp>
 #include <cereal/archives/binary.hpp>
 
+#include "checksums.hpp"
+#include "container.hpp"
+#include "container_update.hpp"
+#include "dedup.hpp"
+#include "fasta_parser.hpp"
+#include "input_cache.hpp"
+#include "npy_file.hpp"
+#include "seed_windows.hpp"
+#include "sequence_store.hpp"
+#include "shards.hpp"
+#include "stream_encoder.hpp"
+
 
 std::vector<std::string> read_file(std::string const &fileName) {
   std::vector<std::string> vecOfStrs;
@@ -34,99 +50,56 @@ std::vector<std::string> read_file(std::string const &fileName) {
 }
 
 
-void load_fasta_sequences(const std::string& filename,
-  std::vector<std::string>& headers, std::vector<std::vector<int>>& sequences) {
-  std::set<char> kAlphabtets_set = {'A', 'C', 'D', 'E', 'F', 'G', 'H', 'I',
-                                    'K',
-                                    'L', 'M', 'N', 'P', 'Q', 'R', 'S', 'T', 'V',
-                                    'W', 'Y'};
-  
-  std::array<char, 20> kAlphabtets = {'A', 'C', 'D', 'E', 'F', 'G',
-                                      'H', 'I', 'K', 'L', 'M', 'N', 'P', 'Q',
-                                      'R', 'S', 'T', 'V', 'W', 'Y'};
-  std::map<char, int> letter_int_map;
-  for (int i=0;i<20;i++){
-    letter_int_map[kAlphabtets[i]] = i;
-  }
-  std::vector<std::string> vecOfStrs = read_file(filename);
-  std::string current_header;
-  std::vector<int> current_seq;
-  
-  for (std::string &line: vecOfStrs) {
-    if (line[0] == '>') {
-//      Header line
-      if (current_seq.empty()) {
-        current_header = line;
-      } else {
-        current_seq.shrink_to_fit();
-        current_header.shrink_to_fit();
-        sequences.push_back(current_seq);
-        headers.push_back(current_header);
-        current_header = line;
-        current_seq.clear();
-      }
-    } else {
-//      Sequence line
-      for (char letter: line) {
-        bool is_in = kAlphabtets_set.find(letter) != kAlphabtets_set.end();
-        if (is_in) {
-          current_seq.push_back(letter_int_map.at(letter));
-        }
+// Cuts every window set of windowings from the seed sequences in one pass.
+SeedSets load_seed_seq(const std::string& filename,
+  const std::vector<SeedWindowing>& windowings) {
+  HeaderStore headers;
+  SequenceStore seed_seqs;
+  load_fasta_sequences(filename, headers, seed_seqs);
+  for (size_t i = 0; i < seed_seqs.size(); i++) {
+    for (const SeedWindowing& windowing: windowings) {
+      if (count_windows(seed_seqs[i].size, windowing) == 0) {
+        std::cerr << "File " << filename << " has a seed sequence of "
+                  << seed_seqs[i].size << " residues, shorter than the seed "
+                     "length " << windowing.length << "." << std::endl;
+        std::terminate();
       }
     }
   }
-  if (!current_seq.empty()) {
-    sequences.push_back(current_seq);
-    headers.push_back(current_header);
-  }
-  sequences.shrink_to_fit();
-  headers.shrink_to_fit();
-  assert (sequences.size() == headers.size());
+  return SeedSets(std::move(seed_seqs), windowings);
 }
 
 
-void split_seq(std::vector<int> &seq, int denom, int length,
-  std::vector<std::vector<int>> &seed_seqs) {
-  int num_full_cycles = (((int) seq.size())-length) / denom;
-  for (int i = 0; i < num_full_cycles; i++) {
-    auto first = seq.begin() + i * denom;
-    auto last = seq.begin() + i * denom + length;
-    std::vector<int> sub_vector(first, last);
-    seed_seqs.push_back(sub_vector);
-  }
-  if (seq.size() > num_full_cycles * denom) {
-    auto first = seq.end() - length;
-    auto last = seq.end();
-    std::vector<int> sub_vector(first, last);
-    seed_seqs.push_back(sub_vector);
+// Parses a --seed-windows list, "length:stride" pairs separated by commas.
+std::vector<SeedWindowing> parse_windowings(const std::string& list) {
+  std::vector<SeedWindowing> windowings;
+  size_t begin = 0;
+  while (begin <= list.size()) {
+    size_t end = std::min(list.find(',', begin), list.size());
+    std::string pair = list.substr(begin, end - begin);
+    size_t colon = pair.find(':');
+    if (colon == 0 || colon == std::string::npos || colon + 1 == pair.size() ||
+        pair.find(':', colon + 1) != std::string::npos ||
+        pair.find_first_not_of("0123456789:") != std::string::npos) {
+      std::cerr << "--seed-windows takes length:stride pairs separated by "
+                   "commas, not " << list << "." << std::endl;
+      std::terminate();
+    }
+    windowings.push_back({std::stoul(pair.substr(0, colon)),
+                          std::stoul(pair.substr(colon + 1))});
+    begin = end + 1;
   }
+  return windowings;
 }
 
 
-std::vector<std::vector<int>> load_seed_seq(const std::string& filename) {
-  std::vector<std::string> headers;
-  std::vector<std::vector<int>> seed_seq_rawsplit;
-  load_fasta_sequences(filename, headers, seed_seq_rawsplit);
-  std::vector<std::vector<int>> seed_seqs;
-  for (std::vector<int> seed_seq_wronglen: seed_seq_rawsplit) {
-    std::vector<std::vector<int>> seed_seq_split;
-    split_seq(seed_seq_wronglen, 10, 30, seed_seq_split);
-
-    for (const std::vector<int>& seq: seed_seq_split) {
-      if (seq.size() != 30){
-        std::cerr << "Assertion Error: In load_seed_seq(), file " << filename
-                  << " , seq in seed_seq_split from split_seq() has wrong "
-                     "length. It has length " << seq.size() << " and not 30."
-                  << std::endl;
-        std::terminate();
-      }
-    }
-    for (std::vector<int> seed_seq: seed_seq_split) {
-      seed_seq.shrink_to_fit();
-      seed_seqs.push_back(seed_seq);
-    }
+// The labels of windowings separated by commas, e.g. "w8s4,w30s10".
+std::string windowing_labels(const std::vector<SeedWindowing>& windowings) {
+  std::string labels;
+  for (const SeedWindowing& windowing: windowings) {
+    labels += (labels.empty() ? "" : ",") + seed_set_label(windowing);
   }
-  return seed_seqs;
+  return labels;
 }
 
 
@@ -195,68 +168,642 @@ std::vector<std::vector<double>> read_blosum(const std::string &filename) {
 }
 
 
+// Returns the CRC32C of the archive written.
 template <typename... Args>
-void save(const std::string& filename, const Args&... saves){
+uint32_t save(const std::string& filename, const Args&... saves){
   std::ofstream file;
   file.open(filename, std::ios_base::binary);
+  Crc32cStreambuf checksummed(file.rdbuf());
   {
-    cereal::BinaryOutputArchive oarchive(file); // Create an output archive
+    std::ostream stream(&checksummed);
+    cereal::BinaryOutputArchive oarchive(stream); // Create an output archive
     oarchive(saves...);
   }
   file.close();
+  return checksummed.checksum();
 }
 
 
-template <typename... Args>
-void load(const std::string& filename, Args&... outputs){
-  std::ifstream file;
-  file.open(filename, std::ios_base::binary);
-  {
-    cereal::BinaryInputArchive iarchive(file); // Create an output archive
-    iarchive(outputs...);
+// kCereal writes the three cereal archives, kContainer a single
+// memory-mappable file (src/container.hpp).
+enum class OutputFormat { kCereal, kContainer };
+
+
+struct EncoderOptions {
+  // May be gzip or BGZF compressed.
+  std::string proteome_input = "input/proteome.fasta";
+  // Encode the proteome chunk by chunk instead of loading it whole.
+  bool stream = false;
+  size_t stream_buffer_size = kDefaultStreamBufferSize;
+  // Where to write the .fai index of the proteome, empty for none.
+  std::string index_output;
+  // Collapse identical sequences and store which headers share each one.
+  bool dedup = false;
+  // Store the proteome's residues 5 bits each.
+  bool pack = false;
+  // Store the proteome's residues entropy coded.
+  bool compress = false;
+  OutputFormat format = OutputFormat::kCereal;
+  // Split the sequences into this many residue-balanced files, 0 for one.
+  size_t shards = 0;
+  // Parser threads for the in-memory path and BGZF inflate threads, 0 for
+  // every hardware thread.
+  size_t num_threads = 1;
+  // Windows cut from the seed sequences.
+  SeedWindowing seed_windowing;
+  // Window sets to cut, all from the same seed sequences: --seed-windows,
+  // or else seed_windowing alone.
+  std::vector<SeedWindowing> seed_windowings;
+  // Also write the proteome, seeds and matrix as NumPy arrays.
+  bool npy = false;
+  // Update output/converge_container in place instead of encoding: add the
+  // sequences of append_input as a new segment, delete those whose
+  // accession is listed in remove_input, or compact away deleted ones.
+  std::string append_input;
+  std::string remove_input;
+  bool compact = false;
+  // Keep the outputs of steps whose input and options are unchanged since
+  // the last run (see src/input_cache.hpp).
+  bool cache = true;
+  // Check the outputs of an earlier run against their checksums instead of
+  // encoding anything.
+  bool verify = false;
+};
+
+
+EncoderOptions parse_options(int argc, char** argv) {
+  EncoderOptions options;
+  bool single_windowing = false;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    bool has_value = i + 1 < argc;
+    if (arg == "--proteome" && has_value) {
+      options.proteome_input = argv[++i];
+    } else if (arg == "--stream") {
+      options.stream = true;
+    } else if (arg == "--buffer-mb" && has_value) {
+      options.stream_buffer_size = std::stoul(argv[++i]) << 20;
+    } else if (arg == "--dedup") {
+      options.dedup = true;
+    } else if (arg == "--pack") {
+      options.pack = true;
+    } else if (arg == "--compress") {
+      options.compress = true;
+    } else if (arg == "--format" && has_value &&
+               (std::string(argv[i + 1]) == "cereal" ||
+                std::string(argv[i + 1]) == "container")) {
+      options.format = std::string(argv[++i]) == "cereal" ?
+        OutputFormat::kCereal : OutputFormat::kContainer;
+    } else if (arg == "--index" && has_value) {
+      options.index_output = argv[++i];
+    } else if (arg == "--threads" && has_value) {
+      options.num_threads = std::stoul(argv[++i]);
+    } else if (arg == "--shards" && has_value) {
+      options.shards = std::stoul(argv[++i]);
+    } else if (arg == "--append" && has_value) {
+      options.append_input = argv[++i];
+    } else if (arg == "--remove" && has_value) {
+      options.remove_input = argv[++i];
+    } else if (arg == "--compact") {
+      options.compact = true;
+    } else if (arg == "--seed-length" && has_value) {
+      options.seed_windowing.length = std::stoul(argv[++i]);
+      single_windowing = true;
+    } else if (arg == "--seed-stride" && has_value) {
+      options.seed_windowing.stride = std::stoul(argv[++i]);
+      single_windowing = true;
+    } else if (arg == "--seed-windows" && has_value) {
+      options.seed_windowings = parse_windowings(argv[++i]);
+    } else if (arg == "--npy") {
+      options.npy = true;
+    } else if (arg == "--no-cache") {
+      options.cache = false;
+    } else if (arg == "--verify") {
+      options.verify = true;
+    } else {
+      std::cerr << "Unknown or incomplete option " << arg << "\n"
+                << "Usage: " << argv[0] << " [--proteome PATH] [--stream]"
+                   " [--buffer-mb N]"
+                   " [--threads N] [--index PATH] [--dedup] [--pack]"
+                   " [--compress]"
+                   " [--format cereal|container] [--shards N]"
+                   " [--seed-length N] [--seed-stride N]"
+                   " [--seed-windows L:S,...] [--npy] [--no-cache]"
+                   " [--verify]"
+                   " [--append PATH] [--remove PATH] [--compact]"
+                << std::endl;
+      std::terminate();
+    }
+  }
+  if (single_windowing && !options.seed_windowings.empty()) {
+    std::cerr << "--seed-windows replaces --seed-length and --seed-stride."
+              << std::endl;
+    std::terminate();
+  }
+  if (options.seed_windowings.empty()) {
+    options.seed_windowings.push_back(options.seed_windowing);
+  }
+  std::set<std::string> labels;
+  for (const SeedWindowing& windowing: options.seed_windowings) {
+    if (windowing.length == 0 || windowing.stride == 0) {
+      std::cerr << "Seed window lengths and strides must be at least 1."
+                << std::endl;
+      std::terminate();
+    }
+    if (!labels.insert(seed_set_label(windowing)).second) {
+      std::cerr << "--seed-windows lists " << seed_set_label(windowing)
+                << " twice." << std::endl;
+      std::terminate();
+    }
   }
+  if (options.stream && options.dedup) {
+    std::cerr << "--dedup needs the whole proteome in memory and cannot be "
+                 "combined with --stream." << std::endl;
+    std::terminate();
+  }
+  if (options.stream && options.shards > 0) {
+    std::cerr << "--shards needs the whole proteome in memory and cannot be "
+                 "combined with --stream." << std::endl;
+    std::terminate();
+  }
+  if (options.stream && options.pack) {
+    std::cerr << "--pack is not available with --stream." << std::endl;
+    std::terminate();
+  }
+  if (options.format == OutputFormat::kContainer && options.pack) {
+    std::cerr << "--pack is not available with --format container, whose "
+                 "residues are used in place." << std::endl;
+    std::terminate();
+  }
+  if (options.compress &&
+      (options.stream || options.pack ||
+       options.format == OutputFormat::kContainer)) {
+    std::cerr << "--compress is not available with --stream, --pack or "
+                 "--format container." << std::endl;
+    std::terminate();
+  }
+  bool update = !options.append_input.empty() ||
+                !options.remove_input.empty() || options.compact;
+  if (update && (options.stream || options.dedup || options.pack ||
+                 options.compress || options.shards > 0 || options.npy ||
+                 options.verify || !options.index_output.empty() ||
+                 options.format != OutputFormat::kContainer)) {
+    std::cerr << "--append, --remove and --compact update an existing "
+                 "container and need --format container; they take no other "
+                 "options but --threads." << std::endl;
+    std::terminate();
+  }
+  if (options.npy && (options.stream || options.shards > 0)) {
+    std::cerr << "--npy needs the whole proteome in one piece and cannot be "
+                 "combined with --stream or --shards." << std::endl;
+    std::terminate();
+  }
+  return options;
+}
+
+
+// Writes sequences, and their duplicate groups if any, as a cereal archive
+// at path or into container. Returns the archive's CRC32C, 0 for container.
+uint32_t write_sequences(const std::string& path, ContainerWriter* container,
+  const SequenceStore& sequences, const DuplicateGroups* groups) {
+  if (container) {
+    container->add_sequences(SectionId::kSequenceOffsets,
+                             SectionId::kResidues, sequences);
+    if (groups) {
+      container->add_groups(*groups);
+    }
+    return 0;
+  } else if (groups) {
+    return save(path, sequences, *groups);
+  } else {
+    return save(path, sequences);
+  }
+}
+
+
+// Checksum manifest entries name files relative to the output directory.
+std::string output_name(const std::string& path) {
+  return path.substr(path.rfind('/') + 1);
+}
+
+
+// Writes sequences as <base>_offsets.npy and <base>_residues.npy.
+void write_npy_sequences(const std::string& base,
+  const SequenceStore& sequences, std::vector<ChecksumEntry>& checksums) {
+  std::string offsets_output = base + "_offsets.npy";
+  std::string residues_output = base + "_residues.npy";
+  checksums.push_back({output_name(offsets_output), false,
+                       write_npy(offsets_output, sequences.offsets())});
+  checksums.push_back({output_name(residues_output), false,
+                       write_npy(residues_output, sequences.residues())});
+}
+
+
+std::string hex_hash(uint64_t hash) {
+  char hex[17];
+  snprintf(hex, sizeof(hex), "%016llx", static_cast<unsigned long long>(hash));
+  return hex;
 }
 
 
-int main(){
+// Parameters every container of a run records; the proteome container
+// adds the seed and matrix ones, shards their range.
+ContainerManifest base_manifest(const EncoderOptions& options,
+  uint64_t proteome_hash) {
+  return {{"proteome", output_name(options.proteome_input)},
+          {"proteome_xxh64", hex_hash(proteome_hash)},
+          {kManifestAlphabet, std::string(kAlphabet.begin(), kAlphabet.end())},
+          {"dedup", options.dedup ? "1" : "0"}};
+}
+
+
+// Whether the last run encoded step from the same input with the same
+// options, and its outputs are all still there; if so they become step's
+// outputs and their checksum entries are added to kept.
+bool reusable(InputCacheEntry& step,
+  const std::vector<InputCacheEntry>& cached,
+  const std::vector<ChecksumEntry>& previous_checksums,
+  std::vector<ChecksumEntry>& kept) {
+  for (const InputCacheEntry& entry: cached) {
+    if (!entry.same_key(step)) {
+      continue;
+    }
+    std::vector<ChecksumEntry> outputs;
+    for (const std::string& output: entry.outputs) {
+      auto it = std::find_if(previous_checksums.begin(),
+        previous_checksums.end(),
+        [&](const ChecksumEntry& c) { return c.file == output; });
+      if (it == previous_checksums.end() ||
+          !std::ifstream("output/" + output).good()) {
+        return false;
+      }
+      outputs.push_back(*it);
+    }
+    kept.insert(kept.end(), outputs.begin(), outputs.end());
+    step.outputs = entry.outputs;
+    return true;
+  }
+  return false;
+}
+
+
+// Removes <base>.<k> for k from first on, as far as they go: an earlier
+// run with more shards, or a sharded one before an unsharded run, leaves
+// them behind, and they would pass for part of this run's output.
+void remove_stale_shards(const std::string& base, size_t first) {
+  for (size_t k = first;; k++) {
+    if (std::remove((base + "." + std::to_string(k)).c_str()) != 0) {
+      break;
+    }
+  }
+}
+
+
+// Names of the checksum entries from first on.
+std::vector<std::string> output_names(
+  const std::vector<ChecksumEntry>& checksums, size_t first) {
+  std::vector<std::string> names;
+  for (size_t i = first; i < checksums.size(); i++) {
+    names.push_back(checksums[i].file);
+  }
+  return names;
+}
+
+
+int main(int argc, char** argv){
+  EncoderOptions options = parse_options(argc, argv);
+
+  // Every output of a run is listed here with its checksum.
+  std::string checksum_output = "output/checksums";
+  std::vector<ChecksumEntry> checksums;
+  if (options.verify) {
+    if (!verify_checksum_manifest(checksum_output)) {
+      std::cerr << "Outputs listed in " << checksum_output
+                << " are corrupt." << std::endl;
+      return 1;
+    }
+    std::cout << "Outputs listed in " << checksum_output << " are intact."
+              << std::endl;
+    return 0;
+  }
+
+  // With --format container, proteome, seeds and matrix all go to one file.
+  std::string container_output = "output/converge_container";
+  if (!options.append_input.empty() || !options.remove_input.empty()) {
+    std::vector<std::string> removed;
+    if (!options.remove_input.empty()) {
+      removed = read_file(options.remove_input);
+    }
+    ContainerUpdate update = append_to_container(container_output,
+      options.append_input, removed, options.num_threads);
+    std::cout << container_output << ": " << update.added << " sequences "
+              << "added, " << update.removed << " removed, " << update.live
+              << " live." << std::endl;
+  }
+  if (options.compact) {
+    ContainerUpdate update = compact_container(container_output);
+    std::cout << container_output << ": compacted to " << update.live
+              << " sequences, " << update.removed << " dropped." << std::endl;
+  }
+  // Every step's outputs, and which input and options produced them.
+  std::string cache_output = "output/input_hashes";
+  if (!options.append_input.empty() || !options.remove_input.empty() ||
+      options.compact) {
+    // The container no longer matches its inputs.
+    std::remove(cache_output.c_str());
+    // The checksum manifest lists the container without a sum of its own,
+    // so it still holds; the updated sections are checked here.
+    return MappedContainer(container_output).verify() ? 0 : 1;
+  }
+
+  std::string proteome_input = options.proteome_input;
+  std::string seed_input = "input/initial.fasta";
+  std::string blosum_input = "input/BLOSUM62";
+  bool container_format = options.format == OutputFormat::kContainer;
+  std::string format = container_format ? "container" : "cereal";
+  std::string npy = options.npy ? "1" : "0";
+  // Outputs of an older layout are encoded again. The proteome's header
+  // sidecar is a container in either format.
+  std::string container_version = std::to_string(kContainerVersion);
+  std::string layout = container_format ?
+    " container_version=" + container_version : "";
+  InputCacheEntry proteome_step{"proteome", hash_input(proteome_input),
+    "format=" + format + " stream=" + (options.stream ? "1" : "0") +
+    " dedup=" + (options.dedup ? "1" : "0") +
+    " pack=" + (options.pack ? "1" : "0") +
+    " compress=" + (options.compress ? "1" : "0") +
+    " shards=" + std::to_string(options.shards) + " npy=" + npy +
+    " name=" + output_name(proteome_input) +
+    " version=" + std::to_string(kSequenceStoreVersion) +
+    " container_version=" + container_version, {}};
+  InputCacheEntry seed_step{"seeds", hash_input(seed_input),
+    "format=" + format +
+    " windows=" + windowing_labels(options.seed_windowings) +
+    " version=" + std::to_string(kSeedSetsVersion) + " npy=" + npy + layout,
+    {}};
+  InputCacheEntry matrix_step{"matrix", hash_input(blosum_input),
+    "format=" + format + " npy=" + npy + layout, {}};
+  bool reuse_proteome = false;
+  bool reuse_seeds = false;
+  bool reuse_matrix = false;
+  // The .fai index lives outside the output directory and is not tracked.
+  if (options.cache && options.index_output.empty()) {
+    std::vector<InputCacheEntry> cached = read_input_cache(cache_output);
+    std::vector<ChecksumEntry> previous_checksums;
+    if (std::ifstream(checksum_output).good()) {
+      previous_checksums = read_checksum_manifest(checksum_output);
+    }
+    reuse_proteome = reusable(proteome_step, cached, previous_checksums,
+                              checksums);
+    reuse_seeds = reusable(seed_step, cached, previous_checksums, checksums);
+    reuse_matrix = reusable(matrix_step, cached, previous_checksums,
+                            checksums);
+    // A container holds all three, so it is kept whole or written anew.
+    if (container_format &&
+        !(reuse_proteome && reuse_seeds && reuse_matrix)) {
+      reuse_proteome = reuse_seeds = reuse_matrix = false;
+      checksums.clear();
+    }
+  }
+  // In container mode the steps are reused all together or not at all.
+  std::unique_ptr<ContainerWriter> container;
+  if (container_format && !reuse_proteome) {
+    container = std::make_unique<ContainerWriter>(container_output);
+  }
+
   //  Encode proteome into vector<pair<string, string>>
   // save fasta seq and names separately.
-  std::string proteome_input = "input/proteome.fasta";
   std::string proteome_output = "output/proteome_binary";
+  // Headers go to their own container so that readers of the sequences
+  // never pass through them; see MappedContainer::resolve_headers().
+  std::string headers_output = "output/proteome_headers";
+  // With --shards, sequences go to <proteome or container output>.<k>
+  // instead, listed in the manifest.
+  std::string shard_manifest_output = "output/proteome_shards";
   
-  std::vector<std::string> headers;
-  std::vector<std::vector<int>> sequences;
-  load_fasta_sequences(proteome_input, headers, sequences);
-  save(proteome_output, headers, sequences);
-  std::cout << proteome_input << " has " << sequences.size() << " sequences."
-  << std::endl;
-
-// Encode seed into vector<string>, each of spacing 10
-  std::string seed_input = "input/initial.fasta";
+  size_t num_sequences = 0;
+  size_t first_output = checksums.size();
+  if (!reuse_proteome) {
+    remove_stale_shards(container ? container_output : proteome_output,
+                        options.shards);
+    if (options.shards == 0) {
+      std::remove(shard_manifest_output.c_str());
+    }
+  }
+  if (reuse_proteome) {
+    std::cout << proteome_input << " is unchanged; keeping its outputs."
+              << std::endl;
+  } else if (options.stream) {
+    uint32_t proteome_checksum = 0;
+    num_sequences = container ?
+      stream_encode_fasta(proteome_input, *container,
+        options.stream_buffer_size, options.num_threads,
+        options.index_output) :
+      stream_encode_fasta(proteome_input, proteome_output, headers_output,
+        options.stream_buffer_size, options.num_threads,
+        options.index_output, &proteome_checksum);
+    if (!container) {
+      checksums.push_back({output_name(proteome_output), false,
+                           proteome_checksum});
+      checksums.push_back({output_name(headers_output), true});
+    }
+    std::cout << proteome_input << " has " << num_sequences << " sequences."
+              << std::endl;
+  } else {
+    HeaderStore headers;
+    SequenceStore sequences;
+    std::vector<FaiEntry> index;
+    bool with_index = !options.index_output.empty();
+    load_fasta_sequences(proteome_input, headers, sequences,
+                         options.num_threads, with_index ? &index : nullptr);
+    if (with_index) {
+      write_fasta_index(options.index_output, index);
+    }
+    num_sequences = sequences.size();
+    std::cout << proteome_input << " has " << num_sequences
+              << " sequences." << std::endl;
+    if (options.pack) {
+      sequences.set_encoding(ResidueEncoding::kPacked);
+    }
+    if (options.compress) {
+      sequences.set_encoding(ResidueEncoding::kRans);
+      sequences.set_num_threads(options.num_threads);
+    }
+    DuplicateGroups groups;
+    if (options.dedup) {
+      // The groups follow the sequences; unique sequence i belongs to the
+      // headers listed in groups.
+      groups = collapse_duplicates(sequences);
+      std::cout << proteome_input << " has " << sequences.size()
+                << " unique sequences." << std::endl;
+    }
+    if (options.npy) {
+      write_npy_sequences("output/proteome", sequences, checksums);
+      if (options.dedup) {
+        std::string offsets_output = "output/proteome_group_offsets.npy";
+        std::string members_output = "output/proteome_group_members.npy";
+        checksums.push_back({output_name(offsets_output), false,
+                             write_npy(offsets_output, groups.member_offsets)});
+        checksums.push_back({output_name(members_output), false,
+                             write_npy(members_output, groups.members)});
+      }
+    }
+    if (options.shards == 0) {
+      uint32_t checksum = write_sequences(proteome_output, container.get(),
+        sequences, options.dedup ? &groups : nullptr);
+      if (!container) {
+        checksums.push_back({output_name(proteome_output), false, checksum});
+      }
+    } else {
+      // Shards hold the same sections as the unsharded output, for their
+      // own sequences only; headers and seeds stay in the shared output.
+      std::vector<ShardRange> shards =
+        partition_by_residues(sequences, options.shards);
+      std::string shard_base = container ? container_output : proteome_output;
+      for (size_t k = 0; k < shards.size(); k++) {
+        ShardRange& shard = shards[k];
+        std::string shard_output = shard_base + "." + std::to_string(k);
+        shard.file = shard_output.substr(shard_output.rfind('/') + 1);
+        SequenceStore shard_sequences =
+          sequences.slice(shard.first, shard.count);
+        DuplicateGroups shard_groups;
+        if (options.dedup) {
+          shard_groups = groups.slice(shard.first, shard.count);
+        }
+        std::unique_ptr<ContainerWriter> shard_container;
+        if (container) {
+          shard_container = std::make_unique<ContainerWriter>(shard_output);
+        }
+        uint32_t checksum = write_sequences(shard_output,
+          shard_container.get(), shard_sequences,
+          options.dedup ? &shard_groups : nullptr);
+        if (shard_container) {
+          ContainerManifest manifest =
+            base_manifest(options, proteome_step.input_hash);
+          manifest.emplace_back("shard", std::to_string(k));
+          manifest.emplace_back("shards", std::to_string(shards.size()));
+          manifest.emplace_back("shard_first", std::to_string(shard.first));
+          manifest.emplace_back("shard_count", std::to_string(shard.count));
+          shard_container->add_manifest(manifest);
+          shard_container->close();
+        }
+        checksums.push_back({shard.file, container != nullptr, checksum});
+        std::cout << shard.file << " has " << shard.count << " sequences, "
+                  << shard.residues << " residues." << std::endl;
+      }
+      write_shard_manifest(shard_manifest_output, shards);
+      checksums.push_back({output_name(shard_manifest_output), false,
+                           file_crc32c(shard_manifest_output)});
+    }
+    if (container) {
+      container->add_headers(headers);
+    } else {
+      write_header_container(headers_output, headers);
+      checksums.push_back({output_name(headers_output), true});
+    }
+  }
+
+  if (!reuse_proteome) {
+    proteome_step.outputs = output_names(checksums, first_output);
+  }
+
+// Encode seed into windows, see src/seed_windows.hpp
   std::string seed_output = "output/seed_seq_binary";
-  std::vector<std::vector<int>> seed_seqs = load_seed_seq(seed_input);
-  save(seed_output, seed_seqs);
-  std::cout << seed_input << " has " << seed_seqs.size() << " sequences."
-            << std::endl;
-  
+  first_output = checksums.size();
+  if (reuse_seeds) {
+    std::cout << seed_input << " is unchanged; keeping its outputs."
+              << std::endl;
+  } else {
+    SeedSets seeds = load_seed_seq(seed_input, options.seed_windowings);
+    if (container) {
+      container->add_seeds(seeds);
+    } else {
+      checksums.push_back({output_name(seed_output), false,
+                           save(seed_output, seeds)});
+    }
+    if (options.npy) {
+      write_npy_sequences("output/seed", seeds.sources(), checksums);
+      for (size_t i = 0; i < seeds.size(); i++) {
+        SeedSetView set = seeds[i];
+        std::string windows_output = seeds.size() == 1 ?
+          "output/seed_windows.npy" :
+          "output/seed_windows_" + set.label() + ".npy";
+        checksums.push_back({output_name(windows_output), false,
+                             write_npy(windows_output, set.windows().data(),
+                                       sizeof(uint32_t),
+                                       npy_dtype<uint32_t>(),
+                                       {set.size(), 2})});
+      }
+    }
+    std::cout << seed_input << " has " << seeds.sources().size()
+              << " sequences";
+    for (size_t i = 0; i < seeds.size(); i++) {
+      std::cout << ", " << seeds[i].size() << " " << seeds[i].label()
+                << " windows";
+    }
+    std::cout << "." << std::endl;
+    seed_step.outputs = output_names(checksums, first_output);
+  }
+
 // Encode blosum
-  std::string blosum_input = "input/BLOSUM62";
   std::string blosum_output = "output/blosum_binary";
-  std::vector<std::vector<double>> kBlosum = read_blosum(blosum_input);
-  save(blosum_output, kBlosum);
-  std::cout << blosum_input << " has " << kBlosum.size() << " rows."
-            << std::endl;
-  
-// Test seed_seq
-  std::vector<std::vector<int>> test_seed_seqs;
-  load(seed_output, test_seed_seqs);
-  assert(test_seed_seqs.size() == seed_seqs.size());
-  for (size_t i=0;i<test_seed_seqs.size();i++){
-    std::vector<int> test_seq = test_seed_seqs[i];
-    std::vector<int> act_seq = seed_seqs[i];
-    assert(test_seq.size() == act_seq.size());
-    for (size_t j=0;j<test_seq.size();j++){
-      assert(test_seq[j] == act_seq[j]);
+  first_output = checksums.size();
+  if (reuse_matrix) {
+    std::cout << blosum_input << " is unchanged; keeping its outputs."
+              << std::endl;
+  } else {
+    std::vector<std::vector<double>> kBlosum = read_blosum(blosum_input);
+    if (container) {
+      container->add_matrix(kBlosum);
+      ContainerManifest manifest =
+        base_manifest(options, proteome_step.input_hash);
+      // Sharded sequences are in the shard containers, not this one.
+      if (options.shards == 0) {
+        manifest.emplace_back("sequences", std::to_string(num_sequences));
+      } else {
+        manifest.emplace_back("shards", std::to_string(options.shards));
+        manifest.emplace_back("shard_manifest",
+                              output_name(shard_manifest_output));
+      }
+      manifest.emplace_back("seeds", output_name(seed_input));
+      manifest.emplace_back("seeds_xxh64", hex_hash(seed_step.input_hash));
+      manifest.emplace_back("seed_length",
+                            std::to_string(options.seed_windowings[0].length));
+      manifest.emplace_back("seed_stride",
+                            std::to_string(options.seed_windowings[0].stride));
+      manifest.emplace_back("seed_sets",
+                            windowing_labels(options.seed_windowings));
+      manifest.emplace_back("matrix", output_name(blosum_input));
+      manifest.emplace_back("matrix_xxh64", hex_hash(matrix_step.input_hash));
+      container->add_manifest(manifest);
+      container->close();
+      checksums.push_back({output_name(container_output), true});
+    } else {
+      checksums.push_back({output_name(blosum_output), false,
+                           save(blosum_output, kBlosum)});
+    }
+    if (options.npy) {
+      std::string npy_output = "output/blosum.npy";
+      std::vector<double> values;
+      for (const std::vector<double>& row: kBlosum) {
+        values.insert(values.end(), row.begin(), row.end());
+      }
+      checksums.push_back({output_name(npy_output), false,
+                           write_npy(npy_output, values.data(),
+                                     sizeof(double), npy_dtype<double>(),
+                                     {kBlosum.size(), kBlosum[0].size()})});
     }
+    std::cout << blosum_input << " has " << kBlosum.size() << " rows."
+              << std::endl;
+    matrix_step.outputs = output_names(checksums, first_output);
+  }
+  
+// Read everything back once to check it reached the disk as written.
+  write_checksum_manifest(checksum_output, checksums);
+  if (!verify_checksum_manifest(checksum_output)) {
+    std::cerr << "Outputs listed in " << checksum_output
+              << " do not match what was written." << std::endl;
+    std::terminate();
   }
+  write_input_cache(cache_output, {proteome_step, seed_step, matrix_step});
 }
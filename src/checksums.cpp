@@ -0,0 +1,126 @@
+#include "checksums.hpp"
+
+#include <cstdio>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include "container.hpp"
+#include "mapped_file.hpp"
+
+
+namespace {
+
+constexpr char kContainerTag[] = "container";
+
+
+std::string sibling_path(const std::string& manifest, const std::string& file) {
+  size_t slash = manifest.rfind('/');
+  return slash == std::string::npos ? file :
+         manifest.substr(0, slash + 1) + file;
+}
+
+}  // namespace
+
+
+uint32_t file_crc32c(const std::string& filename) {
+  MappedFile file(filename);
+  return crc32c(file.data(), file.size());
+}
+
+
+void write_checksum_manifest(const std::string& filename,
+  const std::vector<ChecksumEntry>& entries) {
+  std::ofstream file(filename);
+  if (!file.is_open()) {
+    std::cout << "File " << filename << " failed to open" << std::endl;
+    std::terminate();
+  }
+  for (const ChecksumEntry& entry: entries) {
+    if (entry.container) {
+      file << kContainerTag;
+    } else {
+      char hex[9];
+      snprintf(hex, sizeof(hex), "%08x", entry.crc32c);
+      file << hex;
+    }
+    file << "  " << entry.file << '\n';
+  }
+}
+
+
+std::vector<ChecksumEntry> read_checksum_manifest(const std::string& filename) {
+  std::ifstream file(filename);
+  if (!file.is_open()) {
+    std::cout << "File " << filename << " failed to open" << std::endl;
+    std::terminate();
+  }
+  std::vector<ChecksumEntry> entries;
+  std::string line;
+  while (std::getline(file, line)) {
+    if (line.empty()) {
+      continue;
+    }
+    size_t separator = line.find("  ");
+    ChecksumEntry entry;
+    bool valid = separator != std::string::npos &&
+                 separator + 2 < line.size();
+    if (valid) {
+      std::string sum = line.substr(0, separator);
+      entry.file = line.substr(separator + 2);
+      entry.container = sum == kContainerTag;
+      if (!entry.container) {
+        std::istringstream hex(sum);
+        hex >> std::hex >> entry.crc32c;
+        valid = sum.size() == 8 && !hex.fail() && hex.eof();
+      }
+    }
+    if (!valid) {
+      std::cerr << "File " << filename << " has a malformed line: " << line
+                << std::endl;
+      std::terminate();
+    }
+    entries.push_back(std::move(entry));
+  }
+  return entries;
+}
+
+
+bool verify_checksum_manifest(const std::string& filename) {
+  bool intact = true;
+  for (const ChecksumEntry& entry: read_checksum_manifest(filename)) {
+    std::string path = sibling_path(filename, entry.file);
+    if (entry.container) {
+      intact = MappedContainer(path).verify() && intact;
+      continue;
+    }
+    if (file_crc32c(path) != entry.crc32c) {
+      std::cerr << "File " << path << " does not match its checksum"
+                << std::endl;
+      intact = false;
+    }
+  }
+  return intact;
+}
+
+
+std::streamsize Crc32cStreambuf::xsputn(const char* data, std::streamsize n) {
+  std::streamsize written = target_->sputn(data, n);
+  checksum_ = crc32c(data, static_cast<size_t>(written), checksum_);
+  return written;
+}
+
+
+Crc32cStreambuf::int_type Crc32cStreambuf::overflow(int_type c) {
+  if (traits_type::eq_int_type(c, traits_type::eof())) {
+    return traits_type::not_eof(c);
+  }
+  char byte = traits_type::to_char_type(c);
+  return xsputn(&byte, 1) == 1 ? c : traits_type::eof();
+}
+
+
+int Crc32cStreambuf::sync() {
+  return target_->pubsync();
+}
@@ -0,0 +1,50 @@
+#ifndef CONVERGE_ENCODER_CHECKSUMS_HPP_
+#define CONVERGE_ENCODER_CHECKSUMS_HPP_
+
+#include <cstdint>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+#include "crc32c.hpp"
+
+// One output file of a run. Containers carry a CRC32C per section (see
+// container.hpp); every other file is covered by the CRC32C of its bytes.
+struct ChecksumEntry {
+  std::string file;
+  bool container = false;
+  uint32_t crc32c = 0;
+};
+
+// CRC32C of a whole file, read through a mapping.
+uint32_t file_crc32c(const std::string& filename);
+
+// The checksum manifest is one line per file: the CRC32C in hex, or
+// "container", two spaces, and the file name relative to the manifest.
+void write_checksum_manifest(const std::string& filename,
+  const std::vector<ChecksumEntry>& entries);
+std::vector<ChecksumEntry> read_checksum_manifest(const std::string& filename);
+
+// Checks every file listed in the manifest, reporting each mismatch on
+// std::cerr. Files are read once, front to back, without being parsed.
+bool verify_checksum_manifest(const std::string& filename);
+
+// Forwards writes to another streambuf, keeping the CRC32C of what went
+// through, so that a cereal archive is checksummed as it is written.
+class Crc32cStreambuf : public std::streambuf {
+ public:
+  explicit Crc32cStreambuf(std::streambuf* target) : target_(target) {}
+
+  uint32_t checksum() const { return checksum_; }
+
+ protected:
+  std::streamsize xsputn(const char* data, std::streamsize n) override;
+  int_type overflow(int_type c) override;
+  int sync() override;
+
+ private:
+  std::streambuf* target_;
+  uint32_t checksum_ = 0;
+};
+
+#endif  // CONVERGE_ENCODER_CHECKSUMS_HPP_
@@ -0,0 +1,408 @@
+#include "container.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <iostream>
+
+#include "crc32c.hpp"
+#include "residue_encoder.hpp"
+
+
+namespace {
+
+constexpr bool same_letters() {
+  for (size_t i = 0; i < kAlphabet.size(); i++) {
+    if (kResidueLetters[i] != kAlphabet[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static_assert(kResidueCodes == kAlphabet.size() && same_letters(),
+              "containers are read with the encoder's alphabet");
+
+}  // namespace
+
+
+ContainerWriter::ContainerWriter(const std::string& filename,
+  size_t buffer_size)
+  : filename_(filename), file_(filename, buffer_size) {
+  // Filled in by close().
+  ContainerHeader header{};
+  file_.write(&header, sizeof(header));
+}
+
+
+ContainerWriter::ContainerWriter(const std::string& filename,
+  const MappedContainer& existing, size_t buffer_size)
+  : filename_(filename), file_(filename, buffer_size, true),
+    sections_(existing.directory()), segment_(existing.segment_count()) {
+  // Sections of both byte orders, or some without checksums, cannot share
+  // a header that describes them all.
+  if (existing.foreign() || existing.version() < 2) {
+    std::cerr << "File " << filename << " has to be compacted before "
+                 "anything can be appended to it" << std::endl;
+    std::terminate();
+  }
+  // Drop whatever an interrupted update left past the directory.
+  file_.truncate(existing.file_size());
+}
+
+
+void ContainerWriter::pad_to_alignment() {
+  static const char kPadding[kSectionAlignment] = {};
+  file_.write(kPadding, (kSectionAlignment - file_.tell() % kSectionAlignment)
+                        % kSectionAlignment);
+}
+
+
+void ContainerWriter::begin_section(SectionId id, uint32_t element_size) {
+  pad_to_alignment();
+  SectionEntry entry{};
+  entry.id = static_cast<uint32_t>(id);
+  entry.element_size = element_size;
+  entry.offset = file_.tell();
+  entry.segment = segment_;
+  sections_.push_back(entry);
+  in_section_ = true;
+  file_.reset_checksum();
+}
+
+
+void ContainerWriter::end_section() {
+  sections_.back().size = file_.tell() - sections_.back().offset;
+  sections_.back().crc32c = file_.checksum();
+  in_section_ = false;
+}
+
+
+void ContainerWriter::add_section(SectionId id, const void* data, size_t size,
+  uint32_t element_size) {
+  begin_section(id, element_size);
+  file_.write(data, size);
+  end_section();
+}
+
+
+void ContainerWriter::add_sequences(SectionId offsets, SectionId residues,
+  const SequenceStore& sequences) {
+  add_section(offsets, sequences.offsets());
+  add_section(residues, sequences.residues());
+}
+
+
+void ContainerWriter::add_column(SectionId offsets, SectionId elements,
+  const StringColumn& column) {
+  add_section(offsets, column.offsets());
+  add_section(elements, column.arena().data(), column.arena().size(), 1);
+}
+
+
+void ContainerWriter::add_headers(const HeaderStore& headers) {
+  add_column(SectionId::kHeaderOffsets, SectionId::kHeaders,
+             headers.headers());
+  add_column(SectionId::kDatabaseOffsets, SectionId::kDatabases,
+             headers.databases());
+  add_column(SectionId::kAccessionOffsets, SectionId::kAccessions,
+             headers.accessions());
+  add_column(SectionId::kEntryNameOffsets, SectionId::kEntryNames,
+             headers.entry_names());
+}
+
+
+void ContainerWriter::add_groups(const DuplicateGroups& groups) {
+  add_section(SectionId::kGroupOffsets, groups.member_offsets);
+  add_section(SectionId::kGroupMembers, groups.members);
+}
+
+
+void ContainerWriter::add_seeds(const SeedSets& seeds) {
+  add_sequences(SectionId::kSeedOffsets, SectionId::kSeedResidues,
+                seeds.sources());
+  // Written as 32-bit words so that a reader of the other byte order
+  // reverses each field on its own.
+  std::vector<uint64_t> entries;
+  uint64_t first = 0;
+  begin_section(SectionId::kSeedWindows, sizeof(uint32_t));
+  for (size_t i = 0; i < seeds.size(); i++) {
+    SeedSetView set = seeds[i];
+    entries.insert(entries.end(), {set.windowing().length,
+                                   set.windowing().stride, first,
+                                   set.size()});
+    first += set.size();
+    file_.write(set.windows().data(), set.size() * sizeof(SeedWindow));
+  }
+  end_section();
+  add_section(SectionId::kSeedSets, entries);
+}
+
+
+void ContainerWriter::add_matrix(
+  const std::vector<std::vector<double>>& matrix) {
+  std::vector<double> values;
+  for (const std::vector<double>& row: matrix) {
+    values.insert(values.end(), row.begin(), row.end());
+  }
+  add_section(SectionId::kMatrix, values);
+}
+
+
+void ContainerWriter::add_manifest(const ContainerManifest& manifest) {
+  std::string text;
+  for (const auto& entry: manifest) {
+    text += entry.first + "=" + entry.second + "\n";
+  }
+  add_section(SectionId::kManifest, text.data(), text.size(), 1);
+}
+
+
+void ContainerWriter::close() {
+  if (in_section_) {
+    end_section();
+  }
+  pad_to_alignment();
+  ContainerHeader header{};
+  memcpy(header.magic, kContainerMagic, sizeof(header.magic));
+  header.version = kContainerVersion;
+  header.byte_order = kByteOrderMark;
+  header.offset_size = sizeof(uint64_t);
+  header.real_size = sizeof(double);
+  header.section_count = static_cast<uint32_t>(sections_.size());
+  header.directory_offset = file_.tell();
+  size_t directory_size = sections_.size() * sizeof(SectionEntry);
+  header.file_size = header.directory_offset + directory_size;
+  header.directory_crc32c = crc32c(sections_.data(), directory_size);
+  header.header_crc32c = crc32c(&header, sizeof(header));
+  file_.write(sections_.data(), directory_size);
+  // Until the header is patched it describes the previous contents, so the
+  // new sections and directory have to be on disk before it changes.
+  file_.sync();
+  file_.patch(0, &header, sizeof(header));
+  file_.sync();
+  file_.close();
+}
+
+
+MappedContainer::MappedContainer(const std::string& filename)
+  : filename_(filename), file_(filename, false), layout_(filename_.c_str()) {
+  layout_.open(file_.data(), file_.size(), crc32c,
+               [this] { return file_.writable_data(); });
+}
+
+
+bool MappedContainer::verify() const {
+  if (version() < 2) {
+    std::cerr << "File " << filename_ << " is a version " << version()
+              << " container, which has no checksums" << std::endl;
+    return false;
+  }
+  bool intact = true;
+  for (size_t i = 0; i < layout_.section_count(); i++) {
+    const SectionEntry& entry = layout_.directory()[i];
+    if (section_checksum(entry) != entry.crc32c) {
+      std::cerr << "File " << filename_ << " section " << entry.id
+                << " does not match its checksum" << std::endl;
+      intact = false;
+    }
+  }
+  return intact;
+}
+
+
+uint32_t MappedContainer::section_checksum(const SectionEntry& entry) const {
+  const char* data = layout_.data(entry);
+  if (!foreign() || entry.element_size < 2) {
+    return crc32c(data, entry.size);
+  }
+  // The CRC covers the bytes as written, so reverse them back a chunk at a
+  // time.
+  std::vector<char> chunk(size_t(1) << 16);
+  size_t chunk_elements = chunk.size() / entry.element_size;
+  size_t elements = entry.size / entry.element_size;
+  uint32_t crc = 0;
+  for (size_t first = 0; first < elements; first += chunk_elements) {
+    size_t count = std::min(chunk_elements, elements - first);
+    size_t bytes = count * entry.element_size;
+    memcpy(chunk.data(), data + first * entry.element_size, bytes);
+    reverse_bytes(chunk.data(), count, entry.element_size);
+    crc = crc32c(chunk.data(), bytes, crc);
+  }
+  return crc;
+}
+
+
+bool MappedContainer::has_section(SectionId id, uint32_t segment) const {
+  return layout_.find(id, segment) != nullptr;
+}
+
+
+const SectionEntry& MappedContainer::section(SectionId id,
+  uint32_t segment) const {
+  return layout_.section(id, segment);
+}
+
+
+const char* MappedContainer::section_data(SectionId id,
+  uint32_t segment) const {
+  return layout_.data(section(id, segment));
+}
+
+
+SequenceView MappedContainer::sequence_view(SectionId offsets,
+  SectionId residues, uint32_t segment) const {
+  SequenceView view;
+  view.offsets = layout_.csr(offsets, residues, segment, view.residues,
+                             view.count);
+  return view;
+}
+
+
+StringColumnView MappedContainer::column_view(SectionId offsets,
+  SectionId arena, uint32_t segment) const {
+  StringColumnView view;
+  view.offsets = layout_.csr(offsets, arena, segment, view.arena,
+                             view.count);
+  return view;
+}
+
+
+SequenceView MappedContainer::sequences(uint32_t segment) const {
+  return sequence_view(SectionId::kSequenceOffsets, SectionId::kResidues,
+                       segment);
+}
+
+
+StringColumnView MappedContainer::headers(uint32_t segment) const {
+  return column_view(SectionId::kHeaderOffsets, SectionId::kHeaders, segment);
+}
+
+
+StringColumnView MappedContainer::databases(uint32_t segment) const {
+  return column_view(SectionId::kDatabaseOffsets, SectionId::kDatabases,
+                     segment);
+}
+
+
+StringColumnView MappedContainer::accessions(uint32_t segment) const {
+  return column_view(SectionId::kAccessionOffsets, SectionId::kAccessions,
+                     segment);
+}
+
+
+StringColumnView MappedContainer::entry_names(uint32_t segment) const {
+  return column_view(SectionId::kEntryNameOffsets, SectionId::kEntryNames,
+                     segment);
+}
+
+
+size_t MappedContainer::total_sequences() const {
+  size_t total = 0;
+  for (uint32_t segment = 0; segment < segment_count(); segment++) {
+    total += sequences(segment).size();
+  }
+  return total;
+}
+
+
+TombstoneView MappedContainer::tombstones() const {
+  TombstoneView view;
+  view.words = layout_.tombstones(view.word_count);
+  return view;
+}
+
+
+size_t TombstoneView::count() const {
+  size_t deleted = 0;
+  for (size_t i = 0; i < word_count; i++) {
+    deleted += static_cast<size_t>(__builtin_popcountll(words[i]));
+  }
+  return deleted;
+}
+
+
+size_t MappedContainer::seed_set_count() const {
+  return layout_.seed_set_count();
+}
+
+
+SeedView MappedContainer::seeds(size_t set) const {
+  SeedView view;
+  layout_.seed_set(set, view.windows, view.count, view.length, view.stride);
+  view.sources =
+    sequence_view(SectionId::kSeedOffsets, SectionId::kSeedResidues, 0);
+  if (view.windows == nullptr) {
+    view.count = view.sources.size();
+    return view;
+  }
+  for (size_t i = 0; i < view.count; i++) {
+    const SeedWindow& window = view.windows[i];
+    if (window.source >= view.sources.size() ||
+        window.start + view.length > view.sources[window.source].size) {
+      layout_.fail("has seed window ", i, " of set ", set,
+                   " outside the seed sequences");
+    }
+  }
+  return view;
+}
+
+
+MatrixView MappedContainer::matrix() const {
+  MatrixView view;
+  view.values = layout_.matrix();
+  view.rows = kAlphabet.size();
+  view.cols = kAlphabet.size();
+  return view;
+}
+
+
+std::vector<std::pair<std::string_view, std::string_view>>
+MappedContainer::manifest() const {
+  std::vector<std::pair<std::string_view, std::string_view>> entries;
+  layout_.visit_manifest([&](std::string_view key, std::string_view value) {
+    entries.emplace_back(key, value);
+    return true;
+  });
+  return entries;
+}
+
+
+std::string_view MappedContainer::manifest_value(std::string_view key) const {
+  std::string_view value;
+  if (!layout_.manifest_value(key, value)) {
+    layout_.fail("has no manifest entry ", key);
+  }
+  return value;
+}
+
+
+std::vector<std::string_view> MappedContainer::resolve_headers(
+  const std::vector<uint64_t>& indices) const {
+  // firsts[k] is the number of the first sequence of segment k.
+  std::vector<StringColumnView> columns;
+  std::vector<uint64_t> firsts{0};
+  for (uint32_t segment = 0; segment < segment_count(); segment++) {
+    columns.push_back(headers(segment));
+    firsts.push_back(firsts.back() + columns.back().size());
+  }
+  std::vector<std::string_view> resolved;
+  resolved.reserve(indices.size());
+  for (uint64_t i: indices) {
+    if (i >= firsts.back()) {
+      layout_.fail("has no header ", i);
+    }
+    size_t segment = static_cast<size_t>(
+      std::upper_bound(firsts.begin(), firsts.end(), i) - firsts.begin() - 1);
+    resolved.push_back(columns[segment][i - firsts[segment]]);
+  }
+  return resolved;
+}
+
+
+void write_header_container(const std::string& filename,
+  const HeaderStore& headers) {
+  ContainerWriter container(filename);
+  container.add_headers(headers);
+  container.close();
+}
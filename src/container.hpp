@@ -0,0 +1,222 @@
+#ifndef CONVERGE_ENCODER_CONTAINER_HPP_
+#define CONVERGE_ENCODER_CONTAINER_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "converge_encoder/container_format.hpp"
+#include "converge_encoder/container_layout.hpp"
+#include "dedup.hpp"
+#include "header_store.hpp"
+#include "mapped_file.hpp"
+#include "output_file.hpp"
+#include "seed_windows.hpp"
+#include "sequence_store.hpp"
+
+// Parameters the container was encoded with (seed length and stride,
+// alphabet, matrix name, ...), so that a reader can refuse inputs that do
+// not belong together. Keys are unique and contain no '='; neither keys
+// nor values contain newlines.
+using ContainerManifest = std::vector<std::pair<std::string, std::string>>;
+
+
+class MappedContainer;
+
+
+// Writes a container front to back. Sections are either added whole or
+// streamed: begin_section(), any number of file().write() or
+// file().append_file(), end_section().
+class ContainerWriter {
+ public:
+  ContainerWriter(const std::string& filename, size_t buffer_size = 1 << 22);
+  // Adds a segment to existing, which must map filename: the new sections
+  // go after its end, and close() writes a directory of old and new ones.
+  // The existing bytes are not touched until close() rewrites the header.
+  ContainerWriter(const std::string& filename, const MappedContainer& existing,
+                  size_t buffer_size = 1 << 22);
+
+  const std::string& filename() const { return filename_; }
+  OutputFile& file() { return file_; }
+
+  void begin_section(SectionId id, uint32_t element_size);
+  void end_section();
+  void add_section(SectionId id, const void* data, size_t size,
+                   uint32_t element_size);
+  template <class T>
+  void add_section(SectionId id, const std::vector<T>& values) {
+    add_section(id, values.data(), values.size() * sizeof(T), sizeof(T));
+  }
+
+  void add_sequences(SectionId offsets, SectionId residues,
+                     const SequenceStore& sequences);
+  void add_headers(const HeaderStore& headers);
+  void add_groups(const DuplicateGroups& groups);
+  void add_seeds(const SeedSets& seeds);
+  void add_matrix(const std::vector<std::vector<double>>& matrix);
+  void add_manifest(const ContainerManifest& manifest);
+
+  // Writes the directory and fills in the header.
+  void close();
+
+ private:
+  void add_column(SectionId offsets, SectionId elements,
+                  const StringColumn& column);
+  void pad_to_alignment();
+
+  std::string filename_;
+  OutputFile file_;
+  std::vector<SectionEntry> sections_;
+  uint32_t segment_ = 0;
+  bool in_section_ = false;
+};
+
+
+// Span-like views into a mapped container; they stay valid as long as the
+// MappedContainer does.
+struct SequenceView {
+  const uint64_t* offsets = nullptr;
+  const Residue* residues = nullptr;
+  size_t count = 0;
+
+  size_t size() const { return count; }
+  size_t total_residues() const { return offsets[count] - offsets[0]; }
+  ResidueSpan operator[](size_t i) const {
+    return {residues + offsets[i],
+            static_cast<size_t>(offsets[i + 1] - offsets[i])};
+  }
+};
+
+// One set of seed windows of length residues located in the seed
+// sequences. Before container version 5 the windows were stored as
+// sequences of their own, and there are no window positions.
+struct SeedView {
+  SequenceView sources;
+  const SeedWindow* windows = nullptr;
+  size_t count = 0;
+  size_t length = 0;
+  size_t stride = 0;
+
+  size_t size() const { return count; }
+  ResidueSpan operator[](size_t i) const {
+    if (windows == nullptr) {
+      return sources[i];
+    }
+    return {sources[windows[i].source].data + windows[i].start, length};
+  }
+};
+
+struct StringColumnView {
+  const uint64_t* offsets = nullptr;
+  const char* arena = nullptr;
+  size_t count = 0;
+
+  size_t size() const { return count; }
+  std::string_view operator[](size_t i) const {
+    return std::string_view(arena + offsets[i], offsets[i + 1] - offsets[i]);
+  }
+};
+
+// Bit i is set if sequence i, numbered across segments, is deleted.
+struct TombstoneView {
+  const uint64_t* words = nullptr;
+  size_t word_count = 0;
+
+  bool operator[](uint64_t i) const {
+    return i / 64 < word_count && (words[i / 64] >> (i % 64) & 1) != 0;
+  }
+  size_t count() const;
+};
+
+struct MatrixView {
+  const double* values = nullptr;
+  size_t rows = 0;
+  size_t cols = 0;
+
+  const double* operator[](size_t row) const { return values + row * cols; }
+};
+
+
+// Read-only mapping of a container. Opening checks the header, the
+// directory, every section's bounds and the manifest's alphabet, as
+// converge_encoder::Reader does with the same ContainerLayout, but reads
+// no other section data, unless the container is in the other byte order
+// and has to be reversed; verify() does.
+class MappedContainer {
+ public:
+  explicit MappedContainer(const std::string& filename);
+
+  MappedContainer(const MappedContainer&) = delete;
+  MappedContainer& operator=(const MappedContainer&) = delete;
+
+  uint32_t version() const { return layout_.version(); }
+  // Bytes up to the end of the directory. The file may run on past them
+  // with what an interrupted update left, which is ignored.
+  uint64_t file_size() const { return layout_.header().file_size; }
+  // Whether the container was written on a host of the other byte order;
+  // if so its sections were reversed into host order on open.
+  bool foreign() const { return layout_.foreign(); }
+  // Checks every section against its CRC32C, reporting each mismatch on
+  // std::cerr. False for version 1 containers, which cannot be checked.
+  bool verify() const;
+
+  // Segments are numbered from 0; appends add one each.
+  uint32_t segment_count() const { return layout_.segment_count(); }
+  std::vector<SectionEntry> directory() const {
+    return std::vector<SectionEntry>(
+      layout_.directory(), layout_.directory() + layout_.section_count());
+  }
+
+  bool has_section(SectionId id, uint32_t segment = 0) const;
+  // Terminates if the container has no such section.
+  const SectionEntry& section(SectionId id, uint32_t segment = 0) const;
+  const char* section_data(SectionId id, uint32_t segment = 0) const;
+
+  // The sequences and header columns of one segment.
+  SequenceView sequences(uint32_t segment = 0) const;
+  StringColumnView headers(uint32_t segment = 0) const;
+  StringColumnView databases(uint32_t segment = 0) const;
+  StringColumnView accessions(uint32_t segment = 0) const;
+  StringColumnView entry_names(uint32_t segment = 0) const;
+  // Sequences of all segments, deleted ones included.
+  size_t total_sequences() const;
+  // Empty if nothing was ever deleted.
+  TombstoneView tombstones() const;
+  // Seed window sets are numbered in the order they were asked for.
+  size_t seed_set_count() const;
+  // Terminates if a window lies outside the seed sequences.
+  SeedView seeds(size_t set = 0) const;
+  MatrixView matrix() const;
+  // Empty if the container has no manifest.
+  std::vector<std::pair<std::string_view, std::string_view>> manifest() const;
+  // Terminates if the manifest has no such key.
+  std::string_view manifest_value(std::string_view key) const;
+
+  // Header lines of the given sequences, numbered across segments, in the
+  // order asked. Only the pages
+  // holding those offsets and lines are read, so a batch of hits resolves
+  // without loading the header sections.
+  std::vector<std::string_view> resolve_headers(
+    const std::vector<uint64_t>& indices) const;
+
+ private:
+  SequenceView sequence_view(SectionId offsets, SectionId residues,
+                             uint32_t segment) const;
+  StringColumnView column_view(SectionId offsets, SectionId arena,
+                               uint32_t segment) const;
+  uint32_t section_checksum(const SectionEntry& entry) const;
+
+  std::string filename_;
+  MappedFile file_;
+  ContainerLayout layout_;
+};
+
+
+// Writes the header sections alone, the sidecar of a cereal proteome_binary.
+void write_header_container(const std::string& filename,
+  const HeaderStore& headers);
+
+#endif  // CONVERGE_ENCODER_CONTAINER_HPP_
@@ -0,0 +1,197 @@
+#include "container_update.hpp"
+
+#include <cstdio>
+#include <exception>
+#include <iostream>
+#include <string_view>
+#include <unordered_set>
+
+#include "container.hpp"
+#include "fasta_parser.hpp"
+#include "header_store.hpp"
+#include "sequence_store.hpp"
+
+
+namespace {
+
+// Duplicate groups point at headers by number, which appending and
+// compacting would have to renumber.
+void check_updatable(const MappedContainer& container,
+  const std::string& filename) {
+  for (const auto& entry: container.manifest()) {
+    if (entry.first == "dedup" && entry.second != "0") {
+      std::cerr << "File " << filename << " was written with --dedup and "
+                   "cannot be updated" << std::endl;
+      std::terminate();
+    }
+  }
+}
+
+
+ContainerManifest copy_manifest(const MappedContainer& container) {
+  ContainerManifest manifest;
+  for (const auto& entry: container.manifest()) {
+    manifest.emplace_back(entry.first, entry.second);
+  }
+  return manifest;
+}
+
+
+// Replaces key's value, adding it if missing; an empty value removes it.
+void set_manifest_value(ContainerManifest& manifest, const std::string& key,
+  const std::string& value) {
+  for (auto it = manifest.begin(); it != manifest.end(); ++it) {
+    if (it->first == key) {
+      if (value.empty()) {
+        manifest.erase(it);
+      } else {
+        it->second = value;
+      }
+      return;
+    }
+  }
+  if (!value.empty()) {
+    manifest.emplace_back(key, value);
+  }
+}
+
+
+bool is_sequence_section(uint32_t id) {
+  switch (static_cast<SectionId>(id)) {
+    case SectionId::kSequenceOffsets:
+    case SectionId::kResidues:
+    case SectionId::kHeaderOffsets:
+    case SectionId::kHeaders:
+    case SectionId::kDatabaseOffsets:
+    case SectionId::kDatabases:
+    case SectionId::kAccessionOffsets:
+    case SectionId::kAccessions:
+    case SectionId::kEntryNameOffsets:
+    case SectionId::kEntryNames:
+    case SectionId::kTombstones:
+    case SectionId::kManifest:
+      return true;
+    default:
+      return false;
+  }
+}
+
+}  // namespace
+
+
+ContainerUpdate append_to_container(const std::string& filename,
+  const std::string& fasta, const std::vector<std::string>& removed,
+  size_t num_threads) {
+  ContainerUpdate update;
+  MappedContainer existing(filename);
+  check_updatable(existing, filename);
+
+  size_t existing_count = existing.total_sequences();
+  TombstoneView old_tombstones = existing.tombstones();
+  std::vector<uint64_t> tombstones(old_tombstones.words,
+    old_tombstones.words + old_tombstones.word_count);
+  tombstones.resize((existing_count + 63) / 64);
+  if (!removed.empty()) {
+    std::unordered_set<std::string_view> accessions(removed.begin(),
+                                                    removed.end());
+    uint64_t i = 0;
+    for (uint32_t segment = 0; segment < existing.segment_count(); segment++) {
+      StringColumnView column = existing.accessions(segment);
+      for (size_t j = 0; j < column.size(); j++, i++) {
+        if (!old_tombstones[i] && accessions.count(column[j]) > 0) {
+          tombstones[i / 64] |= uint64_t(1) << (i % 64);
+          update.removed++;
+        }
+      }
+    }
+  }
+
+  HeaderStore headers;
+  SequenceStore sequences;
+  if (!fasta.empty()) {
+    load_fasta_sequences(fasta, headers, sequences, num_threads);
+  }
+  update.added = sequences.size();
+  size_t total = existing_count + sequences.size();
+  tombstones.resize((total + 63) / 64);
+  update.live = total - TombstoneView{tombstones.data(),
+                                      tombstones.size()}.count();
+
+  ContainerManifest manifest = copy_manifest(existing);
+  ContainerWriter writer(filename, existing);
+  // Every segment has sequence and header sections, empty if nothing was
+  // added, so that sequence numbers can be counted segment by segment.
+  writer.add_sequences(SectionId::kSequenceOffsets, SectionId::kResidues,
+                       sequences);
+  writer.add_headers(headers);
+  writer.add_section(SectionId::kTombstones, tombstones);
+  if (!manifest.empty()) {
+    set_manifest_value(manifest, "sequences", std::to_string(total));
+    set_manifest_value(manifest, "deleted",
+                       std::to_string(total - update.live));
+    set_manifest_value(manifest, "segments",
+                       std::to_string(existing.segment_count() + 1));
+    // The sequences no longer come from that one input.
+    set_manifest_value(manifest, "proteome_xxh64", "");
+    writer.add_manifest(manifest);
+  }
+  writer.close();
+  return update;
+}
+
+
+ContainerUpdate compact_container(const std::string& filename) {
+  ContainerUpdate update;
+  std::string compacted = filename + ".compact";
+  {
+    MappedContainer existing(filename);
+    check_updatable(existing, filename);
+    TombstoneView tombstones = existing.tombstones();
+    HeaderStore headers;
+    SequenceStore sequences;
+    uint64_t i = 0;
+    for (uint32_t segment = 0; segment < existing.segment_count(); segment++) {
+      SequenceView segment_sequences = existing.sequences(segment);
+      StringColumnView segment_headers = existing.headers(segment);
+      for (size_t j = 0; j < segment_sequences.size(); j++, i++) {
+        if (tombstones[i]) {
+          update.removed++;
+          continue;
+        }
+        sequences.push_back(segment_sequences[j].data,
+                            segment_sequences[j].size);
+        headers.push_back(segment_headers[j]);
+      }
+    }
+    update.live = sequences.size();
+
+    ContainerWriter writer(compacted);
+    writer.add_sequences(SectionId::kSequenceOffsets, SectionId::kResidues,
+                         sequences);
+    writer.add_headers(headers);
+    // Seeds, matrix and whatever else does not describe the sequences are
+    // carried over as they are.
+    for (const SectionEntry& entry: existing.directory()) {
+      if (entry.segment == 0 && !is_sequence_section(entry.id)) {
+        auto id = static_cast<SectionId>(entry.id);
+        writer.add_section(id, existing.section_data(id), entry.size,
+                           entry.element_size);
+      }
+    }
+    ContainerManifest manifest = copy_manifest(existing);
+    if (!manifest.empty()) {
+      set_manifest_value(manifest, "sequences", std::to_string(update.live));
+      set_manifest_value(manifest, "deleted", "");
+      set_manifest_value(manifest, "segments", "");
+      set_manifest_value(manifest, "proteome_xxh64", "");
+      writer.add_manifest(manifest);
+    }
+    writer.close();
+  }
+  if (std::rename(compacted.c_str(), filename.c_str()) != 0) {
+    std::cerr << "File " << compacted << " failed to replace " << filename
+              << std::endl;
+    std::terminate();
+  }
+  return update;
+}
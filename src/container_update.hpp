@@ -0,0 +1,30 @@
+#ifndef CONVERGE_ENCODER_CONTAINER_UPDATE_HPP_
+#define CONVERGE_ENCODER_CONTAINER_UPDATE_HPP_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Incremental updates of a proteome container (see container_format.hpp
+// for segments and tombstones), so that a new release costs time in
+// proportion to what changed rather than to the proteome.
+struct ContainerUpdate {
+  size_t added = 0;
+  size_t removed = 0;
+  // Sequences left after the update, deleted ones not counted.
+  size_t live = 0;
+};
+
+// Tombstones the sequences whose accession is in removed, then appends the
+// sequences of fasta, if not empty, as a new segment. A changed entry is
+// removed and added again. Only the headers' accession column is read;
+// nothing already in the container is rewritten.
+ContainerUpdate append_to_container(const std::string& filename,
+  const std::string& fasta, const std::vector<std::string>& removed,
+  size_t num_threads = 1);
+
+// Rewrites the container without its deleted sequences, as one segment in
+// host byte order.
+ContainerUpdate compact_container(const std::string& filename);
+
+#endif  // CONVERGE_ENCODER_CONTAINER_UPDATE_HPP_
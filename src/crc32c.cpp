@@ -0,0 +1,227 @@
+#include "crc32c.hpp"
+
+#include <array>
+#include <cstring>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define CONVERGE_ENCODER_X86 1
+#include <immintrin.h>
+#elif defined(__GNUC__) && defined(__aarch64__) && defined(__linux__)
+#define CONVERGE_ENCODER_ARM64 1
+#include <arm_acle.h>
+#include <asm/hwcap.h>
+#include <sys/auxv.h>
+#endif
+
+
+namespace {
+
+// Reflected Castagnoli polynomial.
+constexpr uint32_t kPolynomial = 0x82F63B78;
+
+using CrcTable = std::array<std::array<uint32_t, 256>, 8>;
+
+// Slicing-by-8: table[k][b] is the CRC state after byte b followed by k
+// zero bytes.
+constexpr CrcTable make_crc_table() {
+  CrcTable table{};
+  for (uint32_t b = 0; b < 256; b++) {
+    uint32_t crc = b;
+    for (int bit = 0; bit < 8; bit++) {
+      crc = crc & 1 ? (crc >> 1) ^ kPolynomial : crc >> 1;
+    }
+    table[0][b] = crc;
+  }
+  for (size_t k = 1; k < 8; k++) {
+    for (size_t b = 0; b < 256; b++) {
+      uint32_t prev = table[k - 1][b];
+      table[k][b] = (prev >> 8) ^ table[0][prev & 0xFF];
+    }
+  }
+  return table;
+}
+
+constexpr CrcTable kCrcTable = make_crc_table();
+
+
+// The update functions work on the raw register, without the pre- and
+// post-inversion, so that it is linear in both state and data.
+uint32_t update_table(uint32_t state, const uint8_t* p, size_t n) {
+  for (; n >= 8; n -= 8, p += 8) {
+    uint32_t low = state ^ (uint32_t(p[0]) | uint32_t(p[1]) << 8 |
+                            uint32_t(p[2]) << 16 | uint32_t(p[3]) << 24);
+    state = kCrcTable[7][low & 0xFF] ^ kCrcTable[6][(low >> 8) & 0xFF] ^
+            kCrcTable[5][(low >> 16) & 0xFF] ^ kCrcTable[4][low >> 24] ^
+            kCrcTable[3][p[4]] ^ kCrcTable[2][p[5]] ^ kCrcTable[1][p[6]] ^
+            kCrcTable[0][p[7]];
+  }
+  for (; n > 0; n--, p++) {
+    state = (state >> 8) ^ kCrcTable[0][(state ^ *p) & 0xFF];
+  }
+  return state;
+}
+
+
+#if defined(CONVERGE_ENCODER_X86) || defined(CONVERGE_ENCODER_ARM64)
+
+// The hardware kernels run three streams over consecutive blocks to hide
+// the latency of the CRC instruction, then fold the first two states
+// forward over the blocks after them and combine.
+constexpr size_t kBlock = 1024;
+
+// a * b modulo the polynomial, both reflected.
+constexpr uint32_t multiply_mod(uint32_t a, uint32_t b) {
+  uint32_t product = 0;
+  for (uint32_t m = 1u << 31; m != 0; m >>= 1) {
+    if (a & m) {
+      product ^= b;
+    }
+    b = b & 1 ? (b >> 1) ^ kPolynomial : b >> 1;
+  }
+  return product;
+}
+
+// x^(8 * bytes) modulo the polynomial: the operator that advances a state
+// over that many zero bytes.
+constexpr uint32_t zeros_operator(size_t bytes) {
+  uint32_t result = 1u << 31;  // x^0
+  uint32_t power = 1u << 30;   // x^1
+  for (size_t bits = bytes * 8; bits != 0; bits >>= 1) {
+    if (bits & 1) {
+      result = multiply_mod(power, result);
+    }
+    power = multiply_mod(power, power);
+  }
+  return result;
+}
+
+using ShiftTable = std::array<std::array<uint32_t, 256>, 4>;
+
+constexpr ShiftTable make_shift_table() {
+  ShiftTable table{};
+  uint32_t op = zeros_operator(kBlock);
+  for (uint32_t k = 0; k < 4; k++) {
+    for (uint32_t b = 0; b < 256; b++) {
+      table[k][b] = multiply_mod(op, b << (8 * k));
+    }
+  }
+  return table;
+}
+
+// Advances a state over kBlock zero bytes, one lookup per state byte.
+const ShiftTable kShiftTable = make_shift_table();
+
+inline uint32_t shift_block(uint32_t state) {
+  return kShiftTable[0][state & 0xFF] ^ kShiftTable[1][(state >> 8) & 0xFF] ^
+         kShiftTable[2][(state >> 16) & 0xFF] ^ kShiftTable[3][state >> 24];
+}
+
+inline uint64_t load64(const uint8_t* p) {
+  uint64_t word;
+  memcpy(&word, p, sizeof(word));
+  return word;
+}
+
+#endif
+
+
+#ifdef CONVERGE_ENCODER_X86
+
+__attribute__((target("sse4.2")))
+uint32_t update_sse42(uint32_t state, const uint8_t* p, size_t n) {
+  for (; n >= 3 * kBlock; n -= 3 * kBlock, p += 3 * kBlock) {
+    uint64_t a = state;
+    uint64_t b = 0;
+    uint64_t c = 0;
+    for (size_t i = 0; i < kBlock; i += 8) {
+      a = _mm_crc32_u64(a, load64(p + i));
+      b = _mm_crc32_u64(b, load64(p + kBlock + i));
+      c = _mm_crc32_u64(c, load64(p + 2 * kBlock + i));
+    }
+    state = shift_block(shift_block(static_cast<uint32_t>(a)) ^
+                        static_cast<uint32_t>(b)) ^ static_cast<uint32_t>(c);
+  }
+  uint64_t wide = state;
+  for (; n >= 8; n -= 8, p += 8) {
+    wide = _mm_crc32_u64(wide, load64(p));
+  }
+  state = static_cast<uint32_t>(wide);
+  for (; n > 0; n--, p++) {
+    state = _mm_crc32_u8(state, *p);
+  }
+  return state;
+}
+
+#endif  // CONVERGE_ENCODER_X86
+
+
+#ifdef CONVERGE_ENCODER_ARM64
+
+__attribute__((target("+crc")))
+uint32_t update_arm64(uint32_t state, const uint8_t* p, size_t n) {
+  for (; n >= 3 * kBlock; n -= 3 * kBlock, p += 3 * kBlock) {
+    uint32_t a = state;
+    uint32_t b = 0;
+    uint32_t c = 0;
+    for (size_t i = 0; i < kBlock; i += 8) {
+      a = __crc32cd(a, load64(p + i));
+      b = __crc32cd(b, load64(p + kBlock + i));
+      c = __crc32cd(c, load64(p + 2 * kBlock + i));
+    }
+    state = shift_block(shift_block(a) ^ b) ^ c;
+  }
+  for (; n >= 8; n -= 8, p += 8) {
+    state = __crc32cd(state, load64(p));
+  }
+  for (; n > 0; n--, p++) {
+    state = __crc32cb(state, *p);
+  }
+  return state;
+}
+
+#endif  // CONVERGE_ENCODER_ARM64
+
+
+using UpdateFn = uint32_t (*)(uint32_t, const uint8_t*, size_t);
+
+struct Implementation {
+  UpdateFn update;
+  const char* name;
+};
+
+Implementation best_implementation() {
+#ifdef CONVERGE_ENCODER_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("sse4.2")) {
+    return {update_sse42, "sse4.2"};
+  }
+#endif
+#ifdef CONVERGE_ENCODER_ARM64
+  if (getauxval(AT_HWCAP) & HWCAP_CRC32) {
+    return {update_arm64, "armv8-crc"};
+  }
+#endif
+  return {update_table, "table"};
+}
+
+const Implementation& implementation() {
+  static const Implementation best = best_implementation();
+  return best;
+}
+
+}  // namespace
+
+
+uint32_t crc32c(const void* data, size_t n, uint32_t crc) {
+  return ~implementation().update(~crc, static_cast<const uint8_t*>(data), n);
+}
+
+
+uint32_t crc32c_table(const void* data, size_t n, uint32_t crc) {
+  return ~update_table(~crc, static_cast<const uint8_t*>(data), n);
+}
+
+
+const char* crc32c_implementation() {
+  return implementation().name;
+}
@@ -0,0 +1,20 @@
+#ifndef CONVERGE_ENCODER_CRC32C_HPP_
+#define CONVERGE_ENCODER_CRC32C_HPP_
+
+#include <cstddef>
+#include <cstdint>
+
+// CRC32C (Castagnoli) of data[0, n), continuing from crc, the CRC of the
+// bytes before; 0 to start. crc32c(b, crc32c(a)) is the CRC of a then b.
+// Uses the SSE4.2 or ARMv8 CRC instructions when the CPU has them, else
+// slicing-by-8 tables.
+uint32_t crc32c(const void* data, size_t n, uint32_t crc = 0);
+
+// Same as above on the slicing-by-8 tables whatever the CPU, to check the
+// hardware kernels against.
+uint32_t crc32c_table(const void* data, size_t n, uint32_t crc = 0);
+
+// Name of the implementation crc32c() uses on this CPU.
+const char* crc32c_implementation();
+
+#endif  // CONVERGE_ENCODER_CRC32C_HPP_
@@ -0,0 +1,75 @@
+#include "dedup.hpp"
+
+#include <algorithm>
+#include <exception>
+#include <iostream>
+#include <limits>
+#include <unordered_map>
+
+#include "hash.hpp"
+
+
+DuplicateGroups collapse_duplicates(SequenceStore& sequences) {
+  if (sequences.size() > std::numeric_limits<uint32_t>::max()) {
+    std::cerr << "collapse_duplicates(): more than 2^32 records."
+              << std::endl;
+    std::terminate();
+  }
+  // The hash table maps to the record that first had each sequence.
+  std::unordered_multimap<uint64_t, uint32_t> first_by_hash;
+  first_by_hash.reserve(sequences.size());
+  std::vector<uint32_t> unique_of(sequences.size());
+  std::vector<bool> keep(sequences.size());
+  uint32_t num_unique = 0;
+  for (size_t record = 0; record < sequences.size(); record++) {
+    ResidueSpan seq = sequences[record];
+    uint64_t hash = xxhash64(seq.data, seq.size * sizeof(Residue));
+    auto candidates = first_by_hash.equal_range(hash);
+    bool found = false;
+    for (auto it = candidates.first; it != candidates.second; ++it) {
+      ResidueSpan first = sequences[it->second];
+      if (first.size == seq.size &&
+          std::equal(first.begin(), first.end(), seq.begin())) {
+        unique_of[record] = unique_of[it->second];
+        found = true;
+        break;
+      }
+    }
+    if (!found) {
+      first_by_hash.emplace(hash, static_cast<uint32_t>(record));
+      unique_of[record] = num_unique++;
+      keep[record] = true;
+    }
+  }
+  sequences.compact(keep);
+
+  // Counting sort of record indices by their unique sequence.
+  DuplicateGroups groups;
+  groups.member_offsets.assign(num_unique + 1, 0);
+  for (uint32_t unique: unique_of) {
+    groups.member_offsets[unique + 1]++;
+  }
+  for (size_t i = 0; i < num_unique; i++) {
+    groups.member_offsets[i + 1] += groups.member_offsets[i];
+  }
+  groups.members.resize(unique_of.size());
+  std::vector<uint64_t> next(groups.member_offsets.begin(),
+                             groups.member_offsets.end() - 1);
+  for (size_t record = 0; record < unique_of.size(); record++) {
+    groups.members[next[unique_of[record]]++] = static_cast<uint32_t>(record);
+  }
+  return groups;
+}
+
+
+DuplicateGroups DuplicateGroups::slice(size_t first, size_t count) const {
+  DuplicateGroups sliced;
+  uint64_t begin = member_offsets[first];
+  uint64_t end = member_offsets[first + count];
+  sliced.members.assign(members.begin() + begin, members.begin() + end);
+  sliced.member_offsets.reserve(count + 1);
+  for (size_t i = 1; i <= count; i++) {
+    sliced.member_offsets.push_back(member_offsets[first + i] - begin);
+  }
+  return sliced;
+}
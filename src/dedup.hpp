@@ -0,0 +1,37 @@
+#ifndef CONVERGE_ENCODER_DEDUP_HPP_
+#define CONVERGE_ENCODER_DEDUP_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "sequence_store.hpp"
+
+// Which records share each unique sequence after collapse_duplicates().
+// Unique sequence i was found in the records (header indices)
+// members[member_offsets[i], member_offsets[i + 1]), in input order.
+struct DuplicateGroups {
+  std::vector<uint64_t> member_offsets{0};
+  std::vector<uint32_t> members;
+
+  size_t size() const { return member_offsets.size() - 1; }
+  size_t multiplicity(size_t i) const {
+    return member_offsets[i + 1] - member_offsets[i];
+  }
+  // Groups of unique sequences [first, first + count); members keep their
+  // global header indices.
+  DuplicateGroups slice(size_t first, size_t count) const;
+
+  template <class Archive>
+  void serialize(Archive& archive) {
+    archive(member_offsets, members);
+  }
+};
+
+
+// Drops every sequence that is identical to an earlier one, keeping unique
+// sequences in order of first occurrence. Sequences are bucketed by XXH64
+// and compared in full on a hash match.
+DuplicateGroups collapse_duplicates(SequenceStore& sequences);
+
+#endif  // CONVERGE_ENCODER_DEDUP_HPP_
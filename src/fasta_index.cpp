@@ -0,0 +1,253 @@
+#include "fasta_index.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+
+namespace {
+
+// Drops "\n" and "\r\n" line breaks from raw FASTA text, in place.
+void strip_line_breaks(std::string& text) {
+  size_t out = 0;
+  for (size_t i = 0; i < text.size(); i++) {
+    bool line_break = text[i] == '\n' ||
+      (text[i] == '\r' && i + 1 < text.size() && text[i + 1] == '\n');
+    if (!line_break) {
+      text[out++] = text[i];
+    }
+  }
+  text.resize(out);
+}
+
+}  // namespace
+
+
+void FastaIndexBuilder::start_record(std::string_view header) {
+  if (!header.empty() && header[0] == '>') {
+    header.remove_prefix(1);
+  }
+  current_ = FaiEntry();
+  current_.name = std::string(header.substr(0, header.find_first_of(" \t\r")));
+  has_body_ = false;
+  line_bytes_ = 0;
+  line_ends_cr_ = false;
+  short_line_seen_ = false;
+  blank_line_seen_ = false;
+  irregular_ = false;
+}
+
+
+void FastaIndexBuilder::body(const char* text, size_t n, uint64_t offset) {
+  if (n == 0) {
+    return;
+  }
+  if (!has_body_) {
+    current_.offset = offset;
+    has_body_ = true;
+  }
+  const char* end = text + n;
+  while (text < end) {
+    auto newline = static_cast<const char*>(memchr(text, '\n', end - text));
+    const char* line_end = newline == nullptr ? end : newline;
+    if (line_end != text) {
+      line_bytes_ += static_cast<uint64_t>(line_end - text);
+      line_ends_cr_ = line_end[-1] == '\r';
+    }
+    if (newline == nullptr) {
+      break;
+    }
+    line_bytes_++;
+    end_line(true);
+    text = newline + 1;
+  }
+}
+
+
+void FastaIndexBuilder::end_line(bool has_newline) {
+  uint64_t bases = line_bytes_ - (has_newline ? 1 : 0) -
+                   (line_ends_cr_ ? 1 : 0);
+  uint64_t width = line_bytes_;
+  line_bytes_ = 0;
+  line_ends_cr_ = false;
+  // Blank lines are only tolerated at the end of a record.
+  if (bases == 0) {
+    blank_line_seen_ = true;
+    return;
+  }
+  if (blank_line_seen_ || short_line_seen_) {
+    irregular_ = true;
+  }
+  current_.length += bases;
+  if (current_.line_bases == 0 && current_.line_width == 0) {
+    current_.line_bases = bases;
+    current_.line_width = has_newline ? width : width + 1;
+  } else if (bases > current_.line_bases) {
+    irregular_ = true;
+  } else if (bases < current_.line_bases) {
+    short_line_seen_ = true;
+  }
+}
+
+
+void FastaIndexBuilder::end_record(bool keep) {
+  if (line_bytes_ > 0) {
+    end_line(false);
+  }
+  if (keep) {
+    if (irregular_) {
+      current_.line_bases = 0;
+      current_.line_width = 0;
+    }
+    entries_.push_back(std::move(current_));
+  }
+  start_record(std::string_view());
+}
+
+
+void write_fasta_index(const std::string& filename,
+  const std::vector<FaiEntry>& entries) {
+  std::ofstream file(filename);
+  if (!file.is_open()) {
+    std::cout << "File " << filename << " failed to open" << std::endl;
+    std::terminate();
+  }
+  write_fasta_index(file, entries);
+}
+
+
+void write_fasta_index(std::ostream& file,
+  const std::vector<FaiEntry>& entries) {
+  for (const FaiEntry& entry: entries) {
+    file << entry.name << '\t' << entry.length << '\t' << entry.offset << '\t'
+         << entry.line_bases << '\t' << entry.line_width << '\n';
+  }
+}
+
+
+std::vector<FaiEntry> read_fasta_index(const std::string& filename) {
+  std::ifstream file(filename);
+  if (!file.is_open()) {
+    std::cout << "File " << filename << " failed to open" << std::endl;
+    std::terminate();
+  }
+  std::vector<FaiEntry> entries;
+  std::string line;
+  while (std::getline(file, line)) {
+    if (line.empty()) {
+      continue;
+    }
+    std::istringstream fields(line);
+    FaiEntry entry;
+    std::getline(fields, entry.name, '\t');
+    fields >> entry.length >> entry.offset >> entry.line_bases
+           >> entry.line_width;
+    if (fields.fail()) {
+      std::cerr << "File " << filename << " has a malformed line: " << line
+                << std::endl;
+      std::terminate();
+    }
+    entries.push_back(std::move(entry));
+  }
+  return entries;
+}
+
+
+FastaIndex::FastaIndex(const std::string& fasta_filename,
+  const std::string& index_filename)
+  : fasta_filename_(fasta_filename),
+    entries_(read_fasta_index(index_filename)) {
+  fd_ = open(fasta_filename.c_str(), O_RDONLY);
+  if (fd_ < 0) {
+    std::cout << "File " << fasta_filename << " failed to open" << std::endl;
+    std::terminate();
+  }
+}
+
+
+FastaIndex::~FastaIndex() {
+  close(fd_);
+}
+
+
+size_t FastaIndex::find(std::string_view name) const {
+  for (size_t i = 0; i < entries_.size(); i++) {
+    if (entries_[i].name == name) {
+      return i;
+    }
+  }
+  return npos;
+}
+
+
+std::string FastaIndex::fetch(size_t i) const {
+  return fetch(i, 0, entries_[i].length);
+}
+
+
+std::string FastaIndex::fetch(size_t i, uint64_t start,
+  uint64_t length) const {
+  const FaiEntry& entry = entries_[i];
+  uint64_t end = std::min(entry.length, start + std::min(length,
+                                                         entry.length));
+  if (start >= end) {
+    return std::string();
+  }
+  std::string text;
+  if (entry.line_bases > 0) {
+    auto byte_offset = [&entry](uint64_t base) {
+      return entry.offset + base / entry.line_bases * entry.line_width +
+             base % entry.line_bases;
+    };
+    uint64_t first = byte_offset(start);
+    text.resize(byte_offset(end - 1) + 1 - first);
+    read_at(first, &text[0], text.size());
+    strip_line_breaks(text);
+    return text;
+  }
+  // Irregular line layout: read forward from the record start until enough
+  // bases have been seen.
+  std::string raw;
+  uint64_t offset = entry.offset;
+  size_t chunk = std::max<size_t>(end + end / 8, 4096);
+  while (text.size() < end) {
+    size_t old_size = raw.size();
+    raw.resize(old_size + chunk);
+    ssize_t got = pread(fd_, &raw[old_size], chunk,
+                        static_cast<off_t>(offset));
+    raw.resize(old_size + static_cast<size_t>(std::max<ssize_t>(got, 0)));
+    if (got <= 0) {
+      break;
+    }
+    offset += static_cast<uint64_t>(got);
+    text = raw;
+    strip_line_breaks(text);
+  }
+  if (text.size() < end) {
+    std::cerr << "File " << fasta_filename_ << " is shorter than its index"
+              << std::endl;
+    std::terminate();
+  }
+  return text.substr(start, end - start);
+}
+
+
+void FastaIndex::read_at(uint64_t offset, char* buffer, size_t n) const {
+  while (n > 0) {
+    ssize_t got = pread(fd_, buffer, n, static_cast<off_t>(offset));
+    if (got <= 0) {
+      std::cerr << "File " << fasta_filename_ << " is shorter than its index"
+                << std::endl;
+      std::terminate();
+    }
+    buffer += got;
+    n -= static_cast<size_t>(got);
+    offset += static_cast<uint64_t>(got);
+  }
+}
@@ -0,0 +1,95 @@
+#ifndef CONVERGE_ENCODER_FASTA_INDEX_HPP_
+#define CONVERGE_ENCODER_FASTA_INDEX_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// One line of a samtools-style .fai index. Entries follow the input
+// records in order (records that encode to nothing are not indexed), so
+// entry i is header i. Without --dedup that is also sequence i of the
+// encoded proteome; with it, DuplicateGroups maps each unique sequence to
+// the records, and so the entries, it was found in.
+// length counts raw sequence bytes, including letters outside the
+// alphabet, and all offsets are into the uncompressed FASTA text. Records
+// whose lines are not all line_bases long (bar the last) get
+// line_bases == line_width == 0.
+struct FaiEntry {
+  std::string name;
+  uint64_t length = 0;
+  uint64_t offset = 0;
+  uint64_t line_bases = 0;
+  uint64_t line_width = 0;
+};
+
+
+// Collects FaiEntry rows while FastaStreamParser walks the input.
+class FastaIndexBuilder {
+ public:
+  explicit FastaIndexBuilder(std::vector<FaiEntry>& entries)
+    : entries_(entries) {}
+
+  void start_record(std::string_view header);
+  // A piece of the record body starting at byte offset of the input.
+  void body(const char* text, size_t n, uint64_t offset);
+  void end_record(bool keep);
+
+ private:
+  void end_line(bool has_newline);
+
+  std::vector<FaiEntry>& entries_;
+  FaiEntry current_;
+  bool has_body_ = false;
+  uint64_t line_bytes_ = 0;
+  bool line_ends_cr_ = false;
+  bool short_line_seen_ = false;
+  bool blank_line_seen_ = false;
+  bool irregular_ = false;
+};
+
+
+void write_fasta_index(const std::string& filename,
+  const std::vector<FaiEntry>& entries);
+
+// Appends the rows to an open index file.
+void write_fasta_index(std::ostream& file,
+  const std::vector<FaiEntry>& entries);
+
+std::vector<FaiEntry> read_fasta_index(const std::string& filename);
+
+
+// Random access to single records of an uncompressed FASTA file through its
+// index. Fetching a record or a sub-range costs one positioned read.
+class FastaIndex {
+ public:
+  FastaIndex(const std::string& fasta_filename,
+             const std::string& index_filename);
+  ~FastaIndex();
+
+  FastaIndex(const FastaIndex&) = delete;
+  FastaIndex& operator=(const FastaIndex&) = delete;
+
+  size_t size() const { return entries_.size(); }
+  const FaiEntry& operator[](size_t i) const { return entries_[i]; }
+  // Index of the first entry with this name, or npos.
+  size_t find(std::string_view name) const;
+
+  // Raw sequence of entry i, without line breaks.
+  std::string fetch(size_t i) const;
+  // Bases [start, start + length) of entry i, clipped to the sequence.
+  std::string fetch(size_t i, uint64_t start, uint64_t length) const;
+
+  static constexpr size_t npos = static_cast<size_t>(-1);
+
+ private:
+  void read_at(uint64_t offset, char* buffer, size_t n) const;
+
+  std::string fasta_filename_;
+  std::vector<FaiEntry> entries_;
+  int fd_ = -1;
+};
+
+#endif  // CONVERGE_ENCODER_FASTA_INDEX_HPP_
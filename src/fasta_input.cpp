@@ -0,0 +1,355 @@
+#include "fasta_input.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <exception>
+#include <future>
+#include <iostream>
+
+
+namespace {
+
+constexpr unsigned char kGzipId1 = 31;
+constexpr unsigned char kGzipId2 = 139;
+constexpr unsigned char kGzipExtraFlag = 4;
+// Fixed gzip header up to and including XLEN.
+constexpr size_t kGzipExtraStart = 12;
+constexpr size_t kBgzfMaxBlockSize = 65536;
+// Blocks inflated per FastaReader batch, per thread.
+constexpr size_t kBgzfBatchBlocksPerThread = 16;
+
+struct BgzfBlock {
+  size_t offset;
+  size_t size;
+  uint32_t inflated_size;
+  size_t inflated_offset;
+};
+
+
+uint32_t read_le32(const unsigned char* p) {
+  return uint32_t(p[0]) | uint32_t(p[1]) << 8 | uint32_t(p[2]) << 16 |
+         uint32_t(p[3]) << 24;
+}
+
+
+[[noreturn]] void fail(const std::string& filename, const char* what) {
+  std::cerr << "File " << filename << " " << what << std::endl;
+  std::terminate();
+}
+
+
+// Size of the gzip header's BGZF "BC" subfield value (BSIZE + 1), 0 if the
+// member has none. n must cover the whole extra field.
+size_t bgzf_subfield_size(const unsigned char* p, size_t n) {
+  if (n < kGzipExtraStart || p[0] != kGzipId1 || p[1] != kGzipId2 ||
+      !(p[3] & kGzipExtraFlag)) {
+    return 0;
+  }
+  size_t extra_size = p[10] | size_t(p[11]) << 8;
+  if (n < kGzipExtraStart + extra_size) {
+    return 0;
+  }
+  const unsigned char* field = p + kGzipExtraStart;
+  const unsigned char* extra_end = field + extra_size;
+  while (field + 4 <= extra_end) {
+    size_t field_size = field[2] | size_t(field[3]) << 8;
+    if (field[0] == 'B' && field[1] == 'C' && field_size == 2 &&
+        field + 6 <= extra_end) {
+      return (field[4] | size_t(field[5]) << 8) + 1;
+    }
+    field += 4 + field_size;
+  }
+  return 0;
+}
+
+
+// Size of the BGZF block at p, or 0 if fewer than n bytes are needed to
+// tell. Terminates if p does not start a BGZF block.
+size_t bgzf_block_size(const unsigned char* p, size_t n,
+  const std::string& filename) {
+  if (n < kGzipExtraStart ||
+      n < kGzipExtraStart + (p[10] | size_t(p[11]) << 8)) {
+    return 0;
+  }
+  size_t size = bgzf_subfield_size(p, n);
+  if (size == 0) {
+    fail(filename, "has a corrupt BGZF block header");
+  }
+  return size;
+}
+
+
+// Finds the complete blocks in [data, data + n) and lays out their inflated
+// sizes back to back. Returns the bytes consumed by those blocks.
+size_t index_bgzf_blocks(const unsigned char* data, size_t n,
+  const std::string& filename, std::vector<BgzfBlock>& blocks,
+  size_t& inflated_total) {
+  size_t offset = 0;
+  inflated_total = 0;
+  while (offset < n) {
+    size_t size = bgzf_block_size(data + offset, n - offset, filename);
+    if (size == 0 || size > n - offset) {
+      break;
+    }
+    if (size < kGzipExtraStart + 8) {
+      fail(filename, "has a corrupt BGZF block header");
+    }
+    uint32_t inflated_size = read_le32(data + offset + size - 4);
+    blocks.push_back({offset, size, inflated_size, inflated_total});
+    inflated_total += inflated_size;
+    offset += size;
+  }
+  return offset;
+}
+
+
+bool inflate_bgzf_block(const unsigned char* block, const BgzfBlock& info,
+  char* out) {
+  size_t extra_size = block[10] | size_t(block[11]) << 8;
+  size_t header_size = kGzipExtraStart + extra_size;
+  if (info.size < header_size + 8) {
+    return false;
+  }
+  z_stream stream{};
+  if (inflateInit2(&stream, -MAX_WBITS) != Z_OK) {
+    return false;
+  }
+  stream.next_in = const_cast<unsigned char*>(block + header_size);
+  stream.avail_in = static_cast<uInt>(info.size - header_size - 8);
+  stream.next_out = reinterpret_cast<unsigned char*>(out);
+  stream.avail_out = info.inflated_size;
+  int status = inflate(&stream, Z_FINISH);
+  bool ok = status == Z_STREAM_END && stream.avail_out == 0;
+  inflateEnd(&stream);
+  uLong crc = crc32(0L, reinterpret_cast<const Bytef*>(out),
+                    info.inflated_size);
+  return ok && crc == read_le32(block + info.size - 8);
+}
+
+
+// Inflates every block of base into out, spread over the pool's threads.
+void inflate_bgzf_blocks(ThreadPool& pool, const unsigned char* base,
+  const std::vector<BgzfBlock>& blocks, char* out,
+  const std::string& filename) {
+  size_t group = std::max<size_t>(1, blocks.size() / (pool.size() * 4));
+  std::vector<std::future<bool>> results;
+  for (size_t first = 0; first < blocks.size(); first += group) {
+    size_t last = std::min(blocks.size(), first + group);
+    results.push_back(pool.submit([&, first, last]() {
+      for (size_t i = first; i < last; i++) {
+        const BgzfBlock& block = blocks[i];
+        if (!inflate_bgzf_block(base + block.offset, block,
+                                out + block.inflated_offset)) {
+          return false;
+        }
+      }
+      return true;
+    }));
+  }
+  bool ok = true;
+  for (std::future<bool>& result: results) {
+    ok = result.get() && ok;
+  }
+  if (!ok) {
+    fail(filename, "has a corrupt BGZF block");
+  }
+}
+
+
+// Inflates a whole gzip file, including concatenated members.
+void inflate_gzip(const unsigned char* data, size_t n,
+  const std::string& filename, std::vector<char>& out) {
+  z_stream stream{};
+  if (inflateInit2(&stream, MAX_WBITS + 16) != Z_OK) {
+    fail(filename, "failed to initialize zlib");
+  }
+  out.resize(std::max<size_t>(n * 4, 1 << 20));
+  size_t consumed = 0;
+  size_t produced = 0;
+  while (true) {
+    if (stream.avail_in == 0) {
+      size_t chunk = std::min<size_t>(n - consumed, UINT_MAX);
+      stream.next_in = const_cast<unsigned char*>(data + consumed);
+      stream.avail_in = static_cast<uInt>(chunk);
+      consumed += chunk;
+    }
+    if (produced == out.size()) {
+      out.resize(out.size() * 2);
+    }
+    size_t room = std::min<size_t>(out.size() - produced, UINT_MAX);
+    stream.next_out = reinterpret_cast<unsigned char*>(out.data() + produced);
+    stream.avail_out = static_cast<uInt>(room);
+    int status = inflate(&stream, Z_NO_FLUSH);
+    produced += room - stream.avail_out;
+    if (status == Z_STREAM_END) {
+      if (stream.avail_in == 0 && consumed == n) {
+        break;
+      }
+      inflateReset(&stream);
+    } else if (status != Z_OK) {
+      inflateEnd(&stream);
+      fail(filename, "is not valid gzip");
+    }
+  }
+  inflateEnd(&stream);
+  out.resize(produced);
+  out.shrink_to_fit();
+}
+
+}  // namespace
+
+
+InputCompression detect_compression(const unsigned char* head, size_t n) {
+  if (n < 2 || head[0] != kGzipId1 || head[1] != kGzipId2) {
+    return InputCompression::kNone;
+  }
+  if (bgzf_subfield_size(head, n) != 0) {
+    return InputCompression::kBgzf;
+  }
+  return InputCompression::kGzip;
+}
+
+
+FastaInput::FastaInput(const std::string& filename, size_t num_threads)
+  : mapped_(std::make_unique<MappedFile>(filename)) {
+  auto data = reinterpret_cast<const unsigned char*>(mapped_->data());
+  size_t n = mapped_->size();
+  switch (detect_compression(data, n)) {
+    case InputCompression::kNone:
+      size_ = n;
+      return;
+    case InputCompression::kGzip:
+      inflate_gzip(data, n, filename, inflated_);
+      break;
+    case InputCompression::kBgzf: {
+      std::vector<BgzfBlock> blocks;
+      size_t inflated_total;
+      if (index_bgzf_blocks(data, n, filename, blocks, inflated_total) != n) {
+        fail(filename, "has a truncated BGZF block");
+      }
+      inflated_.resize(inflated_total);
+      ThreadPool pool(num_threads);
+      inflate_bgzf_blocks(pool, data, blocks, inflated_.data(), filename);
+      break;
+    }
+  }
+  size_ = inflated_.size();
+  mapped_.reset();
+}
+
+
+const char* FastaInput::data() const {
+  return mapped_ ? mapped_->data() : inflated_.data();
+}
+
+
+FastaReader::FastaReader(const std::string& filename, size_t num_threads)
+  : filename_(filename) {
+  fd_ = open(filename.c_str(), O_RDONLY);
+  if (fd_ < 0) {
+    std::cout << "File " << filename << " failed to open" << std::endl;
+    std::terminate();
+  }
+  unsigned char head[64];
+  ssize_t got = pread(fd_, head, sizeof(head), 0);
+  compression_ = detect_compression(head, got > 0 ? size_t(got) : 0);
+  switch (compression_) {
+    case InputCompression::kNone:
+      posix_fadvise(fd_, 0, 0, POSIX_FADV_SEQUENTIAL);
+      break;
+    case InputCompression::kGzip:
+      gz_ = gzdopen(fd_, "rb");
+      fd_ = -1;
+      if (gz_ == nullptr) {
+        fail(filename, "failed to open as gzip");
+      }
+      gzbuffer(gz_, 1 << 18);
+      break;
+    case InputCompression::kBgzf:
+      pool_ = std::make_unique<ThreadPool>(num_threads);
+      compressed_.resize(kBgzfMaxBlockSize * kBgzfBatchBlocksPerThread *
+                         pool_->size());
+      break;
+  }
+}
+
+
+FastaReader::~FastaReader() {
+  if (gz_ != nullptr) {
+    gzclose(gz_);
+  }
+  if (fd_ >= 0) {
+    close(fd_);
+  }
+}
+
+
+size_t FastaReader::read(char* buffer, size_t capacity) {
+  switch (compression_) {
+    case InputCompression::kNone: {
+      ssize_t got = ::read(fd_, buffer, capacity);
+      if (got < 0) {
+        fail(filename_, "failed to read");
+      }
+      return static_cast<size_t>(got);
+    }
+    case InputCompression::kGzip: {
+      int got = gzread(gz_, buffer,
+                       static_cast<unsigned>(std::min<size_t>(capacity,
+                                                              1u << 30)));
+      if (got < 0) {
+        fail(filename_, "is not valid gzip");
+      }
+      return static_cast<size_t>(got);
+    }
+    case InputCompression::kBgzf:
+      break;
+  }
+  if (inflated_pos_ == inflated_.size() && !inflate_next_batch()) {
+    return 0;
+  }
+  size_t count = std::min(capacity, inflated_.size() - inflated_pos_);
+  memcpy(buffer, inflated_.data() + inflated_pos_, count);
+  inflated_pos_ += count;
+  return count;
+}
+
+
+bool FastaReader::inflate_next_batch() {
+  while (true) {
+    while (!end_of_file_ && compressed_size_ < compressed_.size()) {
+      ssize_t got = ::read(fd_, compressed_.data() + compressed_size_,
+                           compressed_.size() - compressed_size_);
+      if (got < 0) {
+        fail(filename_, "failed to read");
+      }
+      end_of_file_ = got == 0;
+      compressed_size_ += static_cast<size_t>(got);
+    }
+    std::vector<BgzfBlock> blocks;
+    size_t inflated_total;
+    size_t consumed = index_bgzf_blocks(compressed_.data(), compressed_size_,
+                                        filename_, blocks, inflated_total);
+    if (blocks.empty()) {
+      if (compressed_size_ > 0) {
+        fail(filename_, "has a truncated BGZF block");
+      }
+      return false;
+    }
+    inflated_.resize(inflated_total);
+    inflated_pos_ = 0;
+    inflate_bgzf_blocks(*pool_, compressed_.data(), blocks, inflated_.data(),
+                        filename_);
+    memmove(compressed_.data(), compressed_.data() + consumed,
+            compressed_size_ - consumed);
+    compressed_size_ -= consumed;
+    // Batches holding only empty blocks (the BGZF EOF marker) yield nothing.
+    if (inflated_total > 0) {
+      return true;
+    }
+  }
+}
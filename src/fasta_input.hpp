@@ -0,0 +1,72 @@
+#ifndef CONVERGE_ENCODER_FASTA_INPUT_HPP_
+#define CONVERGE_ENCODER_FASTA_INPUT_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <zlib.h>
+
+#include "mapped_file.hpp"
+#include "thread_pool.hpp"
+
+enum class InputCompression { kNone, kGzip, kBgzf };
+
+// Sniffs the first bytes of a file. BGZF is gzip whose members carry a "BC"
+// extra subfield with the compressed block size, which lets blocks be
+// located and inflated independently.
+InputCompression detect_compression(const unsigned char* head, size_t n);
+
+
+// Whole content of a FASTA file, decompressed if needed. Plain files are
+// memory-mapped; gzip is inflated into memory, and BGZF blocks are inflated
+// concurrently on num_threads threads straight into their final position.
+class FastaInput {
+ public:
+  explicit FastaInput(const std::string& filename, size_t num_threads = 1);
+
+  FastaInput(const FastaInput&) = delete;
+  FastaInput& operator=(const FastaInput&) = delete;
+
+  const char* data() const;
+  size_t size() const { return size_; }
+
+ private:
+  std::unique_ptr<MappedFile> mapped_;
+  std::vector<char> inflated_;
+  size_t size_ = 0;
+};
+
+
+// Sequential reader over a FASTA file that may be gzip or BGZF compressed,
+// for the streaming encoder. BGZF input is inflated a batch of blocks at a
+// time on a thread pool, so memory stays bounded by the batch size.
+class FastaReader {
+ public:
+  FastaReader(const std::string& filename, size_t num_threads = 1);
+  ~FastaReader();
+
+  FastaReader(const FastaReader&) = delete;
+  FastaReader& operator=(const FastaReader&) = delete;
+
+  // Fills up to capacity bytes, returns 0 at the end of the input.
+  size_t read(char* buffer, size_t capacity);
+
+ private:
+  bool inflate_next_batch();
+
+  std::string filename_;
+  InputCompression compression_;
+  int fd_ = -1;
+  gzFile gz_ = nullptr;
+  std::unique_ptr<ThreadPool> pool_;
+  std::vector<unsigned char> compressed_;
+  size_t compressed_size_ = 0;
+  bool end_of_file_ = false;
+  std::vector<char> inflated_;
+  size_t inflated_pos_ = 0;
+};
+
+#endif  // CONVERGE_ENCODER_FASTA_INPUT_HPP_
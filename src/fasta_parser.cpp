@@ -0,0 +1,223 @@
+#include "fasta_parser.hpp"
+
+#include <assert.h>
+#include <cstring>
+#include <future>
+#include <memory>
+
+#include "fasta_input.hpp"
+#include "residue_encoder.hpp"
+#include "thread_pool.hpp"
+
+
+namespace {
+
+// Returns the '>' that opens the next record in [pos, end), or end if there
+// is none. pos itself is never at the start of a line.
+const char* find_record_start(const char* pos, const char* end) {
+  const char* search = pos;
+  while (search < end) {
+    auto marker = static_cast<const char*>(memchr(search, '>', end - search));
+    if (marker == nullptr) {
+      return end;
+    }
+    if (marker != pos && marker[-1] == '\n') {
+      return marker;
+    }
+    search = marker + 1;
+  }
+  return end;
+}
+
+
+// Collects records into the in-memory stores used by parse_fasta().
+class VectorSink : public FastaSink {
+ public:
+  VectorSink(HeaderStore& headers, SequenceStore& sequences)
+    : headers_(headers), sequences_(sequences) {}
+
+  void residues(const uint8_t* codes, size_t n) override {
+    sequences_.append_residues(codes, n);
+  }
+
+  void end_record(std::string_view header) override {
+    headers_.push_back(header);
+    sequences_.end_sequence();
+  }
+
+ private:
+  HeaderStore& headers_;
+  SequenceStore& sequences_;
+};
+
+}  // namespace
+
+
+void FastaStreamParser::feed(const char* data, size_t n) {
+  const char* pos = data;
+  const char* end = data + n;
+  while (pos < end) {
+    switch (state_) {
+      case State::kLineStart:
+        if (*pos == '>') {
+          end_record();
+          header_.clear();
+          state_ = State::kHeader;
+        } else {
+          state_ = State::kBody;
+        }
+        break;
+      case State::kHeader: {
+        auto newline = static_cast<const char*>(memchr(pos, '\n', end - pos));
+        if (newline == nullptr) {
+          header_.append(pos, end);
+          pos = end;
+        } else {
+          header_.append(pos, newline);
+          pos = newline + 1;
+          state_ = State::kLineStart;
+          if (index_ != nullptr) {
+            index_->start_record(header_);
+          }
+        }
+        break;
+      }
+      case State::kBody: {
+        // Every line up to the next header goes through the residue kernel
+        // in one call, which also drops the newlines.
+        const char* body_end = find_record_start(pos, end);
+        auto body_size = static_cast<size_t>(body_end - pos);
+        if (index_ != nullptr) {
+          index_->body(pos, body_size, offset_ + (pos - data));
+        }
+        if (codes_.size() < body_size) {
+          codes_.resize(body_size);
+        }
+        size_t count = encode_residues(pos, body_size, codes_.data());
+        if (count > 0) {
+          sink_.residues(codes_.data(), count);
+          record_residues_ += count;
+        }
+        if (body_end != end || body_end[-1] == '\n') {
+          state_ = State::kLineStart;
+        }
+        pos = body_end;
+        break;
+      }
+    }
+  }
+  offset_ += n;
+}
+
+
+void FastaStreamParser::finish() {
+  end_record();
+  state_ = State::kLineStart;
+  header_.clear();
+}
+
+
+void FastaStreamParser::end_record() {
+  if (index_ != nullptr) {
+    index_->end_record(record_residues_ > 0);
+  }
+  if (record_residues_ > 0) {
+    sink_.end_record(header_);
+    record_residues_ = 0;
+  }
+}
+
+
+void parse_fasta(const char* begin, const char* end,
+  HeaderStore& headers, SequenceStore& sequences,
+  std::vector<FaiEntry>* index) {
+  VectorSink sink(headers, sequences);
+  std::unique_ptr<FastaIndexBuilder> index_builder;
+  if (index != nullptr) {
+    index_builder = std::make_unique<FastaIndexBuilder>(*index);
+  }
+  FastaStreamParser parser(sink, index_builder.get());
+  parser.feed(begin, end - begin);
+  parser.finish();
+  sequences.shrink_to_fit();
+  headers.shrink_to_fit();
+  assert (sequences.size() == headers.size());
+}
+
+
+void parse_fasta_parallel(const char* begin, const char* end,
+  HeaderStore& headers, SequenceStore& sequences,
+  size_t num_threads, std::vector<FaiEntry>* index) {
+  ThreadPool pool(num_threads);
+  size_t num_ranges = pool.size();
+  auto size = static_cast<size_t>(end - begin);
+
+  // Range i starts at the first record that opens at or after i/n of the
+  // input, so no record is cut and every range parses independently.
+  std::vector<const char*> bounds = {begin};
+  for (size_t i = 1; i < num_ranges; i++) {
+    const char* target = begin + size / num_ranges * i;
+    const char* search = target > bounds.back() ? target - 1 : bounds.back();
+    const char* bound = find_record_start(search, end);
+    if (bound != bounds.back()) {
+      bounds.push_back(bound);
+    }
+  }
+  bounds.push_back(end);
+
+  struct Range {
+    HeaderStore headers;
+    SequenceStore sequences;
+    std::vector<FaiEntry> index;
+  };
+  std::vector<std::future<Range>> parsed;
+  for (size_t i = 0; i + 1 < bounds.size(); i++) {
+    const char* first = bounds[i];
+    const char* last = bounds[i + 1];
+    bool with_index = index != nullptr;
+    parsed.push_back(pool.submit([first, last, with_index]() {
+      Range range;
+      parse_fasta(first, last, range.headers, range.sequences,
+                  with_index ? &range.index : nullptr);
+      return range;
+    }));
+  }
+
+  std::vector<Range> ranges;
+  size_t total_sequences = 0;
+  size_t total_residues = 0;
+  for (std::future<Range>& range: parsed) {
+    ranges.push_back(range.get());
+    total_sequences += ranges.back().sequences.size();
+    total_residues += ranges.back().sequences.total_residues();
+  }
+  sequences.reserve(sequences.size() + total_sequences,
+                    sequences.total_residues() + total_residues);
+  for (size_t i = 0; i < ranges.size(); i++) {
+    Range& range = ranges[i];
+    if (index != nullptr) {
+      for (FaiEntry& entry: range.index) {
+        entry.offset += static_cast<uint64_t>(bounds[i] - begin);
+        index->push_back(std::move(entry));
+      }
+    }
+    headers.append(range.headers);
+    sequences.append(range.sequences);
+    range.sequences = SequenceStore();
+  }
+  assert (sequences.size() == headers.size());
+}
+
+
+void load_fasta_sequences(const std::string& filename,
+  HeaderStore& headers, SequenceStore& sequences,
+  size_t num_threads, std::vector<FaiEntry>* index) {
+  FastaInput input(filename, num_threads);
+  const char* begin = input.data();
+  const char* end = begin + input.size();
+  if (num_threads == 1) {
+    parse_fasta(begin, end, headers, sequences, index);
+  } else {
+    parse_fasta_parallel(begin, end, headers, sequences, num_threads, index);
+  }
+}
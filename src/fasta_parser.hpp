@@ -0,0 +1,79 @@
+#ifndef CONVERGE_ENCODER_FASTA_PARSER_HPP_
+#define CONVERGE_ENCODER_FASTA_PARSER_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "fasta_index.hpp"
+#include "header_store.hpp"
+#include "sequence_store.hpp"
+
+// Receives the records found by FastaStreamParser. A record's residues
+// arrive in one or more residues() calls, then end_record() hands over its
+// header. Records without any residue in the 20-letter alphabet are dropped
+// and never reach the sink.
+class FastaSink {
+ public:
+  virtual ~FastaSink() = default;
+  virtual void residues(const uint8_t* codes, size_t n) = 0;
+  virtual void end_record(std::string_view header) = 0;
+};
+
+
+// Single-pass FASTA parser for input that arrives in pieces of any size.
+// Record bodies are encoded with encode_residues() as they stream past, so
+// only the current header is ever buffered. With an index builder, the
+// .fai rows are collected in the same pass; offset is the input position
+// of the first byte fed.
+class FastaStreamParser {
+ public:
+  explicit FastaStreamParser(FastaSink& sink,
+                             FastaIndexBuilder* index = nullptr,
+                             uint64_t offset = 0)
+    : sink_(sink), index_(index), offset_(offset) {}
+
+  void feed(const char* data, size_t n);
+  // Flushes the last record.
+  void finish();
+
+ private:
+  enum class State { kLineStart, kHeader, kBody };
+
+  void end_record();
+
+  FastaSink& sink_;
+  FastaIndexBuilder* index_;
+  uint64_t offset_;
+  State state_ = State::kLineStart;
+  std::string header_;
+  size_t record_residues_ = 0;
+  std::vector<uint8_t> codes_;
+};
+
+
+// Parses the FASTA text in [begin, end) in a single pass, appending one
+// header and one encoded sequence per record. If index is given, one .fai
+// row per sequence is appended to it, with offsets relative to begin.
+void parse_fasta(const char* begin, const char* end,
+  HeaderStore& headers, SequenceStore& sequences,
+  std::vector<FaiEntry>* index = nullptr);
+
+// Same result as parse_fasta(), with the input split at record boundaries
+// into num_threads roughly equal byte ranges that are parsed concurrently
+// and stitched back together in input order. num_threads == 0 uses every
+// hardware thread.
+void parse_fasta_parallel(const char* begin, const char* end,
+  HeaderStore& headers, SequenceStore& sequences,
+  size_t num_threads, std::vector<FaiEntry>* index = nullptr);
+
+// Maps filename into memory (inflating it first if it is gzip or BGZF) and
+// parses it with parse_fasta(), or with parse_fasta_parallel() when
+// num_threads != 1.
+void load_fasta_sequences(const std::string& filename,
+  HeaderStore& headers, SequenceStore& sequences,
+  size_t num_threads = 1, std::vector<FaiEntry>* index = nullptr);
+
+#endif  // CONVERGE_ENCODER_FASTA_PARSER_HPP_
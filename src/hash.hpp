@@ -0,0 +1,10 @@
+#ifndef CONVERGE_ENCODER_HASH_HPP_
+#define CONVERGE_ENCODER_HASH_HPP_
+
+#include <cstddef>
+#include <cstdint>
+
+// XXH64 of n bytes; matches the reference xxHash implementation.
+uint64_t xxhash64(const void* data, size_t n, uint64_t seed = 0);
+
+#endif  // CONVERGE_ENCODER_HASH_HPP_
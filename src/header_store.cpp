@@ -0,0 +1,86 @@
+#include "header_store.hpp"
+
+
+void StringColumn::append(const StringColumn& other) {
+  uint64_t base = arena_.size();
+  arena_.append(other.arena_);
+  offsets_.reserve(offsets_.size() + other.size());
+  for (size_t i = 1; i < other.offsets_.size(); i++) {
+    offsets_.push_back(base + other.offsets_[i]);
+  }
+}
+
+
+void StringColumn::shrink_to_fit() {
+  offsets_.shrink_to_fit();
+  arena_.shrink_to_fit();
+}
+
+
+HeaderFields split_header_fields(std::string_view header) {
+  if (!header.empty() && header[0] == '>') {
+    header.remove_prefix(1);
+  }
+  std::string_view first_word = header.substr(0, header.find_first_of(" \t\r"));
+  HeaderFields fields;
+  size_t bar = first_word.find('|');
+  if (bar == std::string_view::npos) {
+    fields.accession = first_word;
+    return fields;
+  }
+  fields.database = first_word.substr(0, bar);
+  std::string_view rest = first_word.substr(bar + 1);
+  bar = rest.find('|');
+  fields.accession = rest.substr(0, bar);
+  if (bar != std::string_view::npos) {
+    rest = rest.substr(bar + 1);
+    fields.entry_name = rest.substr(0, rest.find('|'));
+  }
+  return fields;
+}
+
+
+void HeaderStore::push_back(std::string_view header) {
+  HeaderFields fields = split_header_fields(header);
+  headers_.push_back(header);
+  databases_.push_back(fields.database);
+  accessions_.push_back(fields.accession);
+  entry_names_.push_back(fields.entry_name);
+}
+
+
+void HeaderStore::append(const HeaderStore& other) {
+  headers_.append(other.headers_);
+  databases_.append(other.databases_);
+  accessions_.append(other.accessions_);
+  entry_names_.append(other.entry_names_);
+}
+
+
+void HeaderStore::shrink_to_fit() {
+  headers_.shrink_to_fit();
+  databases_.shrink_to_fit();
+  accessions_.shrink_to_fit();
+  entry_names_.shrink_to_fit();
+}
+
+
+size_t HeaderStore::find_accession(std::string_view accession) const {
+  for (size_t i = 0; i < accessions_.size(); i++) {
+    if (accessions_[i] == accession) {
+      return i;
+    }
+  }
+  return npos;
+}
+
+
+std::unordered_map<std::string_view, size_t>
+HeaderStore::accession_index() const {
+  std::unordered_map<std::string_view, size_t> index;
+  index.reserve(accessions_.size());
+  for (size_t i = 0; i < accessions_.size(); i++) {
+    index.emplace(accessions_[i], i);
+  }
+  return index;
+}
@@ -0,0 +1,106 @@
+#ifndef CONVERGE_ENCODER_HEADER_STORE_HPP_
+#define CONVERGE_ENCODER_HEADER_STORE_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Strings stored back to back in one arena: string i is
+// arena[offsets[i], offsets[i + 1]). Serializes as two bulk blocks.
+class StringColumn {
+ public:
+  StringColumn() : offsets_{0} {}
+
+  size_t size() const { return offsets_.size() - 1; }
+  std::string_view operator[](size_t i) const {
+    return std::string_view(arena_.data() + offsets_[i],
+                            offsets_[i + 1] - offsets_[i]);
+  }
+
+  void push_back(std::string_view value) {
+    arena_.append(value.data(), value.size());
+    offsets_.push_back(arena_.size());
+  }
+  void append(const StringColumn& other);
+  void shrink_to_fit();
+
+  const std::vector<uint64_t>& offsets() const { return offsets_; }
+  const std::string& arena() const { return arena_; }
+
+  bool operator==(const StringColumn& other) const {
+    return offsets_ == other.offsets_ && arena_ == other.arena_;
+  }
+
+  template <class Archive>
+  void serialize(Archive& archive) {
+    archive(offsets_, arena_);
+  }
+
+ private:
+  std::vector<uint64_t> offsets_;
+  std::string arena_;
+};
+
+
+// The UniProt-style fields of a header ">db|accession|entry_name ...".
+// Headers without a '|' in their first word only get an accession, which is
+// that first word.
+struct HeaderFields {
+  std::string_view database;
+  std::string_view accession;
+  std::string_view entry_name;
+};
+
+HeaderFields split_header_fields(std::string_view header);
+
+
+// Column store for the FASTA headers of a proteome: the full header lines
+// plus database, accession and entry name pre-split into their own columns,
+// so accessions can be matched without parsing every header.
+class HeaderStore {
+ public:
+  size_t size() const { return headers_.size(); }
+  std::string_view operator[](size_t i) const { return headers_[i]; }
+  std::string_view database(size_t i) const { return databases_[i]; }
+  std::string_view accession(size_t i) const { return accessions_[i]; }
+  std::string_view entry_name(size_t i) const { return entry_names_[i]; }
+
+  void push_back(std::string_view header);
+  // Appends every header of other, in order.
+  void append(const HeaderStore& other);
+  void shrink_to_fit();
+
+  // Index of the first header with this accession, or npos.
+  size_t find_accession(std::string_view accession) const;
+  // Accession -> first header index, for repeated lookups. The views point
+  // into this store.
+  std::unordered_map<std::string_view, size_t> accession_index() const;
+
+  const StringColumn& headers() const { return headers_; }
+  const StringColumn& databases() const { return databases_; }
+  const StringColumn& accessions() const { return accessions_; }
+  const StringColumn& entry_names() const { return entry_names_; }
+
+  // The field columns are derived from the headers.
+  bool operator==(const HeaderStore& other) const {
+    return headers_ == other.headers_;
+  }
+
+  template <class Archive>
+  void serialize(Archive& archive) {
+    archive(headers_, databases_, accessions_, entry_names_);
+  }
+
+  static constexpr size_t npos = static_cast<size_t>(-1);
+
+ private:
+  StringColumn headers_;
+  StringColumn databases_;
+  StringColumn accessions_;
+  StringColumn entry_names_;
+};
+
+#endif  // CONVERGE_ENCODER_HEADER_STORE_HPP_
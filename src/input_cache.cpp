@@ -0,0 +1,75 @@
+#include "input_cache.hpp"
+
+#include <cstdio>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include "hash.hpp"
+#include "mapped_file.hpp"
+
+
+uint64_t hash_input(const std::string& filename) {
+  MappedFile file(filename);
+  return xxhash64(file.data(), file.size());
+}
+
+
+void write_input_cache(const std::string& filename,
+  const std::vector<InputCacheEntry>& entries) {
+  std::ofstream file(filename);
+  if (!file.is_open()) {
+    std::cout << "File " << filename << " failed to open" << std::endl;
+    std::terminate();
+  }
+  for (const InputCacheEntry& entry: entries) {
+    char hex[17];
+    snprintf(hex, sizeof(hex), "%016llx",
+             static_cast<unsigned long long>(entry.input_hash));
+    file << entry.step << '\t' << hex << '\t' << entry.parameters << '\t';
+    for (size_t i = 0; i < entry.outputs.size(); i++) {
+      file << (i > 0 ? " " : "") << entry.outputs[i];
+    }
+    file << '\n';
+  }
+}
+
+
+std::vector<InputCacheEntry> read_input_cache(const std::string& filename) {
+  std::vector<InputCacheEntry> entries;
+  std::ifstream file(filename);
+  if (!file.is_open()) {
+    return entries;
+  }
+  std::string line;
+  while (std::getline(file, line)) {
+    if (line.empty()) {
+      continue;
+    }
+    std::istringstream fields(line);
+    InputCacheEntry entry;
+    std::string hash;
+    std::string outputs;
+    std::getline(fields, entry.step, '\t');
+    std::getline(fields, hash, '\t');
+    std::getline(fields, entry.parameters, '\t');
+    bool valid = !fields.fail();
+    // Empty if the step has no outputs of its own.
+    std::getline(fields, outputs);
+    std::istringstream hex(hash);
+    hex >> std::hex >> entry.input_hash;
+    if (!valid || hash.size() != 16 || hex.fail()) {
+      std::cerr << "File " << filename << " has a malformed line: " << line
+                << std::endl;
+      std::terminate();
+    }
+    std::istringstream names(outputs);
+    std::string name;
+    while (names >> name) {
+      entry.outputs.push_back(name);
+    }
+    entries.push_back(std::move(entry));
+  }
+  return entries;
+}
@@ -0,0 +1,35 @@
+#ifndef CONVERGE_ENCODER_INPUT_CACHE_HPP_
+#define CONVERGE_ENCODER_INPUT_CACHE_HPP_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// What one step of a run (proteome, seeds, matrix) was encoded from: the
+// XXH64 of its input file's bytes and the options that shape its outputs.
+// A later run whose step has the same key can keep that step's outputs
+// instead of parsing and writing them again.
+struct InputCacheEntry {
+  std::string step;
+  uint64_t input_hash = 0;
+  std::string parameters;
+  // Names in the checksum manifest.
+  std::vector<std::string> outputs;
+
+  bool same_key(const InputCacheEntry& other) const {
+    return step == other.step && input_hash == other.input_hash &&
+           parameters == other.parameters;
+  }
+};
+
+// XXH64 of the whole file, read through a mapping.
+uint64_t hash_input(const std::string& filename);
+
+// The cache is one tab-separated line per step: step, hash in hex,
+// parameters, and the space-separated outputs. A missing cache reads as
+// empty.
+void write_input_cache(const std::string& filename,
+  const std::vector<InputCacheEntry>& entries);
+std::vector<InputCacheEntry> read_input_cache(const std::string& filename);
+
+#endif  // CONVERGE_ENCODER_INPUT_CACHE_HPP_
@@ -0,0 +1,54 @@
+#include "mapped_file.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <exception>
+#include <iostream>
+
+
+MappedFile::MappedFile(const std::string& filename, bool sequential) {
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    std::cout << "File " << filename << " failed to open" << std::endl;
+    std::terminate();
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    std::cout << "File " << filename << " failed to stat" << std::endl;
+    std::terminate();
+  }
+  size_ = static_cast<size_t>(st.st_size);
+  if (size_ > 0) {
+    void* addr = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (addr == MAP_FAILED) {
+      std::cout << "File " << filename << " failed to mmap" << std::endl;
+      std::terminate();
+    }
+    // The parser only ever walks forward, so let the kernel read ahead.
+    if (sequential) {
+      madvise(addr, size_, MADV_SEQUENTIAL);
+    }
+    data_ = static_cast<const char*>(addr);
+  }
+  close(fd);
+}
+
+
+MappedFile::~MappedFile() {
+  if (data_ != nullptr) {
+    munmap(const_cast<char*>(data_), size_);
+  }
+}
+
+
+char* MappedFile::writable_data() {
+  if (data_ != nullptr &&
+      mprotect(const_cast<char*>(data_), size_, PROT_READ | PROT_WRITE) != 0) {
+    std::cout << "Failed to make a mapping writable" << std::endl;
+    std::terminate();
+  }
+  return const_cast<char*>(data_);
+}
@@ -0,0 +1,29 @@
+#ifndef CONVERGE_ENCODER_MAPPED_FILE_HPP_
+#define CONVERGE_ENCODER_MAPPED_FILE_HPP_
+
+#include <cstddef>
+#include <string>
+
+// Read-only memory mapping of a whole input file. The mapping lives as long
+// as the object; an empty file maps to (nullptr, 0). Sequential mappings
+// ask the kernel for aggressive read-ahead.
+class MappedFile {
+ public:
+  explicit MappedFile(const std::string& filename, bool sequential = true);
+  ~MappedFile();
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  const char* data() const { return data_; }
+  // Makes the mapping writable so that it can be fixed up in place. It is
+  // private: changes never reach the file.
+  char* writable_data();
+  size_t size() const { return size_; }
+
+ private:
+  const char* data_ = nullptr;
+  size_t size_ = 0;
+};
+
+#endif  // CONVERGE_ENCODER_MAPPED_FILE_HPP_
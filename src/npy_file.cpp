@@ -0,0 +1,87 @@
+#include "npy_file.hpp"
+
+#include <exception>
+#include <iostream>
+
+#include "converge_encoder/byte_order.hpp"
+#include "output_file.hpp"
+
+
+namespace {
+
+constexpr char kNpyMagic[] = "\x93NUMPY";
+constexpr size_t kNpyAlignment = 64;
+constexpr char kOrder = kHostLittleEndian ? '<' : '>';
+
+constexpr char kUint8[] = "|u1";
+constexpr char kUint32[] = {kOrder, 'u', '4', '\0'};
+constexpr char kUint64[] = {kOrder, 'u', '8', '\0'};
+constexpr char kFloat64[] = {kOrder, 'f', '8', '\0'};
+
+}  // namespace
+
+
+template <>
+const char* npy_dtype<uint8_t>() {
+  return kUint8;
+}
+
+
+template <>
+const char* npy_dtype<uint32_t>() {
+  return kUint32;
+}
+
+
+template <>
+const char* npy_dtype<uint64_t>() {
+  return kUint64;
+}
+
+
+template <>
+const char* npy_dtype<double>() {
+  return kFloat64;
+}
+
+
+uint32_t write_npy(const std::string& filename, const void* data,
+  size_t element_size, const char* dtype, const std::vector<size_t>& shape) {
+  size_t count = 1;
+  std::string header = std::string("{'descr': '") + dtype +
+                       "', 'fortran_order': False, 'shape': (";
+  for (size_t dim: shape) {
+    header += std::to_string(dim) + ", ";
+    count *= dim;
+  }
+  // A 1-tuple keeps its comma, longer ones do not need it.
+  if (shape.size() > 1) {
+    header.resize(header.size() - 2);
+  } else if (!shape.empty()) {
+    header.pop_back();
+  }
+  header += "), }";
+  // magic, version, header length, header, padding and a newline.
+  size_t preamble = sizeof(kNpyMagic) - 1 + 2 + 2;
+  size_t padded = (preamble + header.size() + 1 + kNpyAlignment - 1) /
+                  kNpyAlignment * kNpyAlignment;
+  header.append(padded - preamble - header.size() - 1, ' ');
+  header += '\n';
+  if (header.size() > UINT16_MAX) {
+    std::cerr << "File " << filename << " has too long an npy header"
+              << std::endl;
+    std::terminate();
+  }
+
+  OutputFile file(filename, 1 << 22);
+  uint8_t version[2] = {1, 0};
+  uint8_t header_size[2] = {static_cast<uint8_t>(header.size() & 0xFF),
+                            static_cast<uint8_t>(header.size() >> 8)};
+  file.write(kNpyMagic, sizeof(kNpyMagic) - 1);
+  file.write(version, sizeof(version));
+  file.write(header_size, sizeof(header_size));
+  file.write(header.data(), header.size());
+  file.write(data, count * element_size);
+  file.close();
+  return file.checksum();
+}
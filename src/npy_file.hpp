@@ -0,0 +1,29 @@
+#ifndef CONVERGE_ENCODER_NPY_FILE_HPP_
+#define CONVERGE_ENCODER_NPY_FILE_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// NumPy .npy files (format 1.0) for readers outside C++: a text header
+// giving dtype and shape, padded so that the data starts on a 64-byte
+// boundary, then the array in C order and host byte order. They open
+// without a copy through np.load(filename, mmap_mode="r").
+
+// The dtype string of T, e.g. "<u8" for uint64_t on a little-endian host.
+template <class T>
+const char* npy_dtype();
+
+// Writes count elements of the dtype at data with the given shape, whose
+// product must be count. Returns the CRC32C of the whole file.
+uint32_t write_npy(const std::string& filename, const void* data,
+  size_t element_size, const char* dtype, const std::vector<size_t>& shape);
+
+template <class T>
+uint32_t write_npy(const std::string& filename, const std::vector<T>& values) {
+  return write_npy(filename, values.data(), sizeof(T), npy_dtype<T>(),
+                   {values.size()});
+}
+
+#endif  // CONVERGE_ENCODER_NPY_FILE_HPP_
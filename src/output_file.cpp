@@ -0,0 +1,145 @@
+#include "output_file.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <iostream>
+
+#include "crc32c.hpp"
+
+
+namespace {
+
+void write_fully(int fd, const char* data, size_t n, uint64_t offset,
+  const std::string& filename) {
+  while (n > 0) {
+    ssize_t written = pwrite(fd, data, n, static_cast<off_t>(offset));
+    if (written <= 0) {
+      std::cerr << "File " << filename << " failed to write" << std::endl;
+      std::terminate();
+    }
+    data += written;
+    n -= static_cast<size_t>(written);
+    offset += static_cast<uint64_t>(written);
+  }
+}
+
+}  // namespace
+
+
+OutputFile::OutputFile(const std::string& filename, size_t buffer_size,
+  bool append)
+  : filename_(filename), buffer_(std::max<size_t>(buffer_size, 4096)) {
+  fd_ = append ? open(filename.c_str(), O_WRONLY)
+               : open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd_ < 0) {
+    std::cout << "File " << filename << " failed to open" << std::endl;
+    std::terminate();
+  }
+  if (append) {
+    off_t end = lseek(fd_, 0, SEEK_END);
+    if (end < 0) {
+      std::cout << "File " << filename << " failed to seek" << std::endl;
+      std::terminate();
+    }
+    flushed_ = static_cast<uint64_t>(end);
+  }
+}
+
+
+OutputFile::~OutputFile() {
+  close();
+}
+
+
+void OutputFile::write(const void* data, size_t n) {
+  auto bytes = static_cast<const char*>(data);
+  checksum_ = crc32c(bytes, n, checksum_);
+  if (used_ + n > buffer_.size()) {
+    flush();
+    if (n >= buffer_.size()) {
+      write_fully(fd_, bytes, n, flushed_, filename_);
+      flushed_ += n;
+      return;
+    }
+  }
+  memcpy(buffer_.data() + used_, bytes, n);
+  used_ += n;
+}
+
+
+void OutputFile::patch(uint64_t offset, const void* data, size_t n) {
+  auto bytes = static_cast<const char*>(data);
+  // The patched range may straddle what is on disk and what is buffered.
+  while (n > 0 && offset < flushed_) {
+    size_t on_disk = std::min<uint64_t>(n, flushed_ - offset);
+    write_fully(fd_, bytes, on_disk, offset, filename_);
+    bytes += on_disk;
+    offset += on_disk;
+    n -= on_disk;
+  }
+  if (n > 0) {
+    memcpy(buffer_.data() + (offset - flushed_), bytes, n);
+  }
+}
+
+
+void OutputFile::append_file(const std::string& filename) {
+  flush();
+  int in = open(filename.c_str(), O_RDONLY);
+  if (in < 0) {
+    std::cout << "File " << filename << " failed to open" << std::endl;
+    std::terminate();
+  }
+  ssize_t got;
+  while ((got = read(in, buffer_.data(), buffer_.size())) > 0) {
+    checksum_ = crc32c(buffer_.data(), static_cast<size_t>(got), checksum_);
+    write_fully(fd_, buffer_.data(), static_cast<size_t>(got), flushed_,
+                filename_);
+    flushed_ += static_cast<uint64_t>(got);
+  }
+  ::close(in);
+  if (got < 0) {
+    std::cerr << "File " << filename << " failed to read" << std::endl;
+    std::terminate();
+  }
+}
+
+
+void OutputFile::truncate(uint64_t size) {
+  flush();
+  if (ftruncate(fd_, static_cast<off_t>(size)) != 0) {
+    std::cerr << "File " << filename_ << " failed to truncate" << std::endl;
+    std::terminate();
+  }
+  flushed_ = size;
+}
+
+
+void OutputFile::sync() {
+  flush();
+  if (fsync(fd_) != 0) {
+    std::cerr << "File " << filename_ << " failed to sync" << std::endl;
+    std::terminate();
+  }
+}
+
+
+void OutputFile::close() {
+  if (fd_ < 0) {
+    return;
+  }
+  flush();
+  ::close(fd_);
+  fd_ = -1;
+}
+
+
+void OutputFile::flush() {
+  write_fully(fd_, buffer_.data(), used_, flushed_, filename_);
+  flushed_ += used_;
+  used_ = 0;
+}
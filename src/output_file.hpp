@@ -0,0 +1,53 @@
+#ifndef CONVERGE_ENCODER_OUTPUT_FILE_HPP_
+#define CONVERGE_ENCODER_OUTPUT_FILE_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Append-only binary output with a fixed-size write buffer. Bytes that were
+// already written can be overwritten with patch(), e.g. to fill in a count
+// once it is known. A running CRC32C of what write() and append_file() add
+// is kept as they go; patch() does not update it.
+class OutputFile {
+ public:
+  // With append the file must exist; writes continue at its end and tell()
+  // counts from its start.
+  OutputFile(const std::string& filename, size_t buffer_size,
+             bool append = false);
+  ~OutputFile();
+
+  OutputFile(const OutputFile&) = delete;
+  OutputFile& operator=(const OutputFile&) = delete;
+
+  void write(const void* data, size_t n);
+  void patch(uint64_t offset, const void* data, size_t n);
+  // Appends the whole content of another file.
+  void append_file(const std::string& filename);
+  // Cuts the file to size bytes, which must not be more than tell(), and
+  // continues writing there.
+  void truncate(uint64_t size);
+  // Writes out the buffer and waits until everything written so far is on
+  // the storage device.
+  void sync();
+  // Offset the next write() lands at.
+  uint64_t tell() const { return flushed_ + used_; }
+  // CRC32C of the bytes appended since construction or the last
+  // reset_checksum().
+  uint32_t checksum() const { return checksum_; }
+  void reset_checksum() { checksum_ = 0; }
+  void close();
+
+ private:
+  void flush();
+
+  std::string filename_;
+  int fd_ = -1;
+  std::vector<char> buffer_;
+  size_t used_ = 0;
+  uint64_t flushed_ = 0;
+  uint32_t checksum_ = 0;
+};
+
+#endif  // CONVERGE_ENCODER_OUTPUT_FILE_HPP_
@@ -0,0 +1,280 @@
+#include "residue_encoder.hpp"
+
+#include <exception>
+#include <iostream>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CONVERGE_ENCODER_X86 1
+#include <immintrin.h>
+#endif
+
+
+namespace {
+
+constexpr uint8_t kInvalid = 0xFF;
+
+constexpr std::array<uint8_t, 256> make_code_table() {
+  std::array<uint8_t, 256> table{};
+  for (auto& code: table) {
+    code = kInvalid;
+  }
+  for (int i=0;i<20;i++){
+    table[static_cast<uint8_t>(kAlphabet[i])] = static_cast<uint8_t>(i);
+  }
+  return table;
+}
+
+// Byte -> residue code, kInvalid for everything outside the alphabet.
+constexpr std::array<uint8_t, 256> kCodeTable = make_code_table();
+
+
+size_t encode_scalar(const char* src, size_t n, uint8_t* dst) {
+  size_t out = 0;
+  for (size_t i = 0; i < n; i++) {
+    uint8_t code = kCodeTable[static_cast<uint8_t>(src[i])];
+    dst[out] = code;
+    out += code != kInvalid;
+  }
+  return out;
+}
+
+
+#ifdef CONVERGE_ENCODER_X86
+
+// The vector kernels index by (byte - 'A'); all 20 letters fall in [0, 25).
+constexpr std::array<uint8_t, 64> make_letter_table() {
+  std::array<uint8_t, 64> table{};
+  for (int i=0;i<64;i++){
+    table[i] = kCodeTable[('A' + i) & 0xFF];
+  }
+  return table;
+}
+
+alignas(64) constexpr std::array<uint8_t, 64> kLetterTable =
+  make_letter_table();
+
+// For every 8-bit keep mask, the pshufb indices that move the kept bytes of
+// an 8-byte group to the front.
+constexpr std::array<uint64_t, 256> make_compact_table() {
+  std::array<uint64_t, 256> table{};
+  for (int mask=0;mask<256;mask++){
+    uint64_t indices = 0;
+    int out = 0;
+    for (int bit=0;bit<8;bit++){
+      if (mask & (1 << bit)) {
+        indices |= static_cast<uint64_t>(bit) << (8 * out);
+        out++;
+      }
+    }
+    for (;out<8;out++){
+      indices |= static_cast<uint64_t>(0x80) << (8 * out);
+    }
+    table[mask] = indices;
+  }
+  return table;
+}
+
+alignas(64) constexpr std::array<uint64_t, 256> kCompactTable =
+  make_compact_table();
+
+
+// Writes the kept bytes of the low 8 bytes of codes to dst, returns count.
+__attribute__((target("sse4.2,popcnt")))
+inline size_t compact8(__m128i codes, unsigned mask, uint8_t* dst) {
+  __m128i shuffle = _mm_loadl_epi64(
+    reinterpret_cast<const __m128i*>(&kCompactTable[mask]));
+  _mm_storel_epi64(reinterpret_cast<__m128i*>(dst),
+                   _mm_shuffle_epi8(codes, shuffle));
+  return static_cast<size_t>(_mm_popcnt_u32(mask));
+}
+
+
+// Classifies 16 bytes; returns their codes and sets keep to the mask of
+// bytes that are alphabet letters.
+__attribute__((target("sse4.2,popcnt")))
+inline __m128i classify16(__m128i bytes, unsigned& keep) {
+  const __m128i table_lo = _mm_load_si128(
+    reinterpret_cast<const __m128i*>(kLetterTable.data()));
+  const __m128i table_hi = _mm_load_si128(
+    reinterpret_cast<const __m128i*>(kLetterTable.data() + 16));
+  __m128i idx = _mm_sub_epi8(bytes, _mm_set1_epi8('A'));
+  __m128i lo = _mm_shuffle_epi8(table_lo, idx);
+  __m128i hi = _mm_shuffle_epi8(table_hi, idx);
+  __m128i is_lo = _mm_cmpeq_epi8(_mm_min_epu8(idx, _mm_set1_epi8(15)), idx);
+  __m128i in_range =
+    _mm_cmpeq_epi8(_mm_min_epu8(idx, _mm_set1_epi8(24)), idx);
+  __m128i codes = _mm_blendv_epi8(hi, lo, is_lo);
+  __m128i invalid = _mm_cmpeq_epi8(codes, _mm_set1_epi8(-1));
+  keep = static_cast<unsigned>(
+    _mm_movemask_epi8(_mm_andnot_si128(invalid, in_range)));
+  return codes;
+}
+
+
+__attribute__((target("sse4.2,popcnt")))
+size_t encode_sse42(const char* src, size_t n, uint8_t* dst) {
+  size_t out = 0;
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+    unsigned keep;
+    __m128i codes = classify16(bytes, keep);
+    if (keep == 0xFFFF) {
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + out), codes);
+      out += 16;
+      continue;
+    }
+    out += compact8(codes, keep & 0xFF, dst + out);
+    out += compact8(_mm_srli_si128(codes, 8), keep >> 8, dst + out);
+  }
+  return out + encode_scalar(src + i, n - i, dst + out);
+}
+
+
+__attribute__((target("avx2,popcnt")))
+size_t encode_avx2(const char* src, size_t n, uint8_t* dst) {
+  const __m256i table_lo = _mm256_broadcastsi128_si256(_mm_load_si128(
+    reinterpret_cast<const __m128i*>(kLetterTable.data())));
+  const __m256i table_hi = _mm256_broadcastsi128_si256(_mm_load_si128(
+    reinterpret_cast<const __m128i*>(kLetterTable.data() + 16)));
+  size_t out = 0;
+  size_t i = 0;
+  for (; i + 32 <= n; i += 32) {
+    __m256i bytes =
+      _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+    __m256i idx = _mm256_sub_epi8(bytes, _mm256_set1_epi8('A'));
+    __m256i lo = _mm256_shuffle_epi8(table_lo, idx);
+    __m256i hi = _mm256_shuffle_epi8(table_hi, idx);
+    __m256i is_lo =
+      _mm256_cmpeq_epi8(_mm256_min_epu8(idx, _mm256_set1_epi8(15)), idx);
+    __m256i in_range =
+      _mm256_cmpeq_epi8(_mm256_min_epu8(idx, _mm256_set1_epi8(24)), idx);
+    __m256i codes = _mm256_blendv_epi8(hi, lo, is_lo);
+    __m256i invalid = _mm256_cmpeq_epi8(codes, _mm256_set1_epi8(-1));
+    auto keep = static_cast<uint32_t>(
+      _mm256_movemask_epi8(_mm256_andnot_si256(invalid, in_range)));
+    if (keep == 0xFFFFFFFFu) {
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + out), codes);
+      out += 32;
+      continue;
+    }
+    __m128i codes_lo = _mm256_castsi256_si128(codes);
+    __m128i codes_hi = _mm256_extracti128_si256(codes, 1);
+    out += compact8(codes_lo, keep & 0xFF, dst + out);
+    out += compact8(_mm_srli_si128(codes_lo, 8), (keep >> 8) & 0xFF,
+                    dst + out);
+    out += compact8(codes_hi, (keep >> 16) & 0xFF, dst + out);
+    out += compact8(_mm_srli_si128(codes_hi, 8), keep >> 24, dst + out);
+  }
+  return out + encode_scalar(src + i, n - i, dst + out);
+}
+
+
+// Needs VBMI for the 64-entry byte permute and VBMI2 for byte compression.
+__attribute__((target("avx512f,avx512bw,avx512vbmi,avx512vbmi2,popcnt")))
+size_t encode_avx512(const char* src, size_t n, uint8_t* dst) {
+  const __m512i table = _mm512_load_si512(kLetterTable.data());
+  size_t out = 0;
+  size_t i = 0;
+  for (; i + 64 <= n; i += 64) {
+    __m512i bytes = _mm512_loadu_si512(src + i);
+    __m512i idx = _mm512_sub_epi8(bytes, _mm512_set1_epi8('A'));
+    // The zero-masked form: GCC 12 flags the unmasked one's undefined
+    // pass-through vector as maybe uninitialized.
+    __m512i codes = _mm512_maskz_permutexvar_epi8(~__mmask64(0), idx, table);
+    __mmask64 keep =
+      _mm512_cmple_epu8_mask(idx, _mm512_set1_epi8(24)) &
+      _mm512_cmpneq_epi8_mask(codes, _mm512_set1_epi8(-1));
+    _mm512_mask_compressstoreu_epi8(dst + out, keep, codes);
+    out += static_cast<size_t>(_mm_popcnt_u64(keep));
+  }
+  return out + encode_scalar(src + i, n - i, dst + out);
+}
+
+#endif  // CONVERGE_ENCODER_X86
+
+
+using EncodeFn = size_t (*)(const char*, size_t, uint8_t*);
+
+EncodeFn encode_fn(EncoderIsa isa) {
+  switch (isa) {
+#ifdef CONVERGE_ENCODER_X86
+    case EncoderIsa::kSse42:
+      return encode_sse42;
+    case EncoderIsa::kAvx2:
+      return encode_avx2;
+    case EncoderIsa::kAvx512:
+      return encode_avx512;
+#endif
+    default:
+      return encode_scalar;
+  }
+}
+
+}  // namespace
+
+
+const char* encoder_isa_name(EncoderIsa isa) {
+  switch (isa) {
+    case EncoderIsa::kSse42:
+      return "sse4.2";
+    case EncoderIsa::kAvx2:
+      return "avx2";
+    case EncoderIsa::kAvx512:
+      return "avx512";
+    default:
+      return "scalar";
+  }
+}
+
+
+bool encoder_isa_supported(EncoderIsa isa) {
+#ifdef CONVERGE_ENCODER_X86
+  __builtin_cpu_init();
+  switch (isa) {
+    case EncoderIsa::kScalar:
+      return true;
+    case EncoderIsa::kSse42:
+      return __builtin_cpu_supports("sse4.2") &&
+             __builtin_cpu_supports("popcnt");
+    case EncoderIsa::kAvx2:
+      return __builtin_cpu_supports("avx2") &&
+             __builtin_cpu_supports("popcnt");
+    case EncoderIsa::kAvx512:
+      return __builtin_cpu_supports("avx512bw") &&
+             __builtin_cpu_supports("avx512vbmi") &&
+             __builtin_cpu_supports("avx512vbmi2");
+  }
+  return false;
+#else
+  return isa == EncoderIsa::kScalar;
+#endif
+}
+
+
+EncoderIsa best_encoder_isa() {
+  for (EncoderIsa isa: {EncoderIsa::kAvx512, EncoderIsa::kAvx2,
+                        EncoderIsa::kSse42}) {
+    if (encoder_isa_supported(isa)) {
+      return isa;
+    }
+  }
+  return EncoderIsa::kScalar;
+}
+
+
+size_t encode_residues(const char* src, size_t n, uint8_t* dst) {
+  static const EncodeFn best = encode_fn(best_encoder_isa());
+  return best(src, n, dst);
+}
+
+
+size_t encode_residues(EncoderIsa isa, const char* src, size_t n,
+  uint8_t* dst) {
+  if (!encoder_isa_supported(isa)) {
+    std::cerr << "encode_residues(): " << encoder_isa_name(isa)
+              << " is not supported on this CPU." << std::endl;
+    std::terminate();
+  }
+  return encode_fn(isa)(src, n, dst);
+}
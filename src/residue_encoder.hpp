@@ -0,0 +1,32 @@
+#ifndef CONVERGE_ENCODER_RESIDUE_ENCODER_HPP_
+#define CONVERGE_ENCODER_RESIDUE_ENCODER_HPP_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// Residue code i is the letter kAlphabet[i].
+constexpr std::array<char, 20> kAlphabet = {'A', 'C', 'D', 'E', 'F', 'G',
+                                            'H', 'I', 'K', 'L', 'M', 'N',
+                                            'P', 'Q', 'R', 'S', 'T', 'V',
+                                            'W', 'Y'};
+
+enum class EncoderIsa { kScalar, kSse42, kAvx2, kAvx512 };
+
+const char* encoder_isa_name(EncoderIsa isa);
+
+bool encoder_isa_supported(EncoderIsa isa);
+
+// Widest kernel the running CPU supports.
+EncoderIsa best_encoder_isa();
+
+// Maps every alphabet letter in src[0, n) to its residue code and compacts
+// the codes into dst, dropping newlines and any other byte. dst must have
+// room for n bytes. Returns the number of codes written.
+size_t encode_residues(const char* src, size_t n, uint8_t* dst);
+
+// Same as above with an explicit kernel; isa must be supported.
+size_t encode_residues(EncoderIsa isa, const char* src, size_t n,
+  uint8_t* dst);
+
+#endif  // CONVERGE_ENCODER_RESIDUE_ENCODER_HPP_
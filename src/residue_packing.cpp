@@ -0,0 +1,202 @@
+#include "residue_packing.hpp"
+
+#include <algorithm>
+#include <exception>
+#include <iostream>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CONVERGE_ENCODER_X86 1
+#include <immintrin.h>
+#endif
+
+
+namespace {
+
+constexpr uint64_t kCodeMask = 0x1F;
+constexpr size_t kGroupCodes = 8;
+constexpr size_t kGroupBytes = 5;
+
+
+// Packed bytes of the groups before code i; i is a multiple of 8.
+inline size_t group_offset(size_t i) {
+  return i / kGroupCodes * kGroupBytes;
+}
+
+
+void unpack_scalar(const uint8_t* packed, size_t n, uint8_t* codes) {
+  size_t i = 0;
+  for (; i + kGroupCodes <= n; i += kGroupCodes, packed += kGroupBytes) {
+    uint64_t word = 0;
+    for (size_t b = 0; b < kGroupBytes; b++) {
+      word |= static_cast<uint64_t>(packed[b]) << (8 * b);
+    }
+    for (size_t j = 0; j < kGroupCodes; j++) {
+      codes[i + j] = static_cast<uint8_t>((word >> (5 * j)) & kCodeMask);
+    }
+  }
+  if (i < n) {
+    uint64_t word = 0;
+    for (size_t b = 0; b < packed_size(n - i); b++) {
+      word |= static_cast<uint64_t>(packed[b]) << (8 * b);
+    }
+    for (; i < n; i++, word >>= 5) {
+      codes[i] = static_cast<uint8_t>(word & kCodeMask);
+    }
+  }
+}
+
+
+#ifdef CONVERGE_ENCODER_X86
+
+// The SSE and AVX2 kernels put code j of a group in a 16-bit lane holding
+// the two bytes its bits span, then shift it to the top of the lane with a
+// multiply (x86 has no per-lane 16-bit shift before AVX-512) and back down
+// by 11. Code j starts at bit 5j: byte 5j / 8, bit 5j % 8 within it.
+#define CONVERGE_ENCODER_GROUP_PAIRS(b) \
+  (b) + 0, (b) + 1, (b) + 0, (b) + 1, (b) + 1, (b) + 2, (b) + 1, (b) + 2, \
+  (b) + 2, (b) + 3, (b) + 3, (b) + 4, (b) + 3, (b) + 4, (b) + 4, (b) + 5
+#define CONVERGE_ENCODER_GROUP_SCALES \
+  2048, 64, 512, 16, 128, 1024, 32, 256
+
+__attribute__((target("sse4.2")))
+void unpack_sse42(const uint8_t* packed, size_t n, uint8_t* codes) {
+  const __m128i lo_pairs = _mm_setr_epi8(CONVERGE_ENCODER_GROUP_PAIRS(0));
+  const __m128i hi_pairs = _mm_setr_epi8(CONVERGE_ENCODER_GROUP_PAIRS(5));
+  const __m128i scales = _mm_setr_epi16(CONVERGE_ENCODER_GROUP_SCALES);
+  size_t bytes = packed_size(n);
+  size_t i = 0;
+  // 16 codes from 10 bytes per step, through a 16-byte load.
+  for (; i + 16 <= n && group_offset(i) + 16 <= bytes; i += 16) {
+    __m128i in = _mm_loadu_si128(
+      reinterpret_cast<const __m128i*>(packed + group_offset(i)));
+    __m128i lo = _mm_srli_epi16(
+      _mm_mullo_epi16(_mm_shuffle_epi8(in, lo_pairs), scales), 11);
+    __m128i hi = _mm_srli_epi16(
+      _mm_mullo_epi16(_mm_shuffle_epi8(in, hi_pairs), scales), 11);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(codes + i),
+                     _mm_packus_epi16(lo, hi));
+  }
+  unpack_scalar(packed + group_offset(i), n - i, codes + i);
+}
+
+
+__attribute__((target("avx2")))
+void unpack_avx2(const uint8_t* packed, size_t n, uint8_t* codes) {
+  const __m256i pairs = _mm256_setr_epi8(CONVERGE_ENCODER_GROUP_PAIRS(0),
+                                         CONVERGE_ENCODER_GROUP_PAIRS(5));
+  const __m256i scales = _mm256_setr_epi16(CONVERGE_ENCODER_GROUP_SCALES,
+                                           CONVERGE_ENCODER_GROUP_SCALES);
+  size_t bytes = packed_size(n);
+  size_t i = 0;
+  // 32 codes from 20 bytes per step, through 16-byte loads at 0 and 10.
+  for (; i + 32 <= n && group_offset(i) + 26 <= bytes; i += 32) {
+    const uint8_t* in = packed + group_offset(i);
+    __m256i first = _mm256_broadcastsi128_si256(
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(in)));
+    __m256i second = _mm256_broadcastsi128_si256(
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 10)));
+    first = _mm256_srli_epi16(
+      _mm256_mullo_epi16(_mm256_shuffle_epi8(first, pairs), scales), 11);
+    second = _mm256_srli_epi16(
+      _mm256_mullo_epi16(_mm256_shuffle_epi8(second, pairs), scales), 11);
+    // packus works per 128-bit lane: put the four 8-code groups in order.
+    __m256i out = _mm256_permute4x64_epi64(_mm256_packus_epi16(first, second),
+                                           _MM_SHUFFLE(3, 1, 2, 0));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(codes + i), out);
+  }
+  unpack_scalar(packed + group_offset(i), n - i, codes + i);
+}
+
+#undef CONVERGE_ENCODER_GROUP_PAIRS
+#undef CONVERGE_ENCODER_GROUP_SCALES
+
+
+// Byte p of the spread input is byte 5 * (p / 8) + p % 8 of the packed
+// group, so every qword holds one group; the top three bytes are unused.
+constexpr std::array<uint8_t, 64> make_spread_table() {
+  std::array<uint8_t, 64> table{};
+  for (int p=0;p<64;p++){
+    int byte = p % 8;
+    table[p] = static_cast<uint8_t>(5 * (p / 8) + (byte < 5 ? byte : 0));
+  }
+  return table;
+}
+
+alignas(64) constexpr std::array<uint8_t, 64> kSpreadTable =
+  make_spread_table();
+
+
+// VBMI's multishift pulls the 8 bits at 5j out of each qword in one go.
+__attribute__((target("avx512f,avx512bw,avx512vbmi")))
+void unpack_avx512(const uint8_t* packed, size_t n, uint8_t* codes) {
+  const __m512i spread = _mm512_load_si512(kSpreadTable.data());
+  const __m512i shifts = _mm512_set1_epi64(0x231E19140F0A0500);
+  const __m512i mask = _mm512_set1_epi8(static_cast<char>(kCodeMask));
+  size_t i = 0;
+  // 64 codes from 40 bytes per step.
+  for (; i + 64 <= n; i += 64) {
+    __m512i in = _mm512_maskz_loadu_epi8(0xFFFFFFFFFFull,
+                                         packed + group_offset(i));
+    // Zero-masked forms, as in residue_encoder.cpp, keep GCC 12 from
+    // flagging the unmasked ones' undefined pass-through vectors.
+    __m512i groups = _mm512_maskz_permutexvar_epi8(~__mmask64(0), spread, in);
+    __m512i out = _mm512_and_si512(
+      _mm512_maskz_multishift_epi64_epi8(~__mmask64(0), shifts, groups),
+      mask);
+    _mm512_storeu_si512(codes + i, out);
+  }
+  unpack_scalar(packed + group_offset(i), n - i, codes + i);
+}
+
+#endif  // CONVERGE_ENCODER_X86
+
+
+using UnpackFn = void (*)(const uint8_t*, size_t, uint8_t*);
+
+UnpackFn unpack_fn(EncoderIsa isa) {
+  switch (isa) {
+#ifdef CONVERGE_ENCODER_X86
+    case EncoderIsa::kSse42:
+      return unpack_sse42;
+    case EncoderIsa::kAvx2:
+      return unpack_avx2;
+    case EncoderIsa::kAvx512:
+      return unpack_avx512;
+#endif
+    default:
+      return unpack_scalar;
+  }
+}
+
+}  // namespace
+
+
+void pack_residues(const uint8_t* codes, size_t n, uint8_t* packed) {
+  for (size_t i = 0; i < n; i += kGroupCodes, packed += kGroupBytes) {
+    size_t count = std::min(kGroupCodes, n - i);
+    uint64_t word = 0;
+    for (size_t j = 0; j < count; j++) {
+      word |= (codes[i + j] & kCodeMask) << (5 * j);
+    }
+    for (size_t b = 0; b < packed_size(count); b++) {
+      packed[b] = static_cast<uint8_t>(word >> (8 * b));
+    }
+  }
+}
+
+
+void unpack_residues(const uint8_t* packed, size_t n, uint8_t* codes) {
+  static const UnpackFn best = unpack_fn(best_encoder_isa());
+  best(packed, n, codes);
+}
+
+
+void unpack_residues(EncoderIsa isa, const uint8_t* packed, size_t n,
+  uint8_t* codes) {
+  if (!encoder_isa_supported(isa)) {
+    std::cerr << "unpack_residues(): " << encoder_isa_name(isa)
+              << " is not supported on this CPU." << std::endl;
+    std::terminate();
+  }
+  unpack_fn(isa)(packed, n, codes);
+}
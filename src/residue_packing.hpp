@@ -0,0 +1,27 @@
+#ifndef CONVERGE_ENCODER_RESIDUE_PACKING_HPP_
+#define CONVERGE_ENCODER_RESIDUE_PACKING_HPP_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "residue_encoder.hpp"
+
+// 5-bit packing of residue codes: every group of 8 codes fills 5 bytes,
+// code j of a group in bits [5j, 5j + 5) of the little-endian 40-bit word.
+// A last partial group is zero padded to whole bytes.
+constexpr size_t packed_size(size_t residues) {
+  return (residues * 5 + 7) / 8;
+}
+
+// Packs codes[0, n) into packed, which needs packed_size(n) bytes.
+void pack_residues(const uint8_t* codes, size_t n, uint8_t* packed);
+
+// Unpacks n codes from packed into codes, on the widest kernel the running
+// CPU supports.
+void unpack_residues(const uint8_t* packed, size_t n, uint8_t* codes);
+
+// Same as above with an explicit kernel; isa must be supported.
+void unpack_residues(EncoderIsa isa, const uint8_t* packed, size_t n,
+  uint8_t* codes);
+
+#endif  // CONVERGE_ENCODER_RESIDUE_PACKING_HPP_
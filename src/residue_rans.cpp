@@ -0,0 +1,389 @@
+#include "residue_rans.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include "residue_encoder.hpp"
+#include "thread_pool.hpp"
+
+
+namespace {
+
+constexpr uint32_t kSymbols = kAlphabet.size();
+constexpr uint32_t kContexts = kSymbols * kSymbols;
+constexpr uint32_t kProbabilityBits = 12;
+constexpr uint32_t kProbabilityScale = 1u << kProbabilityBits;
+constexpr uint32_t kSlotMask = kProbabilityScale - 1;
+// Byte-wise renormalization keeps the state in [kRansLow, kRansLow << 8).
+constexpr uint32_t kRansLow = 1u << 23;
+// Blocks decoded side by side by one thread, to overlap their dependency
+// chains.
+constexpr size_t kLanes = 4;
+
+constexpr size_t kPrologueSize = 8 + 4 + 4;
+// Zero bytes after the last block, so that refills can read ahead.
+constexpr size_t kPaddingSize = 2;
+constexpr size_t kTableSize = kContexts * kSymbols * sizeof(uint16_t);
+
+
+// Context of the residue after prev2 and prev1; a block starts at context 0.
+inline uint32_t next_context(uint32_t context, uint32_t symbol) {
+  return context % kSymbols * kSymbols + symbol;
+}
+
+
+struct FrequencyTable {
+  uint16_t frequencies[kContexts][kSymbols] = {};
+  uint16_t starts[kContexts][kSymbols] = {};
+
+  // Fills in starts; false unless every context sums to 0 or to the scale.
+  bool accumulate() {
+    for (uint32_t c = 0; c < kContexts; c++) {
+      uint32_t sum = 0;
+      for (uint32_t s = 0; s < kSymbols; s++) {
+        starts[c][s] = static_cast<uint16_t>(sum);
+        sum += frequencies[c][s];
+      }
+      if (sum != 0 && sum != kProbabilityScale) {
+        return false;
+      }
+    }
+    return true;
+  }
+};
+
+
+// Scales the counts of each context to frequencies summing to the
+// probability scale, keeping every seen symbol at 1 or more.
+void normalize(const std::vector<uint64_t>& counts, FrequencyTable& table) {
+  for (uint32_t c = 0; c < kContexts; c++) {
+    const uint64_t* row = counts.data() + c * kSymbols;
+    uint64_t total = 0;
+    for (uint32_t s = 0; s < kSymbols; s++) {
+      total += row[s];
+    }
+    if (total == 0) {
+      continue;
+    }
+    uint16_t* frequencies = table.frequencies[c];
+    int64_t sum = 0;
+    uint32_t largest = 0;
+    for (uint32_t s = 0; s < kSymbols; s++) {
+      if (row[s] > 0) {
+        frequencies[s] = static_cast<uint16_t>(std::max<uint64_t>(
+          1, row[s] * kProbabilityScale / total));
+      }
+      sum += frequencies[s];
+      if (frequencies[s] > frequencies[largest]) {
+        largest = s;
+      }
+    }
+    // Rounding leaves the sum off by at most kSymbols, which the largest
+    // frequency (at least the scale / kSymbols) absorbs.
+    frequencies[largest] = static_cast<uint16_t>(
+      frequencies[largest] + (int64_t(kProbabilityScale) - sum));
+  }
+}
+
+
+// Codes one block back to front into out_end, returning where it starts.
+uint8_t* encode_block(const FrequencyTable& table, const uint8_t* codes,
+  size_t n, uint8_t* out_end) {
+  uint8_t* out = out_end;
+  uint32_t state = kRansLow;
+  for (size_t i = n; i-- > 0;) {
+    uint32_t context = (i >= 2 ? codes[i - 2] : 0) * kSymbols +
+                       (i >= 1 ? codes[i - 1] : 0);
+    uint32_t symbol = codes[i];
+    uint32_t frequency = table.frequencies[context][symbol];
+    uint32_t limit = ((kRansLow >> kProbabilityBits) << 8) * frequency;
+    while (state >= limit) {
+      *--out = static_cast<uint8_t>(state);
+      state >>= 8;
+    }
+    state = (state / frequency << kProbabilityBits) + state % frequency +
+            table.starts[context][symbol];
+  }
+  out -= 4;
+  for (int b = 0; b < 4; b++) {
+    out[b] = static_cast<uint8_t>(state >> (8 * b));
+  }
+  return out;
+}
+
+
+struct DecodeTable {
+  FrequencyTable frequencies;
+  // Symbol of each slot, per context.
+  uint8_t symbols[kContexts][kProbabilityScale] = {};
+};
+
+
+struct Lane {
+  uint32_t state = 0;
+  const uint8_t* in = nullptr;
+  const uint8_t* end = nullptr;
+  uint8_t* out = nullptr;
+  uint32_t context = 0;
+};
+
+
+bool start_lane(Lane& lane, const uint8_t* in, const uint8_t* end,
+  uint8_t* out) {
+  if (end - in < 4) {
+    return false;
+  }
+  lane.state = uint32_t(in[0]) | uint32_t(in[1]) << 8 |
+               uint32_t(in[2]) << 16 | uint32_t(in[3]) << 24;
+  lane.in = in + 4;
+  lane.end = end;
+  lane.out = out;
+  lane.context = 0;
+  return true;
+}
+
+
+// Decodes n codes in each of lanes[0, kCount) in lockstep. The lane state
+// is copied to locals because the code stores could otherwise alias it. A
+// lane that runs out of input stops advancing, and fails finish_lane().
+template <size_t kCount>
+void decode_lanes(const DecodeTable& table, Lane* lanes, size_t n) {
+  uint32_t state[kCount];
+  const uint8_t* in[kCount];
+  const uint8_t* end[kCount];
+  uint8_t* out[kCount];
+  uint32_t context[kCount];
+  uint32_t previous[kCount];
+  for (size_t l = 0; l < kCount; l++) {
+    state[l] = lanes[l].state;
+    in[l] = lanes[l].in;
+    end[l] = lanes[l].end;
+    out[l] = lanes[l].out;
+    context[l] = lanes[l].context;
+    previous[l] = lanes[l].context % kSymbols;
+  }
+  for (size_t i = 0; i < n; i++) {
+    for (size_t l = 0; l < kCount; l++) {
+      uint32_t slot = state[l] & kSlotMask;
+      uint32_t symbol = table.symbols[context[l]][slot];
+      state[l] = table.frequencies.frequencies[context[l]][symbol] *
+                 (state[l] >> kProbabilityBits) + slot -
+                 table.frequencies.starts[context[l]][symbol];
+      // Decoding leaves the state at or above kRansLow >> kProbabilityBits,
+      // so it takes at most two bytes to refill. They are read
+      // unconditionally and picked without branches, which would
+      // mispredict about every other residue; the payload is padded for
+      // the reads past the last block.
+      uint32_t next = uint32_t(in[l][0]) << 8 | in[l][1];
+      uint32_t refill = (state[l] < kRansLow) + (state[l] < kRansLow >> 8);
+      state[l] = state[l] << (8 * refill) | next >> (16 - 8 * refill);
+      in[l] = std::min(in[l] + refill, end[l]);
+      out[l][i] = static_cast<uint8_t>(symbol);
+      context[l] = previous[l] * kSymbols + symbol;
+      previous[l] = symbol;
+    }
+  }
+  for (size_t l = 0; l < kCount; l++) {
+    lanes[l].state = state[l];
+    lanes[l].in = in[l];
+    lanes[l].context = context[l];
+  }
+}
+
+
+// The encoder starts from kRansLow, so a block that decoded correctly ends
+// there with all of its input consumed.
+bool finish_lane(const Lane& lane) {
+  return lane.state == kRansLow && lane.in == lane.end;
+}
+
+
+[[noreturn]] void corrupt(const std::string& what) {
+  std::cerr << "Compressed residues " << what << std::endl;
+  std::terminate();
+}
+
+
+template <class T>
+T read_field(const uint8_t* p) {
+  T value;
+  memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+}  // namespace
+
+
+std::vector<uint8_t> compress_residues(const uint8_t* codes, size_t n,
+  size_t num_threads) {
+  std::vector<uint64_t> counts(kContexts * kSymbols);
+  for (size_t first = 0; first < n; first += kRansBlockResidues) {
+    size_t last = std::min(n, first + kRansBlockResidues);
+    uint32_t context = 0;
+    for (size_t i = first; i < last; i++) {
+      if (codes[i] >= kSymbols) {
+        std::cerr << "Residue code " << int(codes[i]) << " at " << i
+                  << " is outside the alphabet" << std::endl;
+        std::terminate();
+      }
+      counts[context * kSymbols + codes[i]]++;
+      context = next_context(context, codes[i]);
+    }
+  }
+  auto table = std::make_unique<FrequencyTable>();
+  normalize(counts, *table);
+  table->accumulate();
+
+  size_t num_blocks = (n + kRansBlockResidues - 1) / kRansBlockResidues;
+  auto encode = [&table, codes, n](size_t block) {
+    size_t first = block * kRansBlockResidues;
+    size_t count = std::min(n - first, kRansBlockResidues);
+    // At most kProbabilityBits per residue, plus the final state.
+    std::vector<uint8_t> buffer(count * 2 + 4);
+    uint8_t* start = encode_block(*table, codes + first, count,
+                                  buffer.data() + buffer.size());
+    buffer.erase(buffer.begin(), buffer.begin() + (start - buffer.data()));
+    return buffer;
+  };
+  std::vector<std::vector<uint8_t>> blocks(num_blocks);
+  if (num_blocks <= 1) {
+    for (size_t b = 0; b < num_blocks; b++) {
+      blocks[b] = encode(b);
+    }
+  } else {
+    ThreadPool pool(num_threads, num_blocks);
+    std::vector<std::future<std::vector<uint8_t>>> encoded;
+    for (size_t b = 0; b < num_blocks; b++) {
+      encoded.push_back(pool.submit([&encode, b]() { return encode(b); }));
+    }
+    for (size_t b = 0; b < num_blocks; b++) {
+      blocks[b] = encoded[b].get();
+    }
+  }
+
+  std::vector<uint8_t> compressed(kPrologueSize + kTableSize +
+                                  num_blocks * sizeof(uint64_t));
+  uint64_t residues = n;
+  uint32_t block_residues = kRansBlockResidues;
+  uint32_t probability_bits = kProbabilityBits;
+  memcpy(compressed.data(), &residues, 8);
+  memcpy(compressed.data() + 8, &block_residues, 4);
+  memcpy(compressed.data() + 12, &probability_bits, 4);
+  memcpy(compressed.data() + kPrologueSize, table->frequencies, kTableSize);
+  uint64_t end = 0;
+  for (size_t b = 0; b < num_blocks; b++) {
+    end += blocks[b].size();
+    memcpy(compressed.data() + kPrologueSize + kTableSize + b * 8, &end, 8);
+  }
+  compressed.reserve(compressed.size() + end + kPaddingSize);
+  for (const std::vector<uint8_t>& block: blocks) {
+    compressed.insert(compressed.end(), block.begin(), block.end());
+  }
+  compressed.resize(compressed.size() + kPaddingSize);
+  return compressed;
+}
+
+
+void decompress_residues(const uint8_t* compressed, size_t size, size_t n,
+  uint8_t* codes, size_t num_threads) {
+  if (size < kPrologueSize + kTableSize) {
+    corrupt("are truncated");
+  }
+  if (read_field<uint64_t>(compressed) != n) {
+    corrupt("hold " + std::to_string(read_field<uint64_t>(compressed)) +
+            " residues, not " + std::to_string(n));
+  }
+  if (read_field<uint32_t>(compressed + 8) != kRansBlockResidues ||
+      read_field<uint32_t>(compressed + 12) != kProbabilityBits) {
+    corrupt("use unsupported block size or probability bits");
+  }
+  auto table = std::make_unique<DecodeTable>();
+  memcpy(table->frequencies.frequencies, compressed + kPrologueSize,
+         kTableSize);
+  if (!table->frequencies.accumulate()) {
+    corrupt("have a corrupt frequency table");
+  }
+  for (uint32_t c = 0; c < kContexts; c++) {
+    for (uint32_t s = 0; s < kSymbols; s++) {
+      memset(table->symbols[c] + table->frequencies.starts[c][s], int(s),
+             table->frequencies.frequencies[c][s]);
+    }
+  }
+
+  size_t num_blocks = (n + kRansBlockResidues - 1) / kRansBlockResidues;
+  const uint8_t* block_ends = compressed + kPrologueSize + kTableSize;
+  size_t payload_offset = kPrologueSize + kTableSize + num_blocks * 8;
+  if (size < payload_offset + kPaddingSize) {
+    corrupt("are truncated");
+  }
+  const uint8_t* payload = compressed + payload_offset;
+  std::vector<const uint8_t*> bounds = {payload};
+  for (size_t b = 0; b < num_blocks; b++) {
+    uint64_t end = read_field<uint64_t>(block_ends + b * 8);
+    if (end < static_cast<uint64_t>(bounds.back() - payload) ||
+        end > size - payload_offset - kPaddingSize) {
+      corrupt("have a corrupt block directory");
+    }
+    bounds.push_back(payload + end);
+  }
+  if (bounds.back() + kPaddingSize != compressed + size) {
+    corrupt("have trailing bytes");
+  }
+
+  // Decodes blocks [first, first + count), all full size if count > 1.
+  auto decode = [&table, &bounds, codes, n](size_t first, size_t count) {
+    Lane lanes[kLanes];
+    for (size_t l = 0; l < count; l++) {
+      size_t b = first + l;
+      if (!start_lane(lanes[l], bounds[b], bounds[b + 1],
+                      codes + b * kRansBlockResidues)) {
+        return false;
+      }
+    }
+    size_t length = std::min(n - first * kRansBlockResidues,
+                             kRansBlockResidues);
+    if (count == kLanes) {
+      decode_lanes<kLanes>(*table, lanes, length);
+    } else {
+      for (size_t l = 0; l < count; l++) {
+        decode_lanes<1>(*table, lanes + l, length);
+      }
+    }
+    return std::all_of(lanes, lanes + count, finish_lane);
+  };
+  // Groups of kLanes full blocks, then the rest one by one.
+  std::vector<std::pair<size_t, size_t>> groups;
+  size_t full_blocks = n / kRansBlockResidues;
+  size_t b = 0;
+  for (; b + kLanes <= full_blocks; b += kLanes) {
+    groups.emplace_back(b, kLanes);
+  }
+  for (; b < num_blocks; b++) {
+    groups.emplace_back(b, 1);
+  }
+  bool intact = true;
+  if (groups.size() <= 1) {
+    for (const auto& group: groups) {
+      intact = decode(group.first, group.second);
+    }
+  } else {
+    ThreadPool pool(num_threads, groups.size());
+    std::vector<std::future<bool>> decoded;
+    for (const auto& group: groups) {
+      decoded.push_back(pool.submit([&decode, group]() {
+        return decode(group.first, group.second);
+      }));
+    }
+    for (std::future<bool>& result: decoded) {
+      intact = result.get() && intact;
+    }
+  }
+  if (!intact) {
+    corrupt("do not decode to what was stored");
+  }
+}
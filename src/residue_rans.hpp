@@ -0,0 +1,37 @@
+#ifndef CONVERGE_ENCODER_RESIDUE_RANS_HPP_
+#define CONVERGE_ENCODER_RESIDUE_RANS_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Entropy coding of residue codes: rANS with an order-2 context model, one
+// frequency table over the alphabet for each pair of preceding residues.
+// The codes are cut into blocks of block_residues that are coded
+// independently, the context starting over at each block, so that blocks
+// decode in parallel. All blocks share the frequency tables, which are
+// stored up front:
+//
+//   uint64_t residues
+//   uint32_t block_residues
+//   uint32_t probability_bits
+//   uint16_t frequencies[contexts][kAlphabet.size()]
+//   uint64_t block_ends[blocks]      end of each block in the payload
+//   payload
+//
+// The tables cost about 16 KB, so this pays off for proteomes, not for a
+// handful of sequences.
+constexpr size_t kRansBlockResidues = size_t(1) << 16;
+
+// Compresses codes[0, n); every code must be below kAlphabet.size().
+// Blocks are coded on num_threads threads, 0 for every hardware thread.
+std::vector<uint8_t> compress_residues(const uint8_t* codes, size_t n,
+  size_t num_threads = 0);
+
+// Decodes the n codes of compressed[0, size) into codes on num_threads
+// threads, 0 for every hardware thread. Terminates if the data is not a
+// well-formed stream of n codes.
+void decompress_residues(const uint8_t* compressed, size_t size, size_t n,
+  uint8_t* codes, size_t num_threads = 0);
+
+#endif  // CONVERGE_ENCODER_RESIDUE_RANS_HPP_
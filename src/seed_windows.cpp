@@ -0,0 +1,175 @@
+#include "seed_windows.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <utility>
+
+namespace {
+
+// With Length known at compile time each window is a couple of vector
+// moves instead of a call to memcpy.
+template <size_t Length>
+void copy_windows(const Residue* seq, size_t size, size_t stride,
+  size_t count, Residue* out) {
+  for (size_t i = 0; i + 1 < count; i++, out += Length) {
+    memcpy(out, seq + i * stride, Length);
+  }
+  memcpy(out, seq + size - Length, Length);
+}
+
+
+void copy_windows(const Residue* seq, size_t size, size_t length,
+  size_t stride, size_t count, Residue* out) {
+  for (size_t i = 0; i + 1 < count; i++, out += length) {
+    memcpy(out, seq + i * stride, length);
+  }
+  memcpy(out, seq + size - length, length);
+}
+
+}  // namespace
+
+
+size_t count_windows(size_t sequence_length, const SeedWindowing& windowing) {
+  if (windowing.length == 0 || sequence_length < windowing.length) {
+    return 0;
+  }
+  return (sequence_length - windowing.length) / windowing.stride + 1;
+}
+
+
+bool split_windows(ResidueSpan seq, const SeedWindowing& windowing,
+  SequenceStore& seeds) {
+  size_t count = count_windows(seq.size, windowing);
+  if (count == 0) {
+    return false;
+  }
+  size_t stride = windowing.stride;
+  Residue* out = seeds.append_fixed(count, windowing.length);
+  switch (windowing.length) {
+    case 8: copy_windows<8>(seq.data, seq.size, stride, count, out); break;
+    case 12: copy_windows<12>(seq.data, seq.size, stride, count, out); break;
+    case 16: copy_windows<16>(seq.data, seq.size, stride, count, out); break;
+    case 20: copy_windows<20>(seq.data, seq.size, stride, count, out); break;
+    case 30: copy_windows<30>(seq.data, seq.size, stride, count, out); break;
+    case 40: copy_windows<40>(seq.data, seq.size, stride, count, out); break;
+    default:
+      copy_windows(seq.data, seq.size, windowing.length, stride, count, out);
+  }
+  return true;
+}
+
+
+std::string seed_set_label(const SeedWindowing& windowing) {
+  return "w" + std::to_string(windowing.length) + "s" +
+         std::to_string(windowing.stride);
+}
+
+
+SequenceStore SeedSetView::materialize() const {
+  SequenceStore seeds;
+  seeds.reserve(size(), size() * windowing().length);
+  for (size_t i = 0; i < sources_->size(); i++) {
+    split_windows((*sources_)[i], windowing(), seeds);
+  }
+  return seeds;
+}
+
+
+SeedSets::SeedSets(SequenceStore sources,
+  const std::vector<SeedWindowing>& windowings)
+  : sources_(std::move(sources)) {
+  constexpr uint64_t kMaxPosition = std::numeric_limits<uint32_t>::max();
+  if (sources_.size() > kMaxPosition) {
+    std::cerr << "SeedSets has " << sources_.size() << " seed sequences, "
+                 "more than a window can refer to." << std::endl;
+    std::terminate();
+  }
+  for (const SeedWindowing& windowing: windowings) {
+    if (std::any_of(sets_.begin(), sets_.end(), [&](const SeedSet& set) {
+          return set.windowing.length == windowing.length &&
+                 set.windowing.stride == windowing.stride;
+        })) {
+      std::cerr << "SeedSets asked for window set "
+                << seed_set_label(windowing) << " twice." << std::endl;
+      std::terminate();
+    }
+    size_t count = 0;
+    for (size_t i = 0; i < sources_.size(); i++) {
+      count += count_windows(sources_[i].size, windowing);
+    }
+    sets_.push_back({windowing, {}});
+    sets_.back().windows.reserve(count);
+  }
+  // Every set takes its windows from a sequence while it is in cache.
+  for (size_t i = 0; i < sources_.size(); i++) {
+    size_t size = sources_[i].size;
+    auto source = static_cast<uint32_t>(i);
+    for (SeedSet& set: sets_) {
+      size_t windows = count_windows(size, set.windowing);
+      if (windows == 0) {
+        continue;
+      }
+      if (size - set.windowing.length > kMaxPosition) {
+        std::cerr << "SeedSets has a seed sequence of " << size
+                  << " residues, longer than a window can refer to."
+                  << std::endl;
+        std::terminate();
+      }
+      for (size_t w = 0; w + 1 < windows; w++) {
+        auto start = static_cast<uint32_t>(w * set.windowing.stride);
+        set.windows.push_back({source, start});
+      }
+      auto last = static_cast<uint32_t>(size - set.windowing.length);
+      set.windows.push_back({source, last});
+    }
+  }
+}
+
+
+size_t SeedSets::window_count() const {
+  size_t count = 0;
+  for (const SeedSet& set: sets_) {
+    count += set.windows.size();
+  }
+  return count;
+}
+
+
+void SeedSets::check_windows() const {
+  for (size_t k = 0; k < sets_.size(); k++) {
+    const SeedSet& set = sets_[k];
+    for (size_t i = 0; i < set.windows.size(); i++) {
+      const SeedWindow& window = set.windows[i];
+      if (window.source >= sources_.size() ||
+          window.start + set.windowing.length >
+            sources_[window.source].size) {
+        std::cerr << "SeedSets archive has window " << i << " of set " << k
+                  << " outside the seed sequences" << std::endl;
+        std::terminate();
+      }
+    }
+  }
+}
+
+
+bool SeedSets::operator==(const SeedSets& other) const {
+  if (!(sources_ == other.sources_) || sets_.size() != other.sets_.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < sets_.size(); i++) {
+    const SeedSet& set = sets_[i];
+    const SeedSet& other_set = other.sets_[i];
+    if (set.windowing.length != other_set.windowing.length ||
+        set.windowing.stride != other_set.windowing.stride ||
+        set.windows.size() != other_set.windows.size() ||
+        memcmp(set.windows.data(), other_set.windows.data(),
+               set.windows.size() * sizeof(SeedWindow)) != 0) {
+      return false;
+    }
+  }
+  return true;
+}
@@ -0,0 +1,160 @@
+#ifndef CONVERGE_ENCODER_SEED_WINDOWS_HPP_
+#define CONVERGE_ENCODER_SEED_WINDOWS_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <cereal/cereal.hpp>
+
+#include "converge_encoder/container_format.hpp"
+#include "sequence_store.hpp"
+
+// Seeds are windows of length residues cut from each seed sequence, one
+// starting every stride residues while a whole window fits, plus one
+// ending at the last residue.
+struct SeedWindowing {
+  size_t length = 30;
+  size_t stride = 10;
+};
+
+// Number of windows seq yields, 0 if it is shorter than one window.
+size_t count_windows(size_t sequence_length, const SeedWindowing& windowing);
+
+// Appends the windows of seq to seeds; false, appending nothing, if seq is
+// shorter than one window. Lengths 8, 12, 16, 20, 30 and 40 copy with
+// fixed-size moves; others take a generic loop.
+bool split_windows(ResidueSpan seq, const SeedWindowing& windowing,
+  SequenceStore& seeds);
+
+
+// Label of the window set cut with windowing, e.g. "w30s10".
+std::string seed_set_label(const SeedWindowing& windowing);
+
+
+// One window set: where each window starts in the seed sequences.
+struct SeedSet {
+  SeedWindowing windowing;
+  std::vector<SeedWindow> windows;
+};
+
+
+// The windows of one SeedSet over the seed sequences they were cut from,
+// without copying them. Valid as long as the SeedSets it came from.
+class SeedSetView {
+ public:
+  SeedSetView(const SequenceStore& sources, const SeedSet& set)
+    : sources_(&sources), set_(&set) {}
+
+  size_t size() const { return set_->windows.size(); }
+  const SeedWindowing& windowing() const { return set_->windowing; }
+  std::string label() const { return seed_set_label(set_->windowing); }
+  ResidueSpan operator[](size_t i) const {
+    const SeedWindow& window = set_->windows[i];
+    return {(*sources_)[window.source].data + window.start,
+            set_->windowing.length};
+  }
+
+  const SequenceStore& sources() const { return *sources_; }
+  const std::vector<SeedWindow>& windows() const { return set_->windows; }
+  // Every window copied into a store of its own, as seeds used to be kept.
+  SequenceStore materialize() const;
+
+ private:
+  const SequenceStore* sources_;
+  const SeedSet* set_;
+};
+
+
+// Archive format of SeedSets, written as its cereal class version:
+//   1: one window set: window length and stride, the seed sequences as a
+//      SequenceStore, then the windows as one block of SeedWindow pairs
+//      (read only)
+//   2: the seed sequences as a SequenceStore, the number of window sets,
+//      then each set's window length, stride and block of windows
+constexpr uint32_t kSeedSetsVersion = 2;
+
+// The seed sequences, kept once, and the window sets cut from them: a
+// window is a span into its sequence rather than a copy.
+class SeedSets {
+ public:
+  SeedSets() = default;
+  // Cuts the windows of every windowing, which must differ, from every
+  // sequence of sources that is at least one window long, in one pass
+  // over sources.
+  SeedSets(SequenceStore sources,
+           const std::vector<SeedWindowing>& windowings);
+
+  size_t size() const { return sets_.size(); }
+  SeedSetView operator[](size_t i) const {
+    return SeedSetView(sources_, sets_[i]);
+  }
+  const SequenceStore& sources() const { return sources_; }
+  // Total windows over all sets.
+  size_t window_count() const;
+
+  bool operator==(const SeedSets& other) const;
+
+  template <class Archive>
+  void save(Archive& archive, const uint32_t /*version*/) const {
+    archive(sources_, static_cast<uint64_t>(sets_.size()));
+    for (const SeedSet& set: sets_) {
+      archive(static_cast<uint64_t>(set.windowing.length),
+              static_cast<uint64_t>(set.windowing.stride));
+      save_windows(archive, set.windows);
+    }
+  }
+
+  template <class Archive>
+  void load(Archive& archive, const uint32_t version) {
+    uint64_t set_count = 1;
+    if (version >= 2) {
+      archive(sources_, set_count);
+    }
+    sets_.resize(static_cast<size_t>(set_count));
+    for (SeedSet& set: sets_) {
+      uint64_t length;
+      uint64_t stride;
+      archive(length, stride);
+      set.windowing = {static_cast<size_t>(length),
+                       static_cast<size_t>(stride)};
+      if (version < 2) {
+        archive(sources_);
+      }
+      load_windows(archive, set.windows);
+    }
+    check_windows();
+  }
+
+ private:
+  // Every window must lie inside its seed sequence, so that views of a
+  // damaged archive cannot read past the residues; terminates otherwise.
+  void check_windows() const;
+
+  template <class Archive>
+  static void save_windows(Archive& archive,
+                           const std::vector<SeedWindow>& windows) {
+    archive(cereal::make_size_tag(
+      static_cast<cereal::size_type>(windows.size())));
+    archive(cereal::binary_data(windows.data(),
+                                windows.size() * sizeof(SeedWindow)));
+  }
+
+  template <class Archive>
+  static void load_windows(Archive& archive,
+                           std::vector<SeedWindow>& windows) {
+    cereal::size_type count;
+    archive(cereal::make_size_tag(count));
+    windows.resize(static_cast<size_t>(count));
+    archive(cereal::binary_data(windows.data(),
+                                windows.size() * sizeof(SeedWindow)));
+  }
+
+  SequenceStore sources_;
+  std::vector<SeedSet> sets_;
+};
+
+CEREAL_CLASS_VERSION(SeedSets, kSeedSetsVersion)
+
+#endif  // CONVERGE_ENCODER_SEED_WINDOWS_HPP_
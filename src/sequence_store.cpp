@@ -0,0 +1,112 @@
+#include "sequence_store.hpp"
+
+#include <algorithm>
+#include <exception>
+#include <iostream>
+#include <utility>
+
+#include "residue_encoder.hpp"
+
+
+void SequenceStore::append(const SequenceStore& other) {
+  uint64_t base = residues_.size();
+  residues_.insert(residues_.end(), other.residues_.begin(),
+                   other.residues_.end());
+  offsets_.reserve(offsets_.size() + other.size());
+  for (size_t i = 1; i < other.offsets_.size(); i++) {
+    offsets_.push_back(base + other.offsets_[i]);
+  }
+}
+
+
+Residue* SequenceStore::append_fixed(size_t count, size_t length) {
+  uint64_t base = residues_.size();
+  residues_.resize(base + count * length);
+  size_t first = offsets_.size();
+  offsets_.resize(first + count);
+  for (size_t i = 0; i < count; i++) {
+    offsets_[first + i] = base + (i + 1) * length;
+  }
+  return residues_.data() + base;
+}
+
+
+void SequenceStore::compact(const std::vector<bool>& keep) {
+  // Kept sequences only ever move towards the front, so copying in order
+  // never overwrites residues that are still to be read.
+  uint64_t write = 0;
+  size_t kept = 0;
+  uint64_t begin = offsets_[0];
+  for (size_t i = 0; i < keep.size(); i++) {
+    uint64_t end = offsets_[i + 1];
+    if (keep[i]) {
+      std::copy(residues_.begin() + begin, residues_.begin() + end,
+                residues_.begin() + write);
+      write += end - begin;
+      offsets_[++kept] = write;
+    }
+    begin = end;
+  }
+  offsets_.resize(kept + 1);
+  residues_.resize(write);
+  shrink_to_fit();
+}
+
+
+SequenceStore SequenceStore::slice(size_t first, size_t count) const {
+  SequenceStore sliced;
+  uint64_t begin = offsets_[first];
+  uint64_t end = offsets_[first + count];
+  sliced.residues_.assign(residues_.begin() + begin, residues_.begin() + end);
+  sliced.offsets_.reserve(count + 1);
+  for (size_t i = 1; i <= count; i++) {
+    sliced.offsets_.push_back(offsets_[first + i] - begin);
+  }
+  sliced.encoding_ = encoding_;
+  sliced.num_threads_ = num_threads_;
+  return sliced;
+}
+
+
+void SequenceStore::reserve(size_t sequences, size_t residues) {
+  offsets_.reserve(sequences + 1);
+  residues_.reserve(residues);
+}
+
+
+void SequenceStore::shrink_to_fit() {
+  offsets_.shrink_to_fit();
+  residues_.shrink_to_fit();
+}
+
+
+void SequenceStore::append_codes(const int32_t* codes, size_t n) {
+  size_t base = residues_.size();
+  residues_.resize(base + n);
+  for (size_t i = 0; i < n; i++) {
+    if (codes[i] < 0 || static_cast<size_t>(codes[i]) >= kAlphabet.size()) {
+      std::cerr << "SequenceStore legacy archive has residue code "
+                << codes[i] << std::endl;
+      std::terminate();
+    }
+    residues_[base + i] = static_cast<Residue>(codes[i]);
+  }
+}
+
+
+void SequenceStore::set_offsets(std::vector<uint64_t> offsets) {
+  offsets_ = std::move(offsets);
+  check_offsets(residues_.size());
+}
+
+
+void SequenceStore::check_offsets(uint64_t residues) const {
+  bool valid = !offsets_.empty() && offsets_.front() == 0 &&
+               offsets_.back() == residues &&
+               std::is_sorted(offsets_.begin(), offsets_.end());
+  if (!valid) {
+    std::cerr << "SequenceStore archive has offsets that do not cover its "
+              << residues << " residues" << std::endl;
+    std::terminate();
+  }
+}
@@ -0,0 +1,205 @@
+#ifndef CONVERGE_ENCODER_SEQUENCE_STORE_HPP_
+#define CONVERGE_ENCODER_SEQUENCE_STORE_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <utility>
+#include <vector>
+
+#include <cereal/cereal.hpp>
+#include <cereal/types/vector.hpp>
+
+#include "residue_packing.hpp"
+#include "residue_rans.hpp"
+
+// Residue codes are 0-19 (see kAlphabet), one byte each.
+using Residue = uint8_t;
+
+// Archive format of SequenceStore, written as its cereal class version:
+//   1: offsets, then residues as uint8_t (read only)
+//   2: a ResidueEncoding byte, then offsets and residues in that encoding
+// Archives from before the class version are read with load_legacy().
+constexpr uint32_t kSequenceStoreVersion = 2;
+
+// Layouts sequences were archived in before SequenceStore had a class
+// version. Nothing in the archive tells them apart from each other or from
+// a versioned one, so the caller has to say which it holds.
+enum class LegacyLayout {
+  // std::vector<std::vector<int>>, one vector per sequence.
+  kNested,
+  // Offsets as std::vector<uint64_t>, then residues as std::vector<int>.
+  kFlat,
+};
+
+// How an archive stores the residue array. In memory it is always one byte
+// per residue.
+enum class ResidueEncoding : uint8_t {
+  kBytes = 0,
+  // 5 bits per residue, see residue_packing.hpp.
+  kPacked = 1,
+  // Order-2 context-modelled rANS in independent blocks, see
+  // residue_rans.hpp.
+  kRans = 2,
+};
+
+// Read-only view of one sequence's residues.
+struct ResidueSpan {
+  const Residue* data = nullptr;
+  size_t size = 0;
+
+  const Residue* begin() const { return data; }
+  const Residue* end() const { return data + size; }
+  Residue operator[](size_t i) const { return data[i]; }
+};
+
+
+// Sequences stored back to back in one residue array (CSR layout):
+// sequence i is residues[offsets[i], offsets[i + 1]). Serializes as two
+// bulk blocks, offsets first.
+class SequenceStore {
+ public:
+  SequenceStore() : offsets_{0} {}
+
+  size_t size() const { return offsets_.size() - 1; }
+  size_t total_residues() const { return residues_.size(); }
+  ResidueSpan operator[](size_t i) const {
+    return {residues_.data() + offsets_[i],
+            static_cast<size_t>(offsets_[i + 1] - offsets_[i])};
+  }
+
+  // Adds residues to the sequence under construction; end_sequence()
+  // closes it.
+  void append_residues(const Residue* first, size_t n) {
+    residues_.insert(residues_.end(), first, first + n);
+  }
+  void end_sequence() { offsets_.push_back(residues_.size()); }
+  void push_back(const Residue* first, size_t n) {
+    append_residues(first, n);
+    end_sequence();
+  }
+  void push_back(ResidueSpan seq) { push_back(seq.data, seq.size); }
+  // Adds count sequences of length residues each and returns where their
+  // residues go, back to back, for the caller to fill.
+  Residue* append_fixed(size_t count, size_t length);
+
+  // Appends every sequence of other, in order.
+  void append(const SequenceStore& other);
+  // Keeps only the sequences whose keep flag is set, in order, in place.
+  void compact(const std::vector<bool>& keep);
+  // Copy of sequences [first, first + count), with the same encoding and
+  // threads.
+  SequenceStore slice(size_t first, size_t count) const;
+  void reserve(size_t sequences, size_t residues);
+  void shrink_to_fit();
+
+  // Encoding used when the store is saved; loading sets it to the
+  // archive's.
+  ResidueEncoding encoding() const { return encoding_; }
+  void set_encoding(ResidueEncoding encoding) { encoding_ = encoding; }
+  // Threads rANS coding uses when the store is saved or loaded, 0 (the
+  // default) for every hardware thread.
+  size_t num_threads() const { return num_threads_; }
+  void set_num_threads(size_t num_threads) { num_threads_ = num_threads; }
+
+  const std::vector<uint64_t>& offsets() const { return offsets_; }
+  const std::vector<Residue>& residues() const { return residues_; }
+
+  bool operator==(const SequenceStore& other) const {
+    return offsets_ == other.offsets_ && residues_ == other.residues_;
+  }
+
+  template <class Archive>
+  void save(Archive& archive, const uint32_t /*version*/) const {
+    archive(static_cast<uint8_t>(encoding_), offsets_);
+    if (encoding_ == ResidueEncoding::kBytes) {
+      archive(residues_);
+    } else if (encoding_ == ResidueEncoding::kPacked) {
+      std::vector<uint8_t> packed(packed_size(residues_.size()));
+      pack_residues(residues_.data(), residues_.size(), packed.data());
+      archive(packed);
+    } else {
+      archive(compress_residues(residues_.data(), residues_.size(),
+                                num_threads_));
+    }
+  }
+
+  template <class Archive>
+  void load(Archive& archive, const uint32_t version) {
+    encoding_ = ResidueEncoding::kBytes;
+    if (version >= 2) {
+      uint8_t encoding;
+      archive(encoding);
+      encoding_ = static_cast<ResidueEncoding>(encoding);
+    }
+    archive(offsets_);
+    if (encoding_ == ResidueEncoding::kBytes) {
+      archive(residues_);
+      check_offsets(residues_.size());
+    } else if (encoding_ == ResidueEncoding::kPacked) {
+      std::vector<uint8_t> packed;
+      archive(packed);
+      check_offsets(offsets_.empty() ? 0 : offsets_.back());
+      if (packed.size() < packed_size(offsets_.back())) {
+        std::cerr << "SequenceStore archive has " << packed.size()
+                  << " packed bytes for " << offsets_.back() << " residues"
+                  << std::endl;
+        std::terminate();
+      }
+      residues_.resize(offsets_.back());
+      unpack_residues(packed.data(), residues_.size(), residues_.data());
+    } else if (encoding_ == ResidueEncoding::kRans) {
+      std::vector<uint8_t> compressed;
+      archive(compressed);
+      check_offsets(offsets_.empty() ? 0 : offsets_.back());
+      residues_.resize(offsets_.back());
+      decompress_residues(compressed.data(), compressed.size(),
+                          residues_.size(), residues_.data(), num_threads_);
+    } else {
+      std::cerr << "SequenceStore archive has unknown residue encoding "
+                << int(encoding_) << std::endl;
+      std::terminate();
+    }
+  }
+
+  // Reads sequences archived in layout, in place of load().
+  template <class Archive>
+  void load_legacy(Archive& archive, LegacyLayout layout) {
+    encoding_ = ResidueEncoding::kBytes;
+    offsets_.assign(1, 0);
+    residues_.clear();
+    if (layout == LegacyLayout::kNested) {
+      std::vector<std::vector<int32_t>> nested;
+      archive(nested);
+      for (const std::vector<int32_t>& codes: nested) {
+        append_codes(codes.data(), codes.size());
+        end_sequence();
+      }
+    } else {
+      std::vector<uint64_t> offsets;
+      std::vector<int32_t> codes;
+      archive(offsets, codes);
+      append_codes(codes.data(), codes.size());
+      set_offsets(std::move(offsets));
+    }
+  }
+
+ private:
+  // Appends legacy int residue codes, each of which must be a Residue.
+  void append_codes(const int32_t* codes, size_t n);
+  // Replaces offsets_ after checking they cover residues_ in order.
+  void set_offsets(std::vector<uint64_t> offsets);
+  // Ends the program unless offsets_ start at 0, never decrease and end at
+  // residues.
+  void check_offsets(uint64_t residues) const;
+
+  std::vector<uint64_t> offsets_;
+  std::vector<Residue> residues_;
+  ResidueEncoding encoding_ = ResidueEncoding::kBytes;
+  size_t num_threads_ = 0;
+};
+
+CEREAL_CLASS_VERSION(SequenceStore, kSequenceStoreVersion)
+
+#endif  // CONVERGE_ENCODER_SEQUENCE_STORE_HPP_
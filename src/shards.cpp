@@ -0,0 +1,79 @@
+#include "shards.hpp"
+
+#include <algorithm>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+
+std::vector<ShardRange> partition_by_residues(
+  const SequenceStore& sequences, size_t num_shards) {
+  const std::vector<uint64_t>& offsets = sequences.offsets();
+  uint64_t total = sequences.total_residues();
+  std::vector<size_t> cuts = {0};
+  for (size_t k = 1; k < num_shards; k++) {
+    uint64_t target = static_cast<uint64_t>(
+      static_cast<long double>(total) * k / num_shards);
+    // First sequence boundary at or past the target, or the one before it
+    // if that is closer.
+    size_t cut = std::lower_bound(offsets.begin(), offsets.end(), target) -
+                 offsets.begin();
+    if (cut > 0 && target - offsets[cut - 1] < offsets[cut] - target) {
+      cut--;
+    }
+    cuts.push_back(std::max(cut, cuts.back()));
+  }
+  cuts.push_back(sequences.size());
+
+  std::vector<ShardRange> shards;
+  for (size_t k = 0; k < num_shards; k++) {
+    ShardRange shard;
+    shard.first = cuts[k];
+    shard.count = cuts[k + 1] - cuts[k];
+    shard.residues = offsets[cuts[k + 1]] - offsets[cuts[k]];
+    shards.push_back(shard);
+  }
+  return shards;
+}
+
+
+void write_shard_manifest(const std::string& filename,
+  const std::vector<ShardRange>& shards) {
+  std::ofstream file(filename);
+  if (!file.is_open()) {
+    std::cout << "File " << filename << " failed to open" << std::endl;
+    std::terminate();
+  }
+  for (const ShardRange& shard: shards) {
+    file << shard.file << '\t' << shard.first << '\t' << shard.count << '\t'
+         << shard.residues << '\n';
+  }
+}
+
+
+std::vector<ShardRange> read_shard_manifest(const std::string& filename) {
+  std::ifstream file(filename);
+  if (!file.is_open()) {
+    std::cout << "File " << filename << " failed to open" << std::endl;
+    std::terminate();
+  }
+  std::vector<ShardRange> shards;
+  std::string line;
+  while (std::getline(file, line)) {
+    if (line.empty()) {
+      continue;
+    }
+    std::istringstream fields(line);
+    ShardRange shard;
+    std::getline(fields, shard.file, '\t');
+    fields >> shard.first >> shard.count >> shard.residues;
+    if (fields.fail()) {
+      std::cerr << "File " << filename << " has a malformed line: " << line
+                << std::endl;
+      std::terminate();
+    }
+    shards.push_back(std::move(shard));
+  }
+  return shards;
+}
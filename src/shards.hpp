@@ -0,0 +1,35 @@
+#ifndef CONVERGE_ENCODER_SHARDS_HPP_
+#define CONVERGE_ENCODER_SHARDS_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "sequence_store.hpp"
+
+// One shard of a proteome: the global sequence IDs [first, first + count),
+// holding residues residues in all, stored in file.
+struct ShardRange {
+  std::string file;
+  uint64_t first = 0;
+  uint64_t count = 0;
+  uint64_t residues = 0;
+};
+
+// Cuts the sequences into num_shards contiguous ranges of near-equal
+// residue count. Every cut lands on the sequence boundary closest to
+// k / num_shards of the residues, so shards differ by at most about one
+// sequence length. Shards can be empty if there are fewer sequences than
+// shards. file is left empty.
+std::vector<ShardRange> partition_by_residues(
+  const SequenceStore& sequences, size_t num_shards);
+
+// The shard manifest is one tab-separated line per shard, in shard order:
+// file name (relative to the manifest), first global ID, sequence count,
+// residue count.
+void write_shard_manifest(const std::string& filename,
+  const std::vector<ShardRange>& shards);
+std::vector<ShardRange> read_shard_manifest(const std::string& filename);
+
+#endif  // CONVERGE_ENCODER_SHARDS_HPP_
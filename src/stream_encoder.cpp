@@ -0,0 +1,227 @@
+#include "stream_encoder.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include "fasta_index.hpp"
+#include "fasta_input.hpp"
+#include "fasta_parser.hpp"
+#include "header_store.hpp"
+#include "output_file.hpp"
+#include "sequence_store.hpp"
+
+
+namespace {
+
+// cereal's BinaryArchive writes every container size as a 64-bit tag.
+using SizeTag = uint64_t;
+
+
+// Spools one CSR column (a StringColumn or a SequenceStore) to two temp
+// files, offsets and elements, and writes it out in the layout cereal gives
+// the column: the offsets vector, then the element vector.
+class ColumnSpool {
+ public:
+  ColumnSpool(const std::string& path, size_t buffer_size,
+              size_t element_size)
+    : offsets_path_(path + ".offsets.tmp"),
+      elements_path_(path + ".elements.tmp"),
+      element_size_(element_size),
+      offsets_(std::make_unique<OutputFile>(offsets_path_, buffer_size)),
+      elements_(std::make_unique<OutputFile>(elements_path_, buffer_size)) {
+    offsets_->write(&element_count_, sizeof(element_count_));
+  }
+
+  // Adds n elements to the entry under construction; end_entry() closes
+  // it.
+  void append(const void* data, size_t n) {
+    elements_->write(data, n * element_size_);
+    element_count_ += n;
+  }
+  void end_entry() {
+    offsets_->write(&element_count_, sizeof(element_count_));
+    entries_++;
+  }
+  void push_back(std::string_view value) {
+    append(value.data(), value.size());
+    end_entry();
+  }
+
+  void write_to(OutputFile& archive) {
+    offsets_.reset();
+    elements_.reset();
+    SizeTag offset_count = entries_ + 1;
+    archive.write(&offset_count, sizeof(offset_count));
+    archive.append_file(offsets_path_);
+    archive.write(&element_count_, sizeof(element_count_));
+    archive.append_file(elements_path_);
+    std::remove(offsets_path_.c_str());
+    std::remove(elements_path_.c_str());
+  }
+
+  void write_sections(ContainerWriter& container, SectionId offsets,
+                      SectionId elements) {
+    offsets_.reset();
+    elements_.reset();
+    container.begin_section(offsets, sizeof(uint64_t));
+    container.file().append_file(offsets_path_);
+    container.end_section();
+    container.begin_section(elements, static_cast<uint32_t>(element_size_));
+    container.file().append_file(elements_path_);
+    container.end_section();
+    std::remove(offsets_path_.c_str());
+    std::remove(elements_path_.c_str());
+  }
+
+ private:
+  std::string offsets_path_;
+  std::string elements_path_;
+  size_t element_size_;
+  std::unique_ptr<OutputFile> offsets_;
+  std::unique_ptr<OutputFile> elements_;
+  uint64_t element_count_ = 0;
+  size_t entries_ = 0;
+};
+
+
+// Writes the sequences in the layout cereal gives a SequenceStore and the
+// headers as container sections. Every column is spooled to temp files
+// until the record count is known.
+class ArchiveSink : public FastaSink {
+ public:
+  ArchiveSink(const std::string& spool_path, size_t buffer_size)
+    : headers_(spool_path + ".headers", buffer_size, 1),
+      databases_(spool_path + ".databases", buffer_size, 1),
+      accessions_(spool_path + ".accessions", buffer_size, 1),
+      entry_names_(spool_path + ".entry_names", buffer_size, 1),
+      sequences_(spool_path + ".sequences", buffer_size, sizeof(Residue)) {}
+
+  void residues(const uint8_t* codes, size_t n) override {
+    sequences_.append(codes, n);
+  }
+
+  void end_record(std::string_view header) override {
+    sequences_.end_entry();
+    HeaderFields fields = split_header_fields(header);
+    headers_.push_back(header);
+    databases_.push_back(fields.database);
+    accessions_.push_back(fields.accession);
+    entry_names_.push_back(fields.entry_name);
+    records_++;
+  }
+
+  void write_to(OutputFile& archive) {
+    // cereal tags the first SequenceStore of an archive with its version.
+    uint32_t version = kSequenceStoreVersion;
+    archive.write(&version, sizeof(version));
+    auto encoding = static_cast<uint8_t>(ResidueEncoding::kBytes);
+    archive.write(&encoding, sizeof(encoding));
+    sequences_.write_to(archive);
+  }
+
+  void write_sections(ContainerWriter& container) {
+    sequences_.write_sections(container, SectionId::kSequenceOffsets,
+                              SectionId::kResidues);
+    write_header_sections(container);
+  }
+
+  void write_header_sections(ContainerWriter& container) {
+    headers_.write_sections(container, SectionId::kHeaderOffsets,
+                            SectionId::kHeaders);
+    databases_.write_sections(container, SectionId::kDatabaseOffsets,
+                              SectionId::kDatabases);
+    accessions_.write_sections(container, SectionId::kAccessionOffsets,
+                               SectionId::kAccessions);
+    entry_names_.write_sections(container, SectionId::kEntryNameOffsets,
+                                SectionId::kEntryNames);
+  }
+
+  size_t records() const { return records_; }
+
+ private:
+  ColumnSpool headers_;
+  ColumnSpool databases_;
+  ColumnSpool accessions_;
+  ColumnSpool entry_names_;
+  ColumnSpool sequences_;
+  size_t records_ = 0;
+};
+
+
+// A third of the buffer each for the input chunk, the parser's residue
+// codes (at most one chunk) and the ten spool buffers together.
+size_t buffer_third(size_t buffer_size) {
+  return std::max<size_t>(buffer_size / 3, 4096);
+}
+
+
+// Parses the whole input into sink in chunks of chunk_size bytes.
+void stream_parse(const std::string& input_path, ArchiveSink& sink,
+  size_t chunk_size, size_t num_threads, const std::string& index_path) {
+  FastaReader input(input_path, num_threads);
+  // Index rows are flushed after every chunk so they never pile up.
+  std::vector<FaiEntry> index;
+  std::unique_ptr<FastaIndexBuilder> index_builder;
+  std::unique_ptr<std::ofstream> index_file;
+  if (!index_path.empty()) {
+    index_builder = std::make_unique<FastaIndexBuilder>(index);
+    index_file = std::make_unique<std::ofstream>(index_path);
+    if (!index_file->is_open()) {
+      std::cout << "File " << index_path << " failed to open" << std::endl;
+      std::terminate();
+    }
+  }
+  FastaStreamParser parser(sink, index_builder.get());
+  std::vector<char> chunk(chunk_size);
+  size_t got;
+  while ((got = input.read(chunk.data(), chunk.size())) > 0) {
+    parser.feed(chunk.data(), got);
+    if (index_file) {
+      write_fasta_index(*index_file, index);
+      index.clear();
+    }
+  }
+  parser.finish();
+  if (index_file) {
+    write_fasta_index(*index_file, index);
+  }
+}
+
+}  // namespace
+
+
+size_t stream_encode_fasta(const std::string& input_path,
+  const std::string& output_path, const std::string& headers_path,
+  size_t buffer_size, size_t num_threads, const std::string& index_path,
+  uint32_t* checksum) {
+  size_t third = buffer_third(buffer_size);
+  ArchiveSink sink(output_path, third / 10);
+  stream_parse(input_path, sink, third, num_threads, index_path);
+  OutputFile archive(output_path, third);
+  sink.write_to(archive);
+  archive.close();
+  if (checksum) {
+    *checksum = archive.checksum();
+  }
+  ContainerWriter headers(headers_path, third);
+  sink.write_header_sections(headers);
+  headers.close();
+  return sink.records();
+}
+
+
+size_t stream_encode_fasta(const std::string& input_path,
+  ContainerWriter& container, size_t buffer_size, size_t num_threads,
+  const std::string& index_path) {
+  size_t third = buffer_third(buffer_size);
+  ArchiveSink sink(container.filename(), third / 10);
+  stream_parse(input_path, sink, third, num_threads, index_path);
+  sink.write_sections(container);
+  return sink.records();
+}
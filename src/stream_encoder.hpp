@@ -0,0 +1,35 @@
+#ifndef CONVERGE_ENCODER_STREAM_ENCODER_HPP_
+#define CONVERGE_ENCODER_STREAM_ENCODER_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "container.hpp"
+
+constexpr size_t kDefaultStreamBufferSize = size_t(64) << 20;
+
+// Encodes the FASTA file input_path into output_path and its headers into
+// the container headers_path without holding the proteome in memory. Both
+// are byte-identical to what the in-memory path writes after
+// load_fasta_sequences(): save(output_path, sequences) and
+// write_header_container(headers_path, headers). Memory use is bounded by
+// about buffer_size plus the longest header line, whatever the input size.
+// Each column is spooled to a temp file next to output_path until the
+// record count is known.
+// gzip and BGZF input is inflated on the fly, BGZF on num_threads threads.
+// If index_path is not empty, the .fai index of the sequences is written
+// there as the input is parsed. If checksum is not null, the CRC32C of
+// output_path is stored there. Returns the number of sequences written.
+size_t stream_encode_fasta(const std::string& input_path,
+  const std::string& output_path, const std::string& headers_path,
+  size_t buffer_size, size_t num_threads = 1,
+  const std::string& index_path = "", uint32_t* checksum = nullptr);
+
+// Same, but writes the proteome sections into container instead; the
+// caller adds any other sections and closes it.
+size_t stream_encode_fasta(const std::string& input_path,
+  ContainerWriter& container, size_t buffer_size, size_t num_threads = 1,
+  const std::string& index_path = "");
+
+#endif  // CONVERGE_ENCODER_STREAM_ENCODER_HPP_
@@ -0,0 +1,55 @@
+#ifndef CONVERGE_ENCODER_THREAD_POOL_HPP_
+#define CONVERGE_ENCODER_THREAD_POOL_HPP_
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Fixed set of worker threads running submitted tasks in FIFO order.
+class ThreadPool {
+ public:
+  // num_threads == 0 uses every hardware thread. No more than max_threads
+  // are started, so a caller that knows how many tasks it has can pass
+  // that and not start idle workers.
+  explicit ThreadPool(size_t num_threads, size_t max_threads = SIZE_MAX);
+  // Finishes the queued tasks, then joins the workers.
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  size_t size() const { return workers_.size(); }
+
+  template <typename F>
+  std::future<std::invoke_result_t<F>> submit(F&& task) {
+    using Result = std::invoke_result_t<F>;
+    auto packaged = std::make_shared<std::packaged_task<Result()>>(
+      std::forward<F>(task));
+    std::future<Result> result = packaged->get_future();
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      tasks_.emplace([packaged]() { (*packaged)(); });
+    }
+    ready_.notify_one();
+    return result;
+  }
+
+ private:
+  void run();
+
+  std::vector<std::thread> workers_;
+  std::queue<std::function<void()>> tasks_;
+  std::mutex mutex_;
+  std::condition_variable ready_;
+  bool stopping_ = false;
+};
+
+#endif  // CONVERGE_ENCODER_THREAD_POOL_HPP_
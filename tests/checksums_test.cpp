@@ -0,0 +1,132 @@
+// CRC32C against reference values and the table kernel, the checksum
+// manifest, and --verify on a run whose output was corrupted afterwards.
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "checksums.hpp"
+#include "container.hpp"
+#include "crc32c.hpp"
+#include "test_support.hpp"
+
+
+// One bit at a time, straight from the definition.
+uint32_t reference_crc32c(const uint8_t* p, size_t n) {
+  uint32_t crc = ~0u;
+  for (size_t i = 0; i < n; i++) {
+    crc ^= p[i];
+    for (int bit = 0; bit < 8; bit++) {
+      crc = crc & 1 ? (crc >> 1) ^ 0x82F63B78 : crc >> 1;
+    }
+  }
+  return ~crc;
+}
+
+
+void test_vectors() {
+  const char* digits = "123456789";
+  CHECK(crc32c(digits, 9) == 0xe3069283);
+  CHECK(crc32c_table(digits, 9) == 0xe3069283);
+  CHECK(crc32c(digits, 0) == 0);
+  std::vector<uint8_t> zeros(32, 0);
+  CHECK(crc32c(zeros.data(), zeros.size()) == 0x8a9136aa);
+  std::vector<uint8_t> ones(32, 0xff);
+  CHECK(crc32c(ones.data(), ones.size()) == 0x62a8ab43);
+}
+
+
+// The hardware kernels run three streams over 3 x 1024-byte blocks; check
+// lengths on either side of one, two and three block groups, from every
+// alignment, and continued from a split.
+void test_kernels() {
+  std::mt19937 rng(13);
+  std::vector<uint8_t> data(4 * 3 * 1024 + 64);
+  for (uint8_t& byte: data) {
+    byte = static_cast<uint8_t>(rng());
+  }
+  std::vector<size_t> lengths;
+  for (size_t n = 0; n < 64; n++) {
+    lengths.push_back(n);
+  }
+  for (size_t groups = 1; groups <= 3; groups++) {
+    for (size_t n = groups * 3072 - 9; n <= groups * 3072 + 9; n++) {
+      lengths.push_back(n);
+    }
+  }
+  lengths.push_back(1024);
+  lengths.push_back(2048);
+  for (size_t offset = 0; offset < 8; offset++) {
+    for (size_t n: lengths) {
+      const uint8_t* p = data.data() + offset;
+      uint32_t expected = reference_crc32c(p, n);
+      CHECK(crc32c(p, n) == expected);
+      CHECK(crc32c_table(p, n) == expected);
+      for (size_t split: {size_t(0), n / 3, n}) {
+        CHECK(crc32c(p + split, n - split, crc32c(p, split)) == expected);
+      }
+    }
+  }
+}
+
+
+void test_manifest() {
+  namespace fs = std::filesystem;
+  std::string dir = "checksums_test.manifest";
+  fs::remove_all(dir);
+  fs::create_directories(dir);
+  write_file(dir + "/plain", "some bytes to checksum");
+  {
+    ContainerWriter writer(dir + "/container");
+    writer.add_sequences(SectionId::kSequenceOffsets, SectionId::kResidues,
+                         random_sequences(20, 1, 100, 14));
+    writer.close();
+  }
+  std::string manifest = dir + "/checksums";
+  write_checksum_manifest(manifest, {{"plain", false,
+                                      file_crc32c(dir + "/plain")},
+                                     {"container", true, 0}});
+  std::vector<ChecksumEntry> entries = read_checksum_manifest(manifest);
+  CHECK(entries.size() == 2);
+  CHECK(entries[0].file == "plain" && !entries[0].container &&
+        entries[0].crc32c == crc32c("some bytes to checksum", 22));
+  CHECK(entries[1].file == "container" && entries[1].container);
+  CHECK(verify_checksum_manifest(manifest));
+
+  write_file(dir + "/plain", "some bytes to checksuM");
+  CHECK(!verify_checksum_manifest(manifest));
+  write_file(dir + "/plain", "some bytes to checksum");
+  CHECK(verify_checksum_manifest(manifest));
+  uint64_t residues = MappedContainer(dir + "/container")
+                       .section(SectionId::kResidues).offset;
+  std::string container = read_file(dir + "/container");
+  container[residues] ^= 1;
+  write_file(dir + "/container", container);
+  CHECK(!verify_checksum_manifest(manifest));
+  fs::remove_all(dir);
+}
+
+
+void test_verify_run(const std::string& encoder, const std::string& input) {
+  std::string dir = encoder_run_dir("checksums_test.run", input);
+  CHECK(run_encoder(encoder, dir, "") == 0);
+  CHECK(run_encoder(encoder, dir, "--verify") == 0);
+  std::string seeds = read_file(dir + "/output/seed_seq_binary");
+  seeds[seeds.size() / 2] ^= 0x10;
+  write_file(dir + "/output/seed_seq_binary", seeds);
+  CHECK(run_encoder(encoder, dir, "--verify") == 1);
+  std::filesystem::remove_all(dir);
+}
+
+
+int main(int argc, char** argv) {
+  CHECK(argc == 3);
+  test_vectors();
+  test_kernels();
+  test_manifest();
+  test_verify_run(argv[1], argv[2]);
+  return 0;
+}
@@ -0,0 +1,597 @@
+// Containers: what ContainerWriter writes maps back the same, through
+// MappedContainer and the header-only Reader alike, a damaged container is
+// refused on open, and appends, removals and compaction leave the
+// sequences a fresh encode of the same records has.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "container.hpp"
+#include "container_update.hpp"
+#include "converge_encoder/reader.hpp"
+#include "crc32c.hpp"
+#include "fasta_parser.hpp"
+#include "header_store.hpp"
+#include "residue_encoder.hpp"
+#include "seed_windows.hpp"
+#include "sequence_store.hpp"
+#include "test_support.hpp"
+
+
+bool same_column(const StringColumnView& view, const StringColumn& column) {
+  if (view.size() != column.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < column.size(); i++) {
+    if (view[i] != column[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+
+// The sequences and header lines of every segment, deleted ones left out.
+void live_records(const MappedContainer& container, SequenceStore& sequences,
+  std::vector<std::string>& headers) {
+  TombstoneView tombstones = container.tombstones();
+  uint64_t i = 0;
+  for (uint32_t segment = 0; segment < container.segment_count(); segment++) {
+    SequenceView segment_sequences = container.sequences(segment);
+    StringColumnView segment_headers = container.headers(segment);
+    for (size_t j = 0; j < segment_sequences.size(); j++, i++) {
+      if (!tombstones[i]) {
+        sequences.push_back(segment_sequences[j]);
+        headers.emplace_back(segment_headers[j]);
+      }
+    }
+  }
+}
+
+
+void write_proteome(const std::string& filename, const std::string& fasta) {
+  HeaderStore headers;
+  SequenceStore sequences;
+  load_fasta_sequences(fasta, headers, sequences);
+  ContainerWriter writer(filename);
+  writer.add_sequences(SectionId::kSequenceOffsets, SectionId::kResidues,
+                       sequences);
+  writer.add_headers(headers);
+  writer.close();
+}
+
+
+void test_round_trip() {
+  std::string text = random_fasta(300, 1000, 8);
+  HeaderStore headers;
+  SequenceStore sequences;
+  parse_fasta(text.data(), text.data() + text.size(), headers, sequences);
+  {
+    ContainerWriter writer("container_test.container");
+    writer.add_sequences(SectionId::kSequenceOffsets, SectionId::kResidues,
+                         sequences);
+    writer.add_headers(headers);
+    writer.close();
+  }
+  MappedContainer container("container_test.container");
+  CHECK(container.version() == kContainerVersion);
+  CHECK(!container.foreign());
+  CHECK(container.verify());
+  CHECK(container.segment_count() == 1);
+  CHECK(container.file_size() ==
+        read_file("container_test.container").size());
+  for (const SectionEntry& entry: container.directory()) {
+    CHECK(entry.offset % kSectionAlignment == 0);
+    CHECK(reinterpret_cast<uintptr_t>(container.section_data(
+      static_cast<SectionId>(entry.id))) % kSectionAlignment == 0);
+  }
+  CHECK(container.has_section(SectionId::kResidues));
+  CHECK(!container.has_section(SectionId::kMatrix));
+  CHECK(!container.has_section(SectionId::kResidues, 1));
+
+  SequenceView mapped = container.sequences();
+  CHECK(mapped.size() == sequences.size());
+  CHECK(mapped.total_residues() == sequences.total_residues());
+  for (size_t i = 0; i < sequences.size(); i++) {
+    CHECK(mapped[i].size == sequences[i].size);
+    CHECK(memcmp(mapped[i].data, sequences[i].data, mapped[i].size) == 0);
+  }
+  CHECK(same_column(container.headers(), headers.headers()));
+  CHECK(same_column(container.databases(), headers.databases()));
+  CHECK(same_column(container.accessions(), headers.accessions()));
+  CHECK(same_column(container.entry_names(), headers.entry_names()));
+  CHECK(container.manifest().empty());
+  CHECK(container.tombstones().count() == 0);
+
+  converge_encoder::Reader reader("container_test.container");
+  CHECK(reader.version() == kContainerVersion);
+  CHECK(reader.segment_count() == 1);
+  CHECK(reader.section(SectionId::kResidues).size() ==
+        container.section(SectionId::kResidues).size);
+  CHECK(reader.section(SectionId::kMatrix).empty());
+  converge_encoder::ProteomeView proteome = reader.proteome();
+  CHECK(proteome.size() == sequences.size() && proteome.has_headers());
+  CHECK(proteome.total_residues() == sequences.total_residues());
+  for (size_t i = 0; i < sequences.size(); i++) {
+    CHECK(proteome[i].size() == sequences[i].size);
+    CHECK(memcmp(proteome[i].data(), sequences[i].data,
+                 sequences[i].size) == 0);
+    CHECK(proteome.header(i) == headers[i]);
+  }
+  std::string_view value;
+  CHECK(!reader.manifest_value("matrix", value));
+  CHECK(reader.tombstones().words().empty());
+}
+
+
+// Proteome, seeds, matrix and manifest in one file.
+void test_bundle() {
+  SequenceStore sequences = random_sequences(50, 0, 300, 26);
+  SeedSets seeds(random_sequences(40, 0, 200, 27), {{30, 10}});
+  std::vector<std::vector<double>> matrix(kAlphabet.size(),
+    std::vector<double>(kAlphabet.size()));
+  for (size_t row = 0; row < matrix.size(); row++) {
+    for (size_t col = 0; col < matrix.size(); col++) {
+      matrix[row][col] = static_cast<double>(row) - 0.5 * col;
+    }
+  }
+  {
+    ContainerWriter writer("container_test.bundle");
+    writer.add_sequences(SectionId::kSequenceOffsets, SectionId::kResidues,
+                         sequences);
+    writer.add_seeds(seeds);
+    writer.add_matrix(matrix);
+    writer.add_manifest({{"seed_length", "30"}, {"seed_stride", "10"},
+                         {"matrix", "BLOSUM62"}});
+    writer.close();
+  }
+  MappedContainer container("container_test.bundle");
+  CHECK(container.verify());
+  CHECK(container.sequences().size() == sequences.size());
+  CHECK(container.seed_set_count() == 1);
+  SeedView mapped_seeds = container.seeds();
+  CHECK(mapped_seeds.size() == seeds[0].size());
+  CHECK(mapped_seeds.length == 30 && mapped_seeds.stride == 10);
+  for (size_t i = 0; i < mapped_seeds.size(); i++) {
+    CHECK(mapped_seeds[i].size == 30);
+    CHECK(memcmp(mapped_seeds[i].data, seeds[0][i].data, 30) == 0);
+  }
+  MatrixView mapped_matrix = container.matrix();
+  CHECK(mapped_matrix.rows == matrix.size() &&
+        mapped_matrix.cols == matrix.size());
+  for (size_t row = 0; row < matrix.size(); row++) {
+    for (size_t col = 0; col < matrix.size(); col++) {
+      CHECK(mapped_matrix[row][col] == matrix[row][col]);
+    }
+  }
+  CHECK(container.manifest().size() == 3);
+  CHECK(container.manifest_value("matrix") == "BLOSUM62");
+  CHECK(container.manifest_value("seed_stride") == "10");
+  CHECK(ends_program([] {
+    MappedContainer("container_test.bundle").manifest_value("nope");
+  }));
+
+  converge_encoder::Reader reader("container_test.bundle");
+  CHECK(reader.proteome().size() == sequences.size());
+  CHECK(!reader.proteome().has_headers());
+  CHECK(reader.seed_set_count() == 1);
+  converge_encoder::SeedSetView read_seeds = reader.seeds();
+  CHECK(read_seeds.size() == seeds[0].size());
+  CHECK(read_seeds.window_length() == 30 && read_seeds.window_stride() == 10);
+  CHECK(read_seeds.sources().size() == seeds.sources().size());
+  for (size_t i = 0; i < read_seeds.size(); i++) {
+    CHECK(read_seeds[i].size() == 30);
+    CHECK(memcmp(read_seeds[i].data(), seeds[0][i].data, 30) == 0);
+  }
+  converge_encoder::MatrixView read_matrix = reader.matrix();
+  CHECK(read_matrix.rows() == matrix.size());
+  for (size_t row = 0; row < matrix.size(); row++) {
+    for (size_t col = 0; col < matrix.size(); col++) {
+      CHECK(read_matrix(row, col) == matrix[row][col]);
+    }
+  }
+  std::string_view value;
+  CHECK(reader.manifest_value("matrix", value) && value == "BLOSUM62");
+  CHECK(!reader.manifest_value("nope", value));
+  CHECK(reader.manifest_number("seed_length") == 30);
+  CHECK(reader.manifest_number("nope") == 0);
+  CHECK(ends_program([] {
+    converge_encoder::Reader("container_test.bundle").seeds(1);
+  }));
+  CHECK(ends_program([] {
+    converge_encoder::Reader("container_test.bundle").manifest_number("matrix");
+  }));
+  std::remove("container_test.bundle");
+}
+
+
+// Every kind of damage the header and directory checks catch.
+void test_damage() {
+  std::string good = read_file("container_test.container");
+  auto refused = [](const std::string& bytes) {
+    write_file("container_test.damaged", bytes);
+    return ends_program([] {
+      MappedContainer container("container_test.damaged");
+    });
+  };
+  // Reader leaves checksums to --verify, but refuses the rest alike.
+  auto refused_by_both = [&refused](const std::string& bytes) {
+    return refused(bytes) && ends_program([] {
+      converge_encoder::Reader reader("container_test.damaged");
+    });
+  };
+  CHECK(!refused(good));
+  CHECK(!ends_program([] {
+    converge_encoder::Reader reader("container_test.damaged");
+  }));
+  CHECK(refused_by_both(""));
+  CHECK(refused_by_both(good.substr(0, 40)));
+  CHECK(refused_by_both(good.substr(0, good.size() - 1)));
+  std::string damaged = good;
+  damaged[0] = 'X';
+  CHECK(refused_by_both(damaged));
+  damaged = good;
+  damaged[offsetof(ContainerHeader, version)] = 99;
+  CHECK(refused_by_both(damaged));
+  damaged = good;
+  damaged[offsetof(ContainerHeader, section_count)] ^= 1;
+  CHECK(refused(damaged));
+  ContainerHeader header;
+  memcpy(&header, good.data(), sizeof(header));
+  damaged = good;
+  damaged[header.directory_offset + offsetof(SectionEntry, size)] ^= 64;
+  CHECK(refused(damaged));
+  // A damaged section opens; verify() finds it.
+  uint64_t residues = MappedContainer("container_test.container")
+                       .section(SectionId::kResidues).offset;
+  damaged = good;
+  damaged[residues] ^= 1;
+  write_file("container_test.damaged", damaged);
+  CHECK(!MappedContainer("container_test.damaged").verify());
+  CHECK(ends_program([] {
+    MappedContainer container("container_test.container");
+    container.section(SectionId::kMatrix);
+  }));
+  std::remove("container_test.damaged");
+}
+
+
+// reverse_bytes() against a byte at a time, over counts on either side of
+// the SIMD blocks and from odd alignments.
+void test_reverse_bytes() {
+  std::mt19937 rng(31);
+  std::vector<uint8_t> data(1100);
+  for (uint8_t& byte: data) {
+    byte = static_cast<uint8_t>(rng());
+  }
+  for (size_t element_size: {2, 3, 4, 8, 16}) {
+    for (size_t count: {0, 1, 3, 4, 7, 8, 9, 31, 32, 33, 60}) {
+      for (size_t offset: {0, 1, 5}) {
+        std::vector<uint8_t> reversed(data.begin() + offset, data.end());
+        reverse_bytes(reversed.data(), count, element_size);
+        for (size_t i = 0; i < count * element_size; i++) {
+          size_t first = i / element_size * element_size;
+          CHECK(reversed[i] ==
+                data[offset + first + element_size - 1 - i % element_size]);
+        }
+        CHECK(memcmp(reversed.data() + count * element_size,
+                     data.data() + offset + count * element_size,
+                     reversed.size() - count * element_size) == 0);
+      }
+    }
+  }
+}
+
+
+// The container as a host of the other byte order would have written it:
+// every multi-byte element, the directory and the header reversed, and
+// the CRCs taken over the reversed bytes.
+std::string foreign_copy(const std::string& good) {
+  std::string foreign = good;
+  ContainerHeader header;
+  memcpy(&header, good.data(), sizeof(header));
+  auto entries = reinterpret_cast<SectionEntry*>(&foreign[0] +
+                                                 header.directory_offset);
+  for (size_t i = 0; i < header.section_count; i++) {
+    SectionEntry& entry = entries[i];
+    char* data = &foreign[0] + entry.offset;
+    reverse_bytes(data, entry.size / entry.element_size, entry.element_size);
+    entry.crc32c = crc32c(data, entry.size);
+  }
+  reverse_entries(entries, header.section_count);
+  header.directory_crc32c =
+    crc32c(entries, header.section_count * sizeof(SectionEntry));
+  header.header_crc32c = 0;
+  reverse_header(header);
+  uint32_t header_crc = crc32c(&header, sizeof(header));
+  header.header_crc32c = __builtin_bswap32(header_crc);
+  memcpy(&foreign[0], &header, sizeof(header));
+  return foreign;
+}
+
+
+// A container from the other byte order opens in host order, verifies,
+// and reads back the same through both readers.
+void test_foreign() {
+  std::string text = random_fasta(120, 0, 32);
+  HeaderStore headers;
+  SequenceStore sequences;
+  parse_fasta(text.data(), text.data() + text.size(), headers, sequences);
+  SeedSets seeds(random_sequences(30, 0, 200, 33), {{30, 10}, {12, 4}});
+  std::vector<std::vector<double>> matrix(kAlphabet.size(),
+    std::vector<double>(kAlphabet.size()));
+  for (size_t row = 0; row < matrix.size(); row++) {
+    for (size_t col = 0; col < matrix.size(); col++) {
+      matrix[row][col] = 0.25 * static_cast<double>(row) - col;
+    }
+  }
+  {
+    ContainerWriter writer("container_test.native");
+    writer.add_sequences(SectionId::kSequenceOffsets, SectionId::kResidues,
+                         sequences);
+    writer.add_headers(headers);
+    writer.add_seeds(seeds);
+    writer.add_matrix(matrix);
+    writer.add_manifest({{"matrix", "BLOSUM62"}});
+    writer.close();
+  }
+  std::string native = read_file("container_test.native");
+  std::string foreign = foreign_copy(native);
+  CHECK(foreign != native);
+  write_file("container_test.foreign", foreign);
+
+  MappedContainer container("container_test.foreign");
+  CHECK(container.foreign());
+  CHECK(container.verify());
+  CHECK(container.version() == kContainerVersion);
+  CHECK(container.file_size() == native.size());
+  MappedContainer original("container_test.native");
+  CHECK(!original.foreign());
+  std::vector<SectionEntry> directory = container.directory();
+  CHECK(directory.size() == original.directory().size());
+  for (const SectionEntry& entry: directory) {
+    CHECK(memcmp(container.section_data(static_cast<SectionId>(entry.id)),
+                 native.data() + entry.offset, entry.size) == 0);
+  }
+  CHECK(container.manifest_value("matrix") == "BLOSUM62");
+  CHECK(same_column(container.headers(), headers.headers()));
+  CHECK(container.seed_set_count() == 2);
+  for (size_t set = 0; set < 2; set++) {
+    SeedView view = container.seeds(set);
+    CHECK(view.size() == seeds[set].size());
+    for (size_t i = 0; i < view.size(); i++) {
+      CHECK(memcmp(view[i].data, seeds[set][i].data, view.length) == 0);
+    }
+  }
+  CHECK(container.matrix()[7][3] == matrix[7][3]);
+
+  converge_encoder::Reader reader("container_test.foreign");
+  CHECK(reader.version() == kContainerVersion);
+  converge_encoder::ProteomeView proteome = reader.proteome();
+  CHECK(proteome.size() == sequences.size());
+  for (size_t i = 0; i < sequences.size(); i++) {
+    CHECK(memcmp(proteome[i].data(), sequences[i].data,
+                 sequences[i].size) == 0);
+    CHECK(proteome.header(i) == headers[i]);
+  }
+  converge_encoder::SeedSetView read_seeds = reader.seeds(1);
+  CHECK(read_seeds.size() == seeds[1].size());
+  CHECK(read_seeds.window_length() == 12 && read_seeds.window_stride() == 4);
+  for (size_t i = 0; i < read_seeds.size(); i++) {
+    CHECK(memcmp(read_seeds[i].data(), seeds[1][i].data, 12) == 0);
+  }
+  for (size_t row = 0; row < matrix.size(); row++) {
+    for (size_t col = 0; col < matrix.size(); col++) {
+      CHECK(reader.matrix()(row, col) == matrix[row][col]);
+    }
+  }
+  std::remove("container_test.native");
+  std::remove("container_test.foreign");
+}
+
+
+// Bytes after the directory, as an interrupted update leaves, are ignored
+// by both readers and by verify().
+void test_trailing_bytes() {
+  std::string good = read_file("container_test.container");
+  write_file("container_test.trailing",
+             good + "left over from an interrupted update");
+  MappedContainer original("container_test.container");
+  MappedContainer container("container_test.trailing");
+  CHECK(container.file_size() == good.size());
+  CHECK(container.verify());
+  SequenceView sequences = original.sequences();
+  SequenceView mapped = container.sequences();
+  CHECK(mapped.size() == sequences.size());
+  for (size_t i = 0; i < sequences.size(); i++) {
+    CHECK(mapped[i].size == sequences[i].size);
+    CHECK(memcmp(mapped[i].data, sequences[i].data, mapped[i].size) == 0);
+    CHECK(container.headers()[i] == original.headers()[i]);
+  }
+  converge_encoder::Reader reader("container_test.trailing");
+  CHECK(reader.proteome().size() == sequences.size());
+  CHECK(reader.proteome().header(0) == original.headers()[0]);
+  std::remove("container_test.trailing");
+}
+
+
+void test_updates() {
+  // Records 0-199 to start with, 200-259 and 260-299 appended, a few of
+  // each removed; a fresh encode of what is left is the reference. An
+  // update removes before it appends, so P210 goes in the second.
+  std::string base = random_fasta(200, 0, 10);
+  std::string first = random_fasta(60, 200, 11);
+  std::string second = random_fasta(40, 260, 12);
+  write_file("container_test.base.fasta", base);
+  write_file("container_test.first.fasta", first);
+  write_file("container_test.second.fasta", second);
+  std::vector<std::string> removed{"P3", "P77", "P199", "NOPE"};
+  std::vector<std::string> removed_later{"P0", "P210", "P259"};
+  std::string live;
+  for (const std::string& text: {base, first, second}) {
+    size_t begin = 0;
+    while (begin < text.size()) {
+      size_t end = text.find("\n>", begin);
+      end = end == std::string::npos ? text.size() : end + 1;
+      std::string record = text.substr(begin, end - begin);
+      bool kept = true;
+      for (const auto& accessions: {removed, removed_later}) {
+        for (const std::string& accession: accessions) {
+          std::string field = "|" + accession + "|";
+          kept = kept && record.find(field) == std::string::npos;
+        }
+      }
+      if (kept) {
+        live += record;
+      }
+      begin = end;
+    }
+  }
+  write_file("container_test.live.fasta", live);
+
+  std::string filename = "container_test.updated";
+  write_proteome(filename, "container_test.base.fasta");
+  ContainerUpdate update =
+    append_to_container(filename, "container_test.first.fasta", removed);
+  // Accessions the container does not have are skipped.
+  CHECK(update.removed == 3);
+  append_to_container(filename, "", removed_later);
+  // An interrupted update's leftovers, which the next one overwrites.
+  std::ofstream(filename, std::ios_base::binary | std::ios_base::app)
+    << "left over from an interrupted update";
+  update = append_to_container(filename, "container_test.second.fasta", {});
+
+  write_proteome("container_test.fresh", "container_test.live.fasta");
+  SequenceStore expected;
+  std::vector<std::string> expected_headers;
+  {
+    MappedContainer fresh("container_test.fresh");
+    live_records(fresh, expected, expected_headers);
+  }
+  CHECK(update.live == expected.size());
+  {
+    MappedContainer updated(filename);
+    CHECK(updated.verify());
+    CHECK(updated.segment_count() == 4);
+    CHECK(updated.tombstones().count() == 6);
+    SequenceStore sequences;
+    std::vector<std::string> headers;
+    live_records(updated, sequences, headers);
+    CHECK(sequences == expected);
+    CHECK(headers == expected_headers);
+  }
+
+  ContainerUpdate compacted = compact_container(filename);
+  CHECK(compacted.live == expected.size());
+  {
+    MappedContainer updated(filename);
+    CHECK(updated.verify());
+    CHECK(updated.segment_count() == 1);
+    CHECK(updated.tombstones().count() == 0);
+    SequenceStore sequences;
+    std::vector<std::string> headers;
+    live_records(updated, sequences, headers);
+    CHECK(sequences == expected);
+    CHECK(headers == expected_headers);
+  }
+  for (const char* name: {"container_test.base.fasta",
+                          "container_test.first.fasta",
+                          "container_test.second.fasta",
+                          "container_test.live.fasta", "container_test.fresh",
+                          "container_test.updated"}) {
+    std::remove(name);
+  }
+}
+
+
+// Header lines by number across the segments of an updated container, in
+// any order and repeated, against the parsed FASTA.
+void test_resolve_headers() {
+  std::vector<std::string> texts = {random_fasta(100, 0, 16),
+                                    random_fasta(30, 100, 17),
+                                    random_fasta(50, 130, 18)};
+  HeaderStore headers;
+  SequenceStore all_sequences;
+  for (size_t k = 0; k < texts.size(); k++) {
+    std::string fasta = "container_test." + std::to_string(k) + ".fasta";
+    write_file(fasta, texts[k]);
+    load_fasta_sequences(fasta, headers, all_sequences);
+  }
+  {
+    HeaderStore first_headers;
+    SequenceStore sequences;
+    load_fasta_sequences("container_test.0.fasta", first_headers, sequences);
+    ContainerWriter writer("container_test.segments");
+    writer.add_sequences(SectionId::kSequenceOffsets, SectionId::kResidues,
+                         sequences);
+    writer.add_headers(first_headers);
+    writer.close();
+  }
+  append_to_container("container_test.segments", "container_test.1.fasta",
+                      {});
+  // A segment of removals alone has no headers of its own.
+  append_to_container("container_test.segments", "", {"P5"});
+  append_to_container("container_test.segments", "container_test.2.fasta",
+                      {});
+  MappedContainer container("container_test.segments");
+  CHECK(container.segment_count() == 4);
+  CHECK(container.total_sequences() == headers.size());
+  converge_encoder::Reader reader("container_test.segments");
+  CHECK(reader.segment_count() == 4);
+  for (uint32_t segment = 0; segment < 4; segment++) {
+    CHECK(reader.proteome(segment).size() ==
+          container.sequences(segment).size());
+  }
+  CHECK(reader.tombstones()[5] && container.tombstones()[5]);
+  CHECK(!reader.tombstones()[4]);
+
+  std::vector<uint64_t> indices = {headers.size() - 1, 0, 99, 100, 129, 130,
+                                   5, 5, 64, 150, 0};
+  std::vector<std::string_view> resolved = container.resolve_headers(indices);
+  CHECK(resolved.size() == indices.size());
+  for (size_t i = 0; i < indices.size(); i++) {
+    CHECK(resolved[i] == headers[indices[i]]);
+  }
+  std::vector<uint64_t> all;
+  for (uint64_t i = headers.size(); i-- > 0;) {
+    all.push_back(i);
+  }
+  resolved = container.resolve_headers(all);
+  for (size_t i = 0; i < all.size(); i++) {
+    CHECK(resolved[i] == headers[all[i]]);
+  }
+  CHECK(container.resolve_headers({}).empty());
+
+  for (uint64_t bad: {uint64_t(headers.size()), uint64_t(headers.size() + 7),
+                      ~uint64_t(0)}) {
+    CHECK(ends_program([bad] {
+      MappedContainer container("container_test.segments");
+      container.resolve_headers({0, bad});
+    }));
+  }
+  for (const char* name: {"container_test.0.fasta", "container_test.1.fasta",
+                          "container_test.2.fasta",
+                          "container_test.segments"}) {
+    std::remove(name);
+  }
+}
+
+
+int main() {
+  test_round_trip();
+  test_damage();
+  test_trailing_bytes();
+  test_bundle();
+  test_resolve_headers();
+  test_updates();
+  test_reverse_bytes();
+  test_foreign();
+  std::remove("container_test.container");
+  return 0;
+}
@@ -0,0 +1,132 @@
+// XXH64 against the reference values, and collapse_duplicates() against
+// the proteome it collapsed.
+
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <cereal/archives/binary.hpp>
+#include <cereal/types/vector.hpp>
+
+#include "dedup.hpp"
+#include "hash.hpp"
+#include "sequence_store.hpp"
+#include "test_support.hpp"
+
+
+bool same_sequence(ResidueSpan a, ResidueSpan b) {
+  return a.size == b.size &&
+         (a.size == 0 || std::memcmp(a.data, b.data, a.size) == 0);
+}
+
+
+void test_xxhash64() {
+  CHECK(xxhash64("", 0) == 0xef46db3751d8e999);
+  CHECK(xxhash64("abc", 3) == 0x44bc2cf5ad770999);
+  const char* text = "Nobody inspects the spammish repetition";
+  CHECK(xxhash64(text, std::strlen(text)) == 0xfbcea83c8a378bf1);
+  CHECK(xxhash64(text, std::strlen(text), 20141025) == 0xce06936136852706);
+
+  // Every tail length after the 32-byte stripes, from any alignment.
+  std::mt19937 rng(8);
+  std::vector<uint8_t> data(200);
+  for (uint8_t& byte: data) {
+    byte = static_cast<uint8_t>(rng());
+  }
+  for (size_t n = 0; n <= 100; n++) {
+    std::vector<uint8_t> copy(data.begin(), data.begin() + n);
+    uint64_t hash = xxhash64(copy.data(), n);
+    for (size_t offset = 1; offset < 8; offset++) {
+      std::memmove(data.data() + offset, copy.data(), n);
+      CHECK(xxhash64(data.data() + offset, n) == hash);
+    }
+  }
+}
+
+
+void test_collapse() {
+  SequenceStore pool = random_sequences(40, 0, 60, 9);
+  std::mt19937 rng(10);
+  SequenceStore sequences;
+  for (size_t i = 0; i < 300; i++) {
+    sequences.push_back(pool[rng() % pool.size()]);
+  }
+  SequenceStore original = sequences;
+  DuplicateGroups groups = collapse_duplicates(sequences);
+
+  CHECK(groups.size() == sequences.size());
+  CHECK(sequences.size() <= pool.size() && sequences.size() > 30);
+  CHECK(groups.members.size() == original.size());
+  std::vector<bool> seen(original.size(), false);
+  uint32_t previous_first = 0;
+  for (size_t i = 0; i < groups.size(); i++) {
+    CHECK(groups.multiplicity(i) > 0);
+    uint64_t begin = groups.member_offsets[i];
+    // Unique sequences come in order of first occurrence, and members in
+    // input order.
+    CHECK(i == 0 || groups.members[begin] > previous_first);
+    previous_first = groups.members[begin];
+    for (uint64_t j = begin; j < groups.member_offsets[i + 1]; j++) {
+      uint32_t member = groups.members[j];
+      CHECK(j == begin || member > groups.members[j - 1]);
+      CHECK(!seen[member]);
+      seen[member] = true;
+      CHECK(same_sequence(original[member], sequences[i]));
+    }
+    for (size_t k = 0; k < i; k++) {
+      CHECK(!same_sequence(sequences[k], sequences[i]));
+    }
+  }
+
+  // Expanding the groups gives the proteome back.
+  std::vector<size_t> group_of(original.size());
+  for (size_t i = 0; i < groups.size(); i++) {
+    for (uint64_t j = groups.member_offsets[i];
+         j < groups.member_offsets[i + 1]; j++) {
+      group_of[groups.members[j]] = i;
+    }
+  }
+  SequenceStore expanded;
+  for (size_t member = 0; member < original.size(); member++) {
+    expanded.push_back(sequences[group_of[member]]);
+  }
+  CHECK(expanded == original);
+
+  std::stringstream stream;
+  {
+    cereal::BinaryOutputArchive archive(stream);
+    archive(groups);
+  }
+  DuplicateGroups loaded;
+  {
+    cereal::BinaryInputArchive archive(stream);
+    archive(loaded);
+  }
+  CHECK(loaded.member_offsets == groups.member_offsets);
+  CHECK(loaded.members == groups.members);
+
+  DuplicateGroups sliced = groups.slice(5, 10);
+  CHECK(sliced.size() == 10);
+  for (size_t i = 0; i < 10; i++) {
+    CHECK(sliced.multiplicity(i) == groups.multiplicity(5 + i));
+    CHECK(sliced.members[sliced.member_offsets[i]] ==
+          groups.members[groups.member_offsets[5 + i]]);
+  }
+
+  // Nothing to collapse leaves the proteome as it was.
+  SequenceStore distinct = random_sequences(50, 30, 40, 11);
+  SequenceStore distinct_copy = distinct;
+  DuplicateGroups singles = collapse_duplicates(distinct);
+  CHECK(distinct == distinct_copy);
+  CHECK(singles.size() == 50 && singles.members.size() == 50);
+}
+
+
+int main() {
+  test_xxhash64();
+  test_collapse();
+  return 0;
+}
@@ -0,0 +1,168 @@
+// .fai rows from every parser against the layout the FASTA was written
+// with, and FastaIndex fetches against the record bodies and the parsed
+// sequences, for regular and irregular line layouts.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "fasta_index.hpp"
+#include "fasta_parser.hpp"
+#include "header_store.hpp"
+#include "residue_encoder.hpp"
+#include "sequence_store.hpp"
+#include "stream_encoder.hpp"
+#include "test_support.hpp"
+
+
+struct Record {
+  std::string name;
+  std::string body;
+  FaiEntry entry;
+};
+
+
+// Records written in turn with each layout: regular lines, regular lines
+// ending in "\r\n", a long last line, random line lengths, and a blank
+// line inside the body. The body keeps the letters outside the alphabet
+// the parser drops. The expected row is worked out from the line lengths
+// actually written, since short bodies can come out regular anyway.
+std::string layout_fasta(std::vector<Record>& records, unsigned seed) {
+  std::mt19937 rng(seed);
+  std::uniform_int_distribution<int> letter(0, kAlphabet.size() - 1);
+  std::uniform_int_distribution<size_t> length(1, 500);
+  std::uniform_int_distribution<size_t> width(1, 70);
+  std::uniform_int_distribution<int> percent(0, 99);
+  std::string text;
+  for (size_t i = 0; i < 200; i++) {
+    Record record;
+    record.name = "sp|Q" + std::to_string(i) + "|Q" + std::to_string(i) +
+                  "_MOUSE";
+    text += ">" + record.name + " Protein " + std::to_string(i) + "\n";
+    size_t size = length(rng);
+    for (size_t j = 0; j < size; j++) {
+      record.body += percent(rng) < 2 ? 'X' : kAlphabet[letter(rng)];
+    }
+    record.body[0] = 'M';
+    int layout = static_cast<int>(i % 5);
+    std::string newline = layout == 1 ? "\r\n" : "\n";
+    size_t line = width(rng);
+    std::vector<size_t> lines;
+    for (size_t begin = 0; begin < size; begin += lines.back()) {
+      size_t n = layout == 3 ? width(rng) : line;
+      if (layout == 2 && begin > 0) {
+        n = size - begin;
+      }
+      lines.push_back(std::min(n, size - begin));
+    }
+    record.entry.name = record.name;
+    record.entry.length = size;
+    record.entry.offset = text.size();
+    bool regular = layout != 4 || lines.size() == 1;
+    for (size_t j = 0, begin = 0; j < lines.size(); begin += lines[j++]) {
+      text += record.body.substr(begin, lines[j]) + newline;
+      if (layout == 4 && j == 0) {
+        text += newline;
+      }
+      if (j > 0 && (lines[j] > lines[0] ||
+                    (lines[j] < lines[0] && j + 1 < lines.size()))) {
+        regular = false;
+      }
+    }
+    if (regular) {
+      record.entry.line_bases = lines[0];
+      record.entry.line_width = lines[0] + newline.size();
+    }
+    records.push_back(record);
+  }
+  return text;
+}
+
+
+bool same_rows(const std::vector<FaiEntry>& index,
+  const std::vector<Record>& records) {
+  if (index.size() != records.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < index.size(); i++) {
+    const FaiEntry& a = index[i];
+    const FaiEntry& b = records[i].entry;
+    if (a.name != b.name || a.length != b.length || a.offset != b.offset ||
+        a.line_bases != b.line_bases || a.line_width != b.line_width) {
+      return false;
+    }
+  }
+  return true;
+}
+
+
+std::string decode(ResidueSpan seq) {
+  std::string text;
+  for (size_t i = 0; i < seq.size; i++) {
+    text += kAlphabet[seq.data[i]];
+  }
+  return text;
+}
+
+
+int main() {
+  std::vector<Record> records;
+  std::string text = layout_fasta(records, 21);
+  write_file("fasta_index_test.fasta", text);
+
+  for (size_t threads: {1, 4}) {
+    HeaderStore headers;
+    SequenceStore sequences;
+    std::vector<FaiEntry> index;
+    load_fasta_sequences("fasta_index_test.fasta", headers, sequences,
+                         threads, &index);
+    CHECK(same_rows(index, records));
+  }
+  for (size_t buffer_size: {size_t(1), size_t(4096)}) {
+    stream_encode_fasta("fasta_index_test.fasta", "fasta_index_test.streamed",
+                        "fasta_index_test.streamed_headers", buffer_size, 1,
+                        "fasta_index_test.fai");
+    CHECK(same_rows(read_fasta_index("fasta_index_test.fai"), records));
+  }
+
+  HeaderStore headers;
+  SequenceStore sequences;
+  std::vector<FaiEntry> parsed;
+  load_fasta_sequences("fasta_index_test.fasta", headers, sequences, 1,
+                       &parsed);
+  write_fasta_index("fasta_index_test.fai", parsed);
+  FastaIndex index("fasta_index_test.fasta", "fasta_index_test.fai");
+  CHECK(index.size() == records.size());
+  size_t irregular = 0;
+  std::mt19937 rng(22);
+  for (size_t i = 0; i < records.size(); i++) {
+    const std::string& body = records[i].body;
+    CHECK(index.find(records[i].name) == i);
+    irregular += index[i].line_bases == 0;
+    std::string fetched = index.fetch(i);
+    CHECK(fetched == body);
+    fetched.erase(std::remove(fetched.begin(), fetched.end(), 'X'),
+                  fetched.end());
+    CHECK(fetched == decode(sequences[i]));
+    for (int j = 0; j < 8; j++) {
+      uint64_t start = rng() % (body.size() + 2);
+      uint64_t length = rng() % (body.size() + 2);
+      std::string expected = start < body.size() ?
+                             body.substr(start, length) : "";
+      CHECK(index.fetch(i, start, length) == expected);
+    }
+    CHECK(index.fetch(i, 0, UINT64_MAX) == body);
+    CHECK(index.fetch(i, body.size() - 1, UINT64_MAX) == body.substr(
+      body.size() - 1));
+  }
+  CHECK(irregular > 50);
+  CHECK(index.find("Q0") == FastaIndex::npos);
+
+  for (const char* name: {"fasta", "fai", "streamed", "streamed_headers"}) {
+    std::remove((std::string("fasta_index_test.") + name).c_str());
+  }
+  return 0;
+}
@@ -0,0 +1,136 @@
+// gzip and BGZF input, whole and streamed, against the same text
+// uncompressed.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <zlib.h>
+
+#include "fasta_input.hpp"
+#include "fasta_parser.hpp"
+#include "header_store.hpp"
+#include "sequence_store.hpp"
+#include "test_support.hpp"
+
+
+void write_gzip(const std::string& filename, const std::string& text) {
+  gzFile file = gzopen(filename.c_str(), "wb");
+  CHECK(file != nullptr);
+  CHECK(gzwrite(file, text.data(), static_cast<unsigned>(text.size())) ==
+        static_cast<int>(text.size()));
+  CHECK(gzclose(file) == Z_OK);
+}
+
+
+// One gzip member per block_size bytes of text, each with the "BC" extra
+// subfield bgzip writes, then bgzip's empty end-of-file block.
+void write_bgzf(const std::string& filename, const std::string& text,
+  size_t block_size) {
+  std::string out;
+  for (size_t begin = 0; begin <= text.size(); begin += block_size) {
+    size_t n = std::min(block_size, text.size() - begin);
+    std::vector<unsigned char> deflated(compressBound(n) + 64);
+    z_stream stream{};
+    CHECK(deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8,
+                       Z_DEFAULT_STRATEGY) == Z_OK);
+    stream.next_in = reinterpret_cast<Bytef*>(
+      const_cast<char*>(text.data() + begin));
+    stream.avail_in = static_cast<uInt>(n);
+    stream.next_out = deflated.data();
+    stream.avail_out = static_cast<uInt>(deflated.size());
+    CHECK(deflate(&stream, Z_FINISH) == Z_STREAM_END);
+    size_t deflated_size = stream.total_out;
+    deflateEnd(&stream);
+    size_t block = 18 + deflated_size + 8;
+    unsigned char head[18] = {0x1f, 0x8b, 8, 4, 0, 0, 0, 0, 0, 0xff, 6, 0,
+                              'B', 'C', 2, 0,
+                              static_cast<unsigned char>((block - 1) & 0xff),
+                              static_cast<unsigned char>((block - 1) >> 8)};
+    out.append(reinterpret_cast<char*>(head), sizeof(head));
+    out.append(reinterpret_cast<char*>(deflated.data()), deflated_size);
+    uint32_t crc = crc32(0,
+      reinterpret_cast<const Bytef*>(text.data() + begin),
+      static_cast<uInt>(n));
+    auto size = static_cast<uint32_t>(n);
+    for (uint32_t word: {crc, size}) {
+      for (int i = 0; i < 4; i++) {
+        out += static_cast<char>(word >> (8 * i) & 0xff);
+      }
+    }
+    if (n == 0) {
+      break;
+    }
+  }
+  write_file(filename, out);
+}
+
+
+std::string read_streamed(const std::string& filename, size_t num_threads,
+  size_t capacity) {
+  FastaReader reader(filename, num_threads);
+  std::string text;
+  std::vector<char> buffer(capacity);
+  while (size_t n = reader.read(buffer.data(), buffer.size())) {
+    text.append(buffer.data(), n);
+  }
+  return text;
+}
+
+
+void test_detect() {
+  std::string head = read_file("fasta_input_test.fasta");
+  auto bytes = [](const std::string& s) {
+    return reinterpret_cast<const unsigned char*>(s.data());
+  };
+  CHECK(detect_compression(bytes(head), head.size()) ==
+        InputCompression::kNone);
+  std::string gzip = read_file("fasta_input_test.fasta.gz");
+  CHECK(detect_compression(bytes(gzip), gzip.size()) ==
+        InputCompression::kGzip);
+  std::string bgzf = read_file("fasta_input_test.fasta.bgz");
+  CHECK(detect_compression(bytes(bgzf), bgzf.size()) ==
+        InputCompression::kBgzf);
+  CHECK(detect_compression(bytes(bgzf), 2) == InputCompression::kGzip);
+  CHECK(detect_compression(bytes(bgzf), 0) == InputCompression::kNone);
+}
+
+
+void test_inputs(const std::string& text) {
+  HeaderStore headers;
+  SequenceStore sequences;
+  load_fasta_sequences("fasta_input_test.fasta", headers, sequences);
+  for (const char* filename: {"fasta_input_test.fasta",
+                              "fasta_input_test.fasta.gz",
+                              "fasta_input_test.fasta.bgz"}) {
+    for (size_t threads: {1, 4}) {
+      FastaInput input(filename, threads);
+      CHECK(std::string(input.data(), input.size()) == text);
+      HeaderStore compressed_headers;
+      SequenceStore compressed_sequences;
+      load_fasta_sequences(filename, compressed_headers, compressed_sequences,
+                           threads);
+      CHECK(compressed_headers == headers);
+      CHECK(compressed_sequences == sequences);
+      for (size_t capacity: {1, 777, 1 << 20}) {
+        CHECK(read_streamed(filename, threads, capacity) == text);
+      }
+    }
+  }
+}
+
+
+int main() {
+  std::string text = random_fasta(500, 20000, 7);
+  write_file("fasta_input_test.fasta", text);
+  write_gzip("fasta_input_test.fasta.gz", text);
+  write_bgzf("fasta_input_test.fasta.bgz", text, 4000);
+  test_detect();
+  test_inputs(text);
+  std::remove("fasta_input_test.fasta");
+  std::remove("fasta_input_test.fasta.gz");
+  std::remove("fasta_input_test.fasta.bgz");
+  return 0;
+}
@@ -0,0 +1,71 @@
+// FASTA parsing: the parallel parser against the single pass.
+
+#include <string>
+#include <vector>
+
+#include "fasta_index.hpp"
+#include "fasta_parser.hpp"
+#include "header_store.hpp"
+#include "sequence_store.hpp"
+#include "test_support.hpp"
+
+
+bool same_index(const std::vector<FaiEntry>& a,
+  const std::vector<FaiEntry>& b) {
+  if (a.size() != b.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < a.size(); i++) {
+    if (a[i].name != b[i].name || a[i].length != b[i].length ||
+        a[i].offset != b[i].offset || a[i].line_bases != b[i].line_bases ||
+        a[i].line_width != b[i].line_width) {
+      return false;
+    }
+  }
+  return true;
+}
+
+
+// More threads than records leaves some chunks without a record start.
+void test_parallel() {
+  std::string text = random_fasta(500, 10000, 6);
+  HeaderStore headers;
+  SequenceStore sequences;
+  std::vector<FaiEntry> index;
+  parse_fasta(text.data(), text.data() + text.size(), headers, sequences,
+              &index);
+  CHECK(sequences.size() > 400);
+  for (size_t threads: {2, 3, 8, 64, 1000}) {
+    HeaderStore parallel_headers;
+    SequenceStore parallel_sequences;
+    std::vector<FaiEntry> parallel_index;
+    parse_fasta_parallel(text.data(), text.data() + text.size(),
+                         parallel_headers, parallel_sequences, threads,
+                         &parallel_index);
+    CHECK(parallel_headers == headers);
+    CHECK(parallel_sequences == sequences);
+    CHECK(same_index(parallel_index, index));
+  }
+}
+
+
+void test_small_inputs() {
+  for (std::string text: {"", ">sp|P1|P1_HUMAN\n", ">a\nMKV\n>b\n\n>c\nW"}) {
+    HeaderStore headers;
+    SequenceStore sequences;
+    parse_fasta(text.data(), text.data() + text.size(), headers, sequences);
+    HeaderStore parallel_headers;
+    SequenceStore parallel_sequences;
+    parse_fasta_parallel(text.data(), text.data() + text.size(),
+                         parallel_headers, parallel_sequences, 4);
+    CHECK(parallel_headers == headers);
+    CHECK(parallel_sequences == sequences);
+  }
+}
+
+
+int main() {
+  test_parallel();
+  test_small_inputs();
+  return 0;
+}
@@ -0,0 +1,85 @@
+// Splitting headers into their UniProt fields, and accession lookups.
+
+#include <string>
+#include <string_view>
+
+#include "header_store.hpp"
+#include "test_support.hpp"
+
+
+bool fields_are(std::string_view header, std::string_view database,
+  std::string_view accession, std::string_view entry_name) {
+  HeaderFields fields = split_header_fields(header);
+  return fields.database == database && fields.accession == accession &&
+         fields.entry_name == entry_name;
+}
+
+
+void test_fields() {
+  CHECK(fields_are(">sp|P69905|HBA_HUMAN Hemoglobin subunit alpha OS=Homo",
+                   "sp", "P69905", "HBA_HUMAN"));
+  CHECK(fields_are("tr|A0A024R161|A0A024R161_HUMAN", "tr", "A0A024R161",
+                   "A0A024R161_HUMAN"));
+  CHECK(fields_are(">sp|P1|NAME\tdescription", "sp", "P1", "NAME"));
+  CHECK(fields_are(">sp|P1|NAME\r", "sp", "P1", "NAME"));
+  // Only the first word is split; bars further on are description.
+  CHECK(fields_are(">sp|P1|NAME a|b|c", "sp", "P1", "NAME"));
+  CHECK(fields_are(">sp|P1|NAME|extra", "sp", "P1", "NAME"));
+
+  // Malformed UniProt headers keep whatever fields they have.
+  CHECK(fields_are(">sp|P1", "sp", "P1", ""));
+  CHECK(fields_are(">sp|P1|", "sp", "P1", ""));
+  CHECK(fields_are(">sp||NAME", "sp", "", "NAME"));
+  CHECK(fields_are(">|P1|NAME", "", "P1", "NAME"));
+  CHECK(fields_are(">|", "", "", ""));
+  CHECK(fields_are(">", "", "", ""));
+  CHECK(fields_are("", "", "", ""));
+  CHECK(fields_are("> sp|P1|NAME", "", "", ""));
+
+  // Anything else is all accession.
+  CHECK(fields_are(">NP_000509.1 hemoglobin subunit beta", "", "NP_000509.1",
+                   ""));
+  CHECK(fields_are(">ENSP00000354587", "", "ENSP00000354587", ""));
+  CHECK(fields_are("chr1:100-200", "", "chr1:100-200", ""));
+}
+
+
+void test_lookup() {
+  HeaderStore headers;
+  headers.push_back(">sp|P1|A_HUMAN first");
+  headers.push_back(">NP_1.1 second");
+  headers.push_back(">sp|P2|B_HUMAN third");
+  headers.push_back(">tr|P1|C_HUMAN repeated accession");
+  headers.push_back(">");
+  CHECK(headers.size() == 5);
+  CHECK(headers.database(0) == "sp" && headers.entry_name(2) == "B_HUMAN");
+  CHECK(headers.accession(1) == "NP_1.1" && headers.database(1).empty());
+  CHECK(headers[3] == ">tr|P1|C_HUMAN repeated accession");
+
+  CHECK(headers.find_accession("P1") == 0);
+  CHECK(headers.find_accession("P2") == 2);
+  CHECK(headers.find_accession("NP_1.1") == 1);
+  CHECK(headers.find_accession("") == 4);
+  CHECK(headers.find_accession("P3") == HeaderStore::npos);
+  CHECK(headers.find_accession("sp") == HeaderStore::npos);
+  CHECK(headers.find_accession("A_HUMAN") == HeaderStore::npos);
+
+  auto index = headers.accession_index();
+  CHECK(index.size() == 4);
+  for (const auto& [accession, i]: index) {
+    CHECK(headers.find_accession(accession) == i);
+  }
+
+  HeaderStore more;
+  more.push_back(">sp|P3|D_HUMAN");
+  headers.append(more);
+  CHECK(headers.find_accession("P3") == 5);
+  CHECK(headers.entry_name(5) == "D_HUMAN");
+}
+
+
+int main() {
+  test_fields();
+  test_lookup();
+  return 0;
+}
@@ -0,0 +1,163 @@
+// The input cache: its file round trip, and runs that keep the outputs of
+// unchanged inputs and encode again exactly the steps whose input,
+// options, format version or outputs changed.
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "hash.hpp"
+#include "input_cache.hpp"
+#include "test_support.hpp"
+
+
+void test_cache_file() {
+  std::vector<InputCacheEntry> entries = {
+    {"proteome", 0x0123456789abcdef, "format=cereal pack=1",
+     {"proteome_binary", "proteome_headers"}},
+    {"seeds", ~uint64_t(0), "windows=w30s10", {"seed_seq_binary"}},
+    {"matrix", 0, "", {}}};
+  write_input_cache("input_cache_test.cache", entries);
+  std::vector<InputCacheEntry> read = read_input_cache("input_cache_test.cache");
+  CHECK(read.size() == entries.size());
+  for (size_t i = 0; i < entries.size(); i++) {
+    CHECK(read[i].same_key(entries[i]));
+    CHECK(read[i].outputs == entries[i].outputs);
+  }
+  InputCacheEntry changed = entries[0];
+  changed.parameters += " dedup=1";
+  CHECK(!read[0].same_key(changed));
+  changed = entries[0];
+  changed.input_hash ^= 1;
+  CHECK(!read[0].same_key(changed));
+
+  CHECK(read_input_cache("input_cache_test.missing").empty());
+  write_file("input_cache_test.cache", "proteome\tnot hex\tformat=cereal\t\n");
+  CHECK(ends_program([] { read_input_cache("input_cache_test.cache"); }));
+
+  std::string text = "some input to hash";
+  write_file("input_cache_test.cache", text);
+  CHECK(hash_input("input_cache_test.cache") ==
+        xxhash64(text.data(), text.size()));
+  std::filesystem::remove("input_cache_test.cache");
+}
+
+
+// Which inputs the last run in dir kept.
+struct Kept {
+  bool proteome;
+  bool seeds;
+  bool matrix;
+
+  bool operator==(const Kept& other) const {
+    return proteome == other.proteome && seeds == other.seeds &&
+           matrix == other.matrix;
+  }
+};
+
+Kept kept(const std::string& dir) {
+  std::string log = read_file(dir + "/log");
+  auto unchanged = [&log](const std::string& input) {
+    return log.find(input + " is unchanged; keeping its outputs.") !=
+           std::string::npos;
+  };
+  return {unchanged("input/proteome.fasta"), unchanged("input/initial.fasta"),
+          unchanged("input/BLOSUM62")};
+}
+
+
+std::filesystem::file_time_type written(const std::string& file) {
+  return std::filesystem::last_write_time(file);
+}
+
+
+void test_reuse(const std::string& encoder, const std::string& input) {
+  std::string dir = encoder_run_dir("input_cache_test.run", input);
+  std::string proteome = dir + "/output/proteome_binary";
+  std::string seeds = dir + "/output/seed_seq_binary";
+  std::string matrix = dir + "/output/blosum_binary";
+  CHECK(run_encoder(encoder, dir, "") == 0);
+  CHECK((kept(dir) == Kept{false, false, false}));
+  std::string first_seeds = read_file(seeds);
+  auto proteome_time = written(proteome);
+  auto matrix_time = written(matrix);
+
+  CHECK(run_encoder(encoder, dir, "") == 0);
+  CHECK((kept(dir) == Kept{true, true, true}));
+  CHECK(written(proteome) == proteome_time);
+  CHECK(run_encoder(encoder, dir, "--verify") == 0);
+
+  // A changed seed file re-encodes the seeds alone.
+  std::string extra = ">extra\n";
+  for (int i = 0; i < 3; i++) {
+    extra += "ACDEFGHIKLMNPQRSTVWY";
+  }
+  write_file(dir + "/input/initial.fasta",
+             read_file(dir + "/input/initial.fasta") + extra + "\n");
+  CHECK(run_encoder(encoder, dir, "") == 0);
+  CHECK((kept(dir) == Kept{true, false, true}));
+  CHECK(read_file(seeds) != first_seeds);
+  CHECK(written(proteome) == proteome_time);
+  CHECK(written(matrix) == matrix_time);
+
+  // Options re-encode the steps they shape.
+  CHECK(run_encoder(encoder, dir, "--seed-windows 12:6") == 0);
+  CHECK((kept(dir) == Kept{true, false, true}));
+  CHECK(run_encoder(encoder, dir, "--seed-windows 12:6 --pack") == 0);
+  CHECK((kept(dir) == Kept{false, true, true}));
+  CHECK(run_encoder(encoder, dir, "--seed-windows 12:6 --pack") == 0);
+  CHECK((kept(dir) == Kept{true, true, true}));
+
+  // So does an output of an older format version.
+  std::string cache = read_file(dir + "/output/input_hashes");
+  size_t version = cache.find(" version=");
+  CHECK(version != std::string::npos && cache.rfind("proteome", 0) == 0);
+  cache.insert(version + 9, "0");
+  write_file(dir + "/output/input_hashes", cache);
+  CHECK(run_encoder(encoder, dir, "--seed-windows 12:6 --pack") == 0);
+  CHECK((kept(dir) == Kept{false, true, true}));
+
+  // And a missing output.
+  std::filesystem::remove(matrix);
+  CHECK(run_encoder(encoder, dir, "--seed-windows 12:6 --pack") == 0);
+  CHECK((kept(dir) == Kept{true, true, false}));
+  CHECK(std::filesystem::exists(matrix));
+  CHECK(run_encoder(encoder, dir, "--seed-windows 12:6 --pack") == 0);
+  CHECK((kept(dir) == Kept{true, true, true}));
+
+  CHECK(run_encoder(encoder, dir, "--seed-windows 12:6 --pack --no-cache") ==
+        0);
+  CHECK((kept(dir) == Kept{false, false, false}));
+  CHECK(run_encoder(encoder, dir, "--verify") == 0);
+  std::filesystem::remove_all(dir);
+}
+
+
+// A container holds all three inputs, so it is kept or written whole.
+void test_container_reuse(const std::string& encoder,
+  const std::string& input) {
+  std::string dir = encoder_run_dir("input_cache_test.container", input);
+  std::string container = dir + "/output/converge_container";
+  CHECK(run_encoder(encoder, dir, "--format container") == 0);
+  auto container_time = written(container);
+  CHECK(run_encoder(encoder, dir, "--format container") == 0);
+  CHECK((kept(dir) == Kept{true, true, true}));
+  CHECK(written(container) == container_time);
+  write_file(dir + "/input/initial.fasta",
+             read_file(dir + "/input/initial.fasta") +
+             ">extra\nACDEFGHIKLMNPQRSTVWYACDEFGHIKLMNPQRSTVWY\n");
+  CHECK(run_encoder(encoder, dir, "--format container") == 0);
+  CHECK((kept(dir) == Kept{false, false, false}));
+  CHECK(run_encoder(encoder, dir, "--verify") == 0);
+  std::filesystem::remove_all(dir);
+}
+
+
+int main(int argc, char** argv) {
+  CHECK(argc == 3);
+  test_cache_file();
+  test_reuse(argv[1], argv[2]);
+  test_container_reuse(argv[1], argv[2]);
+  return 0;
+}
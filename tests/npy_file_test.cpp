@@ -0,0 +1,127 @@
+// .npy files: the header NumPy parses, with a 1-tuple keeping its comma,
+// padded so that the data starts on a 64-byte boundary, then the data.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "converge_encoder/byte_order.hpp"
+#include "crc32c.hpp"
+#include "npy_file.hpp"
+#include "test_support.hpp"
+
+
+// Checks the preamble of an .npy file and returns its header text and the
+// data after it.
+std::string parse_npy(const std::string& file, std::string& data) {
+  CHECK(file.size() >= 10);
+  CHECK(file.compare(0, 6, "\x93NUMPY") == 0);
+  CHECK(file[6] == 1 && file[7] == 0);
+  size_t header_size = static_cast<uint8_t>(file[8]) |
+                       static_cast<size_t>(static_cast<uint8_t>(file[9])) << 8;
+  CHECK(10 + header_size <= file.size());
+  CHECK((10 + header_size) % 64 == 0);
+  std::string header = file.substr(10, header_size);
+  CHECK(header.back() == '\n');
+  data = file.substr(10 + header_size);
+  // The dictionary, then spaces up to the newline.
+  size_t end = header.find('}');
+  CHECK(end != std::string::npos);
+  CHECK(header.find_first_not_of(' ', end + 1) == header.size() - 1);
+  return header.substr(0, end + 1);
+}
+
+
+std::string expected_header(const char* dtype, const std::string& shape) {
+  return std::string("{'descr': '") + dtype +
+         "', 'fortran_order': False, 'shape': " + shape + ", }";
+}
+
+
+void test_shapes() {
+  std::vector<uint32_t> values(12);
+  for (size_t i = 0; i < values.size(); i++) {
+    values[i] = static_cast<uint32_t>(i * 2654435761u);
+  }
+  std::string raw(reinterpret_cast<const char*>(values.data()),
+                  values.size() * sizeof(uint32_t));
+  struct Case {
+    std::vector<size_t> shape;
+    std::string text;
+    size_t count;
+  };
+  for (const Case& c: {Case{{12}, "(12,)", 12}, Case{{3, 4}, "(3, 4)", 12},
+                       Case{{2, 3, 2}, "(2, 3, 2)", 12},
+                       Case{{0}, "(0,)", 0}, Case{{4, 0}, "(4, 0)", 0},
+                       Case{{}, "()", 1}}) {
+    uint32_t crc = write_npy("npy_file_test.npy", values.data(),
+                             sizeof(uint32_t), npy_dtype<uint32_t>(), c.shape);
+    std::string file = read_file("npy_file_test.npy");
+    CHECK(crc == crc32c(file.data(), file.size()));
+    std::string data;
+    CHECK(parse_npy(file, data) ==
+          expected_header(npy_dtype<uint32_t>(), c.text));
+    CHECK(data == raw.substr(0, c.count * sizeof(uint32_t)));
+  }
+}
+
+
+void test_dtypes() {
+  const char* order = kHostLittleEndian ? "<" : ">";
+  CHECK(std::string(npy_dtype<uint8_t>()) == "|u1");
+  CHECK(std::string(npy_dtype<uint32_t>()) == std::string(order) + "u4");
+  CHECK(std::string(npy_dtype<uint64_t>()) == std::string(order) + "u8");
+  CHECK(std::string(npy_dtype<double>()) == std::string(order) + "f8");
+
+  // Header lengths on either side of a 64-byte boundary.
+  for (size_t size = 0; size < 300; size += 7) {
+    std::vector<uint8_t> bytes(size, 0x5a);
+    write_npy("npy_file_test.npy", bytes);
+    std::string data;
+    CHECK(parse_npy(read_file("npy_file_test.npy"), data) ==
+          expected_header("|u1", "(" + std::to_string(size) + ",)"));
+    CHECK(data == std::string(size, 0x5a));
+  }
+  std::vector<double> reals = {0.5, -1.25, 3e100};
+  write_npy("npy_file_test.npy", reals);
+  std::string data;
+  parse_npy(read_file("npy_file_test.npy"), data);
+  CHECK(data.size() == sizeof(double) * reals.size() &&
+        memcmp(data.data(), reals.data(), data.size()) == 0);
+  std::remove("npy_file_test.npy");
+}
+
+
+// --npy writes the proteome as offsets and residues NumPy can map.
+void test_encoder_run(const std::string& encoder, const std::string& input) {
+  std::string dir = encoder_run_dir("npy_file_test.run", input);
+  CHECK(run_encoder(encoder, dir, "--npy") == 0);
+  std::string offsets;
+  std::string header = parse_npy(
+    read_file(dir + "/output/proteome_offsets.npy"), offsets);
+  CHECK(header == expected_header(npy_dtype<uint64_t>(), "(" +
+    std::to_string(offsets.size() / sizeof(uint64_t)) + ",)"));
+  std::string residues;
+  header = parse_npy(read_file(dir + "/output/proteome_residues.npy"),
+                     residues);
+  CHECK(header == expected_header("|u1", "(" +
+                                  std::to_string(residues.size()) + ",)"));
+  uint64_t last;
+  CHECK(offsets.size() >= sizeof(last));
+  memcpy(&last, offsets.data() + offsets.size() - sizeof(last), sizeof(last));
+  CHECK(last == residues.size());
+  std::filesystem::remove_all(dir);
+}
+
+
+int main(int argc, char** argv) {
+  CHECK(argc == 3);
+  test_shapes();
+  test_dtypes();
+  test_encoder_run(argv[1], argv[2]);
+  return 0;
+}
@@ -0,0 +1,106 @@
+// rANS coding of residue codes: round trips over block and lane group
+// boundaries on any number of threads, and refusal of damaged streams.
+
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "residue_encoder.hpp"
+#include "residue_rans.hpp"
+#include "test_support.hpp"
+
+
+// Codes drawn from a skewed distribution with some runs, so that the
+// context model has something to fit.
+std::vector<uint8_t> random_codes(size_t n, unsigned seed) {
+  std::mt19937 rng(seed);
+  std::geometric_distribution<int> skewed(0.2);
+  std::vector<uint8_t> codes(n);
+  for (size_t i = 0; i < n; i++) {
+    codes[i] = i > 2 && rng() % 5 == 0 ? codes[i - 3] :
+      static_cast<uint8_t>(skewed(rng) % kAlphabet.size());
+  }
+  return codes;
+}
+
+
+std::vector<uint8_t> decompressed(const std::vector<uint8_t>& compressed,
+  size_t n, size_t num_threads) {
+  std::vector<uint8_t> codes(n + 1, 0xAA);
+  decompress_residues(compressed.data(), compressed.size(), n, codes.data(),
+                      num_threads);
+  CHECK(codes[n] == 0xAA);
+  codes.pop_back();
+  return codes;
+}
+
+
+void test_round_trips() {
+  const size_t block = kRansBlockResidues;
+  // Within a block, at block edges, one lane group of full blocks and a
+  // partial one, and more full blocks than one group.
+  for (size_t n: {size_t(0), size_t(1), size_t(2), size_t(3), size_t(1000),
+                  block - 1, block, block + 1, 4 * block, 4 * block + 7,
+                  9 * block - 3}) {
+    std::vector<uint8_t> codes = random_codes(n, static_cast<unsigned>(n));
+    std::vector<uint8_t> compressed = compress_residues(codes.data(), n, 1);
+    for (size_t threads: {0, 3}) {
+      CHECK(compress_residues(codes.data(), n, threads) == compressed);
+    }
+    for (size_t threads: {0, 1, 4}) {
+      CHECK(decompressed(compressed, n, threads) == codes);
+    }
+    // Smaller than 5-bit packing once the tables are spread thin enough.
+    if (n >= 4 * block) {
+      CHECK(compressed.size() < n * 5 / 8);
+    }
+  }
+  // A single symbol throughout, and every symbol in turn.
+  std::vector<uint8_t> same(3 * block, 7);
+  CHECK(decompressed(compress_residues(same.data(), same.size()),
+                     same.size(), 0) == same);
+  std::vector<uint8_t> cycle(block + 100);
+  for (size_t i = 0; i < cycle.size(); i++) {
+    cycle[i] = static_cast<uint8_t>(i % kAlphabet.size());
+  }
+  CHECK(decompressed(compress_residues(cycle.data(), cycle.size()),
+                     cycle.size(), 2) == cycle);
+}
+
+
+void test_damage() {
+  size_t n = 2 * kRansBlockResidues + 500;
+  std::vector<uint8_t> codes = random_codes(n, 25);
+  std::vector<uint8_t> good = compress_residues(codes.data(), n);
+  auto refused = [](const std::vector<uint8_t>& compressed,
+                    size_t residues) {
+    return ends_program([&compressed, residues] {
+      std::vector<uint8_t> out(residues);
+      decompress_residues(compressed.data(), compressed.size(), residues,
+                          out.data(), 1);
+    });
+  };
+  CHECK(!refused(good, n));
+  CHECK(refused(good, n - 1));
+  CHECK(refused(std::vector<uint8_t>(good.begin(), good.begin() + 10), n));
+  CHECK(refused(std::vector<uint8_t>(good.begin(), good.end() - 1), n));
+  std::vector<uint8_t> longer = good;
+  longer.push_back(0);
+  CHECK(refused(longer, n));
+  // A byte in the middle of the payload.
+  std::vector<uint8_t> damaged = good;
+  damaged[good.size() / 2] ^= 0x5A;
+  CHECK(refused(damaged, n));
+  std::vector<uint8_t> bad_code(codes);
+  bad_code[17] = static_cast<uint8_t>(kAlphabet.size());
+  CHECK(ends_program([&bad_code] {
+    compress_residues(bad_code.data(), bad_code.size());
+  }));
+}
+
+
+int main() {
+  test_round_trips();
+  test_damage();
+  return 0;
+}
@@ -0,0 +1,225 @@
+// Seed windows: window counts and positions, SeedSets archives of version
+// 2 and of version 1, which held a single window set, archives whose
+// windows lie outside the seed sequences, which do not load, and several
+// window sets encoded at once into archives and containers.
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <cereal/archives/binary.hpp>
+#include <cereal/types/vector.hpp>
+
+#include "container.hpp"
+#include "converge_encoder/reader.hpp"
+#include "fasta_parser.hpp"
+#include "header_store.hpp"
+#include "seed_windows.hpp"
+#include "sequence_store.hpp"
+#include "test_support.hpp"
+
+
+// Writes what SeedSets wrote as class version 1.
+struct SeedSetsVersion1 {
+  SeedWindowing windowing;
+  SequenceStore sources;
+  std::vector<SeedWindow> windows;
+
+  template <class Archive>
+  void save(Archive& archive, const uint32_t /*version*/) const {
+    archive(static_cast<uint64_t>(windowing.length),
+            static_cast<uint64_t>(windowing.stride), sources);
+    archive(cereal::make_size_tag(
+      static_cast<cereal::size_type>(windows.size())));
+    archive(cereal::binary_data(windows.data(),
+                                windows.size() * sizeof(SeedWindow)));
+  }
+};
+
+CEREAL_CLASS_VERSION(SeedSetsVersion1, 1)
+
+
+void test_windows() {
+  CHECK(count_windows(29, {30, 10}) == 0);
+  CHECK(count_windows(30, {30, 10}) == 1);
+  CHECK(count_windows(39, {30, 10}) == 1);
+  CHECK(count_windows(40, {30, 10}) == 2);
+  SequenceStore sources = random_sequences(200, 0, 300, 4);
+  std::vector<SeedWindowing> windowings{{30, 10}, {8, 4}, {13, 7}};
+  SeedSets seeds(sources, windowings);
+  CHECK(seeds.size() == windowings.size());
+  for (size_t s = 0; s < seeds.size(); s++) {
+    SeedSetView set = seeds[s];
+    // The copies split_windows() makes are the spans the set points at.
+    SequenceStore copies = set.materialize();
+    CHECK(copies.size() == set.size());
+    for (size_t i = 0; i < set.size(); i++) {
+      CHECK(set[i].size == windowings[s].length);
+      CHECK(memcmp(set[i].data, copies[i].data, set[i].size) == 0);
+    }
+    size_t count = 0;
+    for (size_t i = 0; i < sources.size(); i++) {
+      count += count_windows(sources[i].size, windowings[s]);
+    }
+    CHECK(set.size() == count);
+  }
+}
+
+
+void test_archives() {
+  SequenceStore sources = random_sequences(100, 0, 300, 5);
+  SeedSets seeds(sources, {{30, 10}, {12, 6}});
+  std::stringstream stream;
+  {
+    cereal::BinaryOutputArchive archive(stream);
+    archive(seeds);
+  }
+  SeedSets loaded;
+  {
+    cereal::BinaryInputArchive archive(stream);
+    archive(loaded);
+  }
+  CHECK(loaded == seeds);
+
+  SeedSets single(sources, {{20, 5}});
+  SeedSetView set = single[0];
+  SeedSetsVersion1 old{set.windowing(), sources, set.windows()};
+  std::stringstream old_stream;
+  {
+    cereal::BinaryOutputArchive archive(old_stream);
+    archive(old);
+  }
+  SeedSets loaded_old;
+  {
+    cereal::BinaryInputArchive archive(old_stream);
+    archive(loaded_old);
+  }
+  CHECK(loaded_old == single);
+}
+
+
+// Whether loading bytes as SeedSets ends the program.
+bool load_fails(const std::string& bytes) {
+  return ends_program([&bytes] {
+    std::istringstream stream(bytes);
+    cereal::BinaryInputArchive archive(stream);
+    SeedSets seeds;
+    archive(seeds);
+  });
+}
+
+
+void test_bad_windows() {
+  SequenceStore sources = random_sequences(20, 40, 100, 6);
+  SeedSets seeds(sources, {{30, 10}, {12, 6}});
+  std::ostringstream stream;
+  {
+    cereal::BinaryOutputArchive archive(stream);
+    archive(seeds);
+  }
+  std::string good = stream.str();
+  CHECK(!load_fails(good));
+  // The last set's last window ends the archive.
+  size_t last = good.size() - sizeof(SeedWindow);
+  SeedWindow window;
+  memcpy(&window, good.data() + last, sizeof(window));
+  size_t size = sources[window.source].size;
+  for (SeedWindow bad: {SeedWindow{20, 0}, SeedWindow{~uint32_t(0), 0},
+                        SeedWindow{window.source,
+                                   static_cast<uint32_t>(size - 11)},
+                        SeedWindow{window.source, ~uint32_t(0)}}) {
+    std::string damaged = good;
+    memcpy(&damaged[last], &bad, sizeof(bad));
+    CHECK(load_fails(damaged));
+  }
+  // A window that ends exactly at the end of its sequence is fine.
+  SeedWindow edge{window.source, static_cast<uint32_t>(size - 12)};
+  std::string edged = good;
+  memcpy(&edged[last], &edge, sizeof(edge));
+  CHECK(!load_fails(edged));
+
+  SeedSetsVersion1 old{{20, 5}, sources, {{0, 0}, {3, 81}}};
+  std::ostringstream old_stream;
+  {
+    cereal::BinaryOutputArchive archive(old_stream);
+    archive(old);
+  }
+  CHECK(load_fails(old_stream.str()));
+}
+
+
+// --seed-windows cuts every set from the same seed sequences, into the
+// cereal archive, a container and one .npy of windows per set.
+void test_encoder_runs(const std::string& encoder, const std::string& input) {
+  std::vector<SeedWindowing> windowings{{8, 4}, {12, 6}, {30, 10}};
+  HeaderStore headers;
+  SequenceStore sources;
+  load_fasta_sequences(input + "/initial.fasta", headers, sources);
+  SeedSets expected(sources, windowings);
+
+  std::string dir = encoder_run_dir("seed_windows_test.run", input);
+  CHECK(run_encoder(encoder, dir,
+                    "--seed-windows 8:4,12:6,30:10 --npy") == 0);
+  SeedSets loaded;
+  {
+    std::ifstream file(dir + "/output/seed_seq_binary",
+                       std::ios_base::binary);
+    cereal::BinaryInputArchive archive(file);
+    archive(loaded);
+  }
+  CHECK(loaded == expected);
+  for (size_t s = 0; s < windowings.size(); s++) {
+    CHECK(loaded[s].windowing().length == windowings[s].length);
+    CHECK(loaded[s].windowing().stride == windowings[s].stride);
+    CHECK(std::filesystem::exists(dir + "/output/seed_windows_" +
+                                  loaded[s].label() + ".npy"));
+  }
+  CHECK(loaded[0].label() == "w8s4");
+
+  CHECK(run_encoder(encoder, dir,
+                    "--format container --seed-windows 8:4,12:6,30:10") == 0);
+  std::string path = dir + "/output/converge_container";
+  MappedContainer container(path);
+  CHECK(container.seed_set_count() == windowings.size());
+  CHECK(container.manifest_value("seed_sets") == "w8s4,w12s6,w30s10");
+  CHECK(container.manifest_value("seed_length") == "8");
+  converge_encoder::Reader reader(path.c_str());
+  CHECK(reader.seed_set_count() == windowings.size());
+  for (size_t s = 0; s < windowings.size(); s++) {
+    SeedView view = container.seeds(s);
+    converge_encoder::SeedSetView read = reader.seeds(s);
+    CHECK(view.length == windowings[s].length);
+    CHECK(view.stride == windowings[s].stride);
+    CHECK(read.window_length() == windowings[s].length);
+    CHECK(view.size() == expected[s].size() &&
+          read.size() == expected[s].size());
+    for (size_t i = 0; i < view.size(); i++) {
+      CHECK(memcmp(&view.windows[i], &expected[s].windows()[i],
+                   sizeof(SeedWindow)) == 0);
+      CHECK(memcmp(view[i].data, expected[s][i].data, view.length) == 0);
+      CHECK(memcmp(read[i].data(), expected[s][i].data, view.length) == 0);
+    }
+  }
+  CHECK(ends_program([&path] { MappedContainer(path).seeds(3); }));
+  CHECK(ends_program([&path] {
+    converge_encoder::Reader(path.c_str()).seeds(3);
+  }));
+
+  // Each set is asked for once.
+  CHECK(run_encoder(encoder, dir, "--seed-windows 8:4,12:6,8:4") != 0);
+  std::filesystem::remove_all(dir);
+}
+
+
+int main(int argc, char** argv) {
+  CHECK(argc == 3);
+  test_windows();
+  test_archives();
+  test_bad_windows();
+  test_encoder_runs(argv[1], argv[2]);
+  return 0;
+}
@@ -0,0 +1,278 @@
+// SequenceStore: building and editing the CSR layout, its archives, and the
+// layouts from before the class version.
+
+#include <cstdint>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <cereal/archives/binary.hpp>
+#include <cereal/types/vector.hpp>
+
+#include "residue_encoder.hpp"
+#include "residue_packing.hpp"
+#include "sequence_store.hpp"
+#include "test_support.hpp"
+
+
+// Writes what SequenceStore wrote as class version 1.
+struct SequenceStoreVersion1 {
+  std::vector<uint64_t> offsets;
+  std::vector<Residue> residues;
+
+  template <class Archive>
+  void save(Archive& archive, const uint32_t /*version*/) const {
+    archive(offsets, residues);
+  }
+};
+
+CEREAL_CLASS_VERSION(SequenceStoreVersion1, 1)
+
+
+SequenceStore round_trip(const SequenceStore& sequences) {
+  std::stringstream stream;
+  {
+    cereal::BinaryOutputArchive archive(stream);
+    archive(sequences);
+  }
+  SequenceStore loaded;
+  cereal::BinaryInputArchive archive(stream);
+  archive(loaded);
+  return loaded;
+}
+
+
+std::vector<Residue> residues_of(ResidueSpan seq) {
+  return std::vector<Residue>(seq.begin(), seq.end());
+}
+
+
+void test_layout() {
+  SequenceStore sequences;
+  CHECK(sequences.size() == 0 && sequences.offsets().size() == 1);
+  Residue first[] = {1, 2, 3};
+  sequences.push_back(first, 3);
+  sequences.end_sequence();
+  sequences.append_residues(first, 2);
+  sequences.append_residues(first + 2, 1);
+  sequences.end_sequence();
+  Residue* fixed = sequences.append_fixed(2, 2);
+  for (Residue i = 0; i < 4; i++) {
+    fixed[i] = 4 + i;
+  }
+  CHECK(sequences.size() == 5 && sequences.total_residues() == 10);
+  CHECK(sequences.offsets() == std::vector<uint64_t>({0, 3, 3, 6, 8, 10}));
+  CHECK(sequences[1].size == 0);
+  CHECK(residues_of(sequences[2]) == std::vector<Residue>({1, 2, 3}));
+  CHECK(residues_of(sequences[4]) == std::vector<Residue>({6, 7}));
+
+  SequenceStore more = random_sequences(30, 0, 50, 4);
+  SequenceStore joined = sequences;
+  joined.append(more);
+  CHECK(joined.size() == sequences.size() + more.size());
+  CHECK(joined.slice(0, sequences.size()) == sequences);
+  CHECK(joined.slice(sequences.size(), more.size()) == more);
+  CHECK(joined.slice(7, 0).size() == 0);
+
+  std::vector<bool> keep(joined.size());
+  SequenceStore expected;
+  for (size_t i = 0; i < joined.size(); i++) {
+    keep[i] = i % 3 != 1;
+    if (keep[i]) {
+      expected.push_back(joined[i]);
+    }
+  }
+  joined.compact(keep);
+  CHECK(joined == expected);
+  joined.compact(std::vector<bool>(joined.size(), false));
+  CHECK(joined.size() == 0 && joined.total_residues() == 0);
+}
+
+
+void test_archive() {
+  SequenceStore sequences = random_sequences(300, 0, 500, 1);
+  CHECK(round_trip(sequences) == sequences);
+  CHECK(round_trip(SequenceStore()) == SequenceStore());
+}
+
+
+// Whether loading the archive ends the program, as a corrupt one must.
+bool load_fails(const std::string& bytes) {
+  return ends_program([&bytes] {
+    std::istringstream stream(bytes);
+    cereal::BinaryInputArchive archive(stream);
+    SequenceStore loaded;
+    archive(loaded);
+  });
+}
+
+
+void test_version1() {
+  SequenceStore sequences = random_sequences(50, 0, 200, 2);
+  SequenceStoreVersion1 old{sequences.offsets(), sequences.residues()};
+  std::stringstream stream;
+  {
+    cereal::BinaryOutputArchive archive(stream);
+    archive(old);
+  }
+  SequenceStore loaded;
+  cereal::BinaryInputArchive archive(stream);
+  archive(loaded);
+  CHECK(loaded == sequences);
+  CHECK(loaded.encoding() == ResidueEncoding::kBytes);
+}
+
+
+// Offsets that do not match the residues, in either archive version.
+void test_corrupt() {
+  SequenceStore sequences = random_sequences(20, 1, 50, 5);
+  std::vector<std::vector<uint64_t>> bad_offsets = {
+    {}, {1, sequences.total_residues()}, {0, 10, 5, sequences.total_residues()},
+    {0, sequences.total_residues() - 1}, {0, sequences.total_residues() + 1}};
+  for (const std::vector<uint64_t>& offsets: bad_offsets) {
+    std::ostringstream version1;
+    {
+      cereal::BinaryOutputArchive archive(version1);
+      archive(SequenceStoreVersion1{offsets, sequences.residues()});
+    }
+    CHECK(load_fails(version1.str()));
+    std::ostringstream version2;
+    {
+      cereal::BinaryOutputArchive archive(version2);
+      archive(kSequenceStoreVersion, uint8_t(ResidueEncoding::kBytes),
+              offsets, sequences.residues());
+    }
+    CHECK(load_fails(version2.str()));
+  }
+  std::ostringstream good;
+  {
+    cereal::BinaryOutputArchive archive(good);
+    archive(SequenceStoreVersion1{sequences.offsets(), sequences.residues()});
+  }
+  CHECK(!load_fails(good.str()));
+}
+
+
+// Every kernel against the bit layout: code j of a group of 8 in bits
+// [5j, 5j + 5) of 5 little-endian bytes.
+void test_packing() {
+  std::mt19937 rng(6);
+  std::vector<uint8_t> codes(300);
+  for (uint8_t& code: codes) {
+    code = static_cast<uint8_t>(rng() % kAlphabet.size());
+  }
+  for (size_t n = 0; n <= codes.size(); n++) {
+    std::vector<uint8_t> packed(packed_size(n) + 1, 0xAA);
+    pack_residues(codes.data(), n, packed.data());
+    CHECK(packed_size(n) == (5 * n + 7) / 8 && packed.back() == 0xAA);
+    for (size_t i = 0; i < n; i++) {
+      size_t bit = 5 * i;
+      unsigned word = packed[bit / 8] | (bit / 8 + 1 < packed_size(n) ?
+                                         packed[bit / 8 + 1] << 8 : 0);
+      CHECK((word >> bit % 8 & 31) == codes[i]);
+    }
+    for (EncoderIsa isa: {EncoderIsa::kScalar, EncoderIsa::kSse42,
+                          EncoderIsa::kAvx2, EncoderIsa::kAvx512}) {
+      if (!encoder_isa_supported(isa)) {
+        continue;
+      }
+      std::vector<uint8_t> unpacked(n + 1, 0xAA);
+      unpack_residues(isa, packed.data(), n, unpacked.data());
+      CHECK(std::vector<uint8_t>(unpacked.begin(), unpacked.begin() + n) ==
+            std::vector<uint8_t>(codes.begin(), codes.begin() + n));
+      CHECK(unpacked[n] == 0xAA);
+    }
+  }
+
+  SequenceStore sequences = random_sequences(300, 0, 500, 7);
+  sequences.set_encoding(ResidueEncoding::kPacked);
+  SequenceStore loaded = round_trip(sequences);
+  CHECK(loaded == sequences);
+  CHECK(loaded.encoding() == ResidueEncoding::kPacked);
+
+  // Too few packed bytes for the offsets, and offsets that are not offsets.
+  uint64_t total = sequences.total_residues();
+  std::vector<uint8_t> packed(packed_size(total));
+  pack_residues(sequences.residues().data(), total, packed.data());
+  auto packed_archive = [](const std::vector<uint64_t>& offsets,
+                           const std::vector<uint8_t>& bytes) {
+    std::ostringstream stream;
+    {
+      cereal::BinaryOutputArchive archive(stream);
+      archive(kSequenceStoreVersion, uint8_t(ResidueEncoding::kPacked),
+              offsets, bytes);
+    }
+    return stream.str();
+  };
+  CHECK(!load_fails(packed_archive(sequences.offsets(), packed)));
+  CHECK(load_fails(packed_archive({0, total + 8}, packed)));
+  CHECK(load_fails(packed_archive({}, packed)));
+  CHECK(load_fails(packed_archive({3, total}, packed)));
+  CHECK(load_fails(packed_archive({0, total, total - 1}, packed)));
+  packed.pop_back();
+  CHECK(load_fails(packed_archive(sequences.offsets(), packed)));
+}
+
+
+// Several rANS blocks, the last one partial, loaded on the default thread
+// count and on a set one.
+void test_rans() {
+  SequenceStore sequences = random_sequences(600, 0, 1000, 1);
+  CHECK(sequences.total_residues() > 4 * kRansBlockResidues);
+  CHECK(sequences.num_threads() == 0);
+  sequences.set_encoding(ResidueEncoding::kRans);
+  for (size_t threads: {0, 1, 4}) {
+    sequences.set_num_threads(threads);
+    SequenceStore loaded = round_trip(sequences);
+    CHECK(loaded == sequences);
+    CHECK(loaded.encoding() == ResidueEncoding::kRans);
+  }
+  SequenceStore empty;
+  empty.set_encoding(ResidueEncoding::kRans);
+  CHECK(round_trip(empty) == empty);
+
+  std::ostringstream no_offsets;
+  {
+    cereal::BinaryOutputArchive archive(no_offsets);
+    archive(kSequenceStoreVersion, uint8_t(ResidueEncoding::kRans),
+            std::vector<uint64_t>(), compress_residues(nullptr, 0));
+  }
+  CHECK(load_fails(no_offsets.str()));
+}
+
+
+void test_legacy() {
+  SequenceStore sequences = random_sequences(50, 0, 200, 3);
+  std::vector<std::vector<int>> nested;
+  std::vector<int> flat;
+  for (size_t i = 0; i < sequences.size(); i++) {
+    ResidueSpan seq = sequences[i];
+    nested.emplace_back(seq.begin(), seq.end());
+    flat.insert(flat.end(), seq.begin(), seq.end());
+  }
+  std::stringstream stream;
+  {
+    cereal::BinaryOutputArchive archive(stream);
+    archive(nested, sequences.offsets(), flat);
+  }
+  SequenceStore from_nested;
+  SequenceStore from_flat;
+  cereal::BinaryInputArchive archive(stream);
+  from_nested.load_legacy(archive, LegacyLayout::kNested);
+  from_flat.load_legacy(archive, LegacyLayout::kFlat);
+  CHECK(from_nested == sequences);
+  CHECK(from_flat == sequences);
+}
+
+
+int main() {
+  test_layout();
+  test_archive();
+  test_version1();
+  test_corrupt();
+  test_packing();
+  test_rans();
+  test_legacy();
+  return 0;
+}
@@ -0,0 +1,147 @@
+// Residue-balanced shards: the cuts, the shard manifest, and sharded runs
+// of the encoder.
+
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "container.hpp"
+#include "sequence_store.hpp"
+#include "shards.hpp"
+#include "test_support.hpp"
+
+
+// The shards cover the sequences in order, and every cut is a sequence
+// boundary at least as close to its share of the residues as any other.
+void check_partition(const SequenceStore& sequences, size_t num_shards) {
+  std::vector<ShardRange> shards =
+    partition_by_residues(sequences, num_shards);
+  CHECK(shards.size() == num_shards);
+  const std::vector<uint64_t>& offsets = sequences.offsets();
+  uint64_t total = sequences.total_residues();
+  uint64_t next = 0;
+  for (size_t k = 0; k < shards.size(); k++) {
+    CHECK(shards[k].first == next);
+    next += shards[k].count;
+    CHECK(shards[k].residues ==
+          offsets[shards[k].first + shards[k].count] -
+          offsets[shards[k].first]);
+    CHECK(shards[k].file.empty());
+    if (k == 0) {
+      continue;
+    }
+    auto target = static_cast<int64_t>(
+      static_cast<long double>(total) * k / num_shards);
+    int64_t distance = std::llabs(
+      static_cast<int64_t>(offsets[shards[k].first]) - target);
+    for (uint64_t offset: offsets) {
+      CHECK(distance <= std::llabs(static_cast<int64_t>(offset) - target));
+    }
+  }
+  CHECK(next == sequences.size());
+}
+
+
+void test_partition() {
+  SequenceStore sequences = random_sequences(1000, 0, 800, 19);
+  for (size_t num_shards: {1, 2, 3, 7, 16, 100}) {
+    check_partition(sequences, num_shards);
+  }
+  // Balance: no shard is off its share by more than the longest sequence.
+  std::vector<ShardRange> shards = partition_by_residues(sequences, 7);
+  for (const ShardRange& shard: shards) {
+    int64_t share = static_cast<int64_t>(sequences.total_residues() / 7);
+    CHECK(std::llabs(static_cast<int64_t>(shard.residues) - share) <= 1600);
+  }
+
+  // More shards than sequences leaves some empty, never out of range.
+  SequenceStore few = random_sequences(3, 10, 20, 20);
+  check_partition(few, 8);
+  check_partition(SequenceStore(), 4);
+
+  // One sequence outweighs the rest: it gets a shard, the others share
+  // what is left, and shards past it are empty.
+  SequenceStore giant = random_sequences(5, 10, 10, 21);
+  giant.append(random_sequences(1, 100000, 100000, 22));
+  giant.append(random_sequences(5, 10, 10, 23));
+  check_partition(giant, 4);
+  shards = partition_by_residues(giant, 4);
+  size_t holding = 0;
+  for (const ShardRange& shard: shards) {
+    if (shard.first <= 5 && 5 < shard.first + shard.count) {
+      holding++;
+      CHECK(shard.residues >= 100000);
+    }
+  }
+  CHECK(holding == 1);
+}
+
+
+void test_manifest() {
+  std::vector<ShardRange> shards = partition_by_residues(
+    random_sequences(50, 0, 100, 24), 3);
+  for (size_t k = 0; k < shards.size(); k++) {
+    shards[k].file = "proteome_binary." + std::to_string(k);
+  }
+  write_shard_manifest("shards_test.manifest", shards);
+  std::vector<ShardRange> read = read_shard_manifest("shards_test.manifest");
+  CHECK(read.size() == shards.size());
+  for (size_t k = 0; k < shards.size(); k++) {
+    CHECK(read[k].file == shards[k].file && read[k].first == shards[k].first &&
+          read[k].count == shards[k].count &&
+          read[k].residues == shards[k].residues);
+  }
+  std::filesystem::remove("shards_test.manifest");
+}
+
+
+// Fewer shards than the last run leave no stale shard behind, an unsharded
+// run none at all, and the shared container does not claim the sequences.
+void test_runs(const std::string& encoder, const std::string& input) {
+  namespace fs = std::filesystem;
+  std::string dir = encoder_run_dir("shards_test.run", input);
+  std::string output = dir + "/output/";
+  CHECK(run_encoder(encoder, dir, "--shards 4") == 0);
+  for (int k = 0; k < 4; k++) {
+    CHECK(fs::exists(output + "proteome_binary." + std::to_string(k)));
+  }
+  CHECK(read_shard_manifest(output + "proteome_shards").size() == 4);
+  CHECK(run_encoder(encoder, dir, "--shards 2") == 0);
+  CHECK(fs::exists(output + "proteome_binary.1"));
+  CHECK(!fs::exists(output + "proteome_binary.2"));
+  CHECK(!fs::exists(output + "proteome_binary.3"));
+  CHECK(read_shard_manifest(output + "proteome_shards").size() == 2);
+  CHECK(run_encoder(encoder, dir, "--verify") == 0);
+  CHECK(run_encoder(encoder, dir, "") == 0);
+  CHECK(!fs::exists(output + "proteome_binary.0"));
+  CHECK(!fs::exists(output + "proteome_shards"));
+
+  CHECK(run_encoder(encoder, dir, "--format container --shards 3") == 0);
+  {
+    MappedContainer container(output + "converge_container");
+    CHECK(!container.has_section(SectionId::kSequenceOffsets));
+    CHECK(container.manifest_value("shards") == "3");
+    CHECK(container.manifest_value("shard_manifest") == "proteome_shards");
+    for (const auto& entry: container.manifest()) {
+      CHECK(entry.first != "sequences");
+    }
+    MappedContainer shard(output + "converge_container.2");
+    CHECK(shard.manifest_value("shard") == "2");
+  }
+  CHECK(run_encoder(encoder, dir, "--format container") == 0);
+  CHECK(!fs::exists(output + "converge_container.0"));
+  CHECK(MappedContainer(output + "converge_container")
+          .manifest_value("sequences") != "0");
+  fs::remove_all(dir);
+}
+
+
+int main(int argc, char** argv) {
+  CHECK(argc == 3);
+  test_partition();
+  test_manifest();
+  test_runs(argv[1], argv[2]);
+  return 0;
+}
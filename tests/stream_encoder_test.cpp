@@ -0,0 +1,90 @@
+// The streaming encoder writes byte for byte what the in-memory path
+// writes: a cereal SequenceStore archive and header container, or the same
+// container sections, and the same .fai index, whatever the buffer size.
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <cereal/archives/binary.hpp>
+#include <cereal/types/vector.hpp>
+
+#include "container.hpp"
+#include "crc32c.hpp"
+#include "fasta_index.hpp"
+#include "fasta_parser.hpp"
+#include "header_store.hpp"
+#include "sequence_store.hpp"
+#include "stream_encoder.hpp"
+#include "test_support.hpp"
+
+
+int main() {
+  write_file("stream_encoder_test.fasta", random_fasta(400, 0, 15));
+  HeaderStore headers;
+  SequenceStore sequences;
+  std::vector<FaiEntry> index;
+  load_fasta_sequences("stream_encoder_test.fasta", headers, sequences, 1,
+                       &index);
+  std::ostringstream archive_stream;
+  {
+    cereal::BinaryOutputArchive archive(archive_stream);
+    archive(sequences);
+  }
+  std::string archive = archive_stream.str();
+  write_header_container("stream_encoder_test.headers", headers);
+  std::string header_container = read_file("stream_encoder_test.headers");
+  write_fasta_index("stream_encoder_test.fai", index);
+  std::string fai = read_file("stream_encoder_test.fai");
+  {
+    ContainerWriter container("stream_encoder_test.container");
+    container.add_sequences(SectionId::kSequenceOffsets, SectionId::kResidues,
+                            sequences);
+    container.add_headers(headers);
+    container.close();
+  }
+  std::string container = read_file("stream_encoder_test.container");
+
+  // The smallest buffer splits records, headers and lines across chunks.
+  for (size_t buffer_size: {size_t(1), size_t(100000), size_t(64) << 20}) {
+    uint32_t checksum = 0;
+    size_t records = stream_encode_fasta("stream_encoder_test.fasta",
+      "stream_encoder_test.streamed", "stream_encoder_test.streamed_headers",
+      buffer_size, 1, "stream_encoder_test.streamed_fai", &checksum);
+    CHECK(records == sequences.size());
+    std::string streamed = read_file("stream_encoder_test.streamed");
+    CHECK(streamed == archive);
+    CHECK(checksum == crc32c(streamed.data(), streamed.size()));
+    CHECK(read_file("stream_encoder_test.streamed_headers") ==
+          header_container);
+    CHECK(read_file("stream_encoder_test.streamed_fai") == fai);
+
+    {
+      ContainerWriter streamed_container(
+        "stream_encoder_test.streamed_container");
+      stream_encode_fasta("stream_encoder_test.fasta", streamed_container,
+                          buffer_size);
+      streamed_container.close();
+    }
+    CHECK(read_file("stream_encoder_test.streamed_container") == container);
+  }
+
+  // And what it writes loads back as the sequences.
+  SequenceStore loaded;
+  {
+    std::ifstream file("stream_encoder_test.streamed",
+                       std::ios_base::binary);
+    cereal::BinaryInputArchive input(file);
+    input(loaded);
+  }
+  CHECK(loaded == sequences);
+  for (const char* name: {"fasta", "headers", "fai", "container", "streamed",
+                          "streamed_headers", "streamed_fai",
+                          "streamed_container"}) {
+    std::remove((std::string("stream_encoder_test.") + name).c_str());
+  }
+  return 0;
+}
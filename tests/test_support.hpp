@@ -0,0 +1,136 @@
+#ifndef CONVERGE_ENCODER_TEST_SUPPORT_HPP_
+#define CONVERGE_ENCODER_TEST_SUPPORT_HPP_
+
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "residue_encoder.hpp"
+#include "sequence_store.hpp"
+
+// Each test is a plain executable run by ctest; the first check that does
+// not hold ends it with a failure.
+#define CHECK(condition)                                                   \
+  do {                                                                     \
+    if (!(condition)) {                                                    \
+      std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #condition    \
+                << ") failed" << std::endl;                                \
+      std::exit(1);                                                        \
+    }                                                                      \
+  } while (0)
+
+
+// count sequences of random residues, of length min_length to max_length.
+inline SequenceStore random_sequences(size_t count, size_t min_length,
+  size_t max_length, unsigned seed) {
+  std::mt19937 rng(seed);
+  std::uniform_int_distribution<int> letter(0, kAlphabet.size() - 1);
+  std::uniform_int_distribution<size_t> length(min_length, max_length);
+  SequenceStore sequences;
+  std::vector<Residue> seq;
+  for (size_t i = 0; i < count; i++) {
+    seq.resize(length(rng));
+    for (Residue& residue: seq) {
+      residue = static_cast<Residue>(letter(rng));
+    }
+    sequences.push_back(seq.data(), seq.size());
+  }
+  return sequences;
+}
+
+
+// FASTA text of count UniProt-style records (accession P<first + i>) with
+// random bodies wrapped at varying widths, some letters outside the
+// alphabet, and an empty record now and then.
+inline std::string random_fasta(size_t count, size_t first, unsigned seed) {
+  std::mt19937 rng(seed);
+  std::uniform_int_distribution<int> letter(0, kAlphabet.size() - 1);
+  std::uniform_int_distribution<size_t> length(0, 400);
+  std::uniform_int_distribution<size_t> width(1, 80);
+  std::uniform_int_distribution<int> percent(0, 99);
+  std::string text;
+  for (size_t i = 0; i < count; i++) {
+    std::string accession = "P" + std::to_string(first + i);
+    text += ">sp|" + accession + "|" + accession + "_HUMAN Protein " +
+            std::to_string(i) + "\n";
+    size_t size = percent(rng) < 3 ? 0 : length(rng);
+    size_t line = width(rng);
+    for (size_t j = 0; j < size; j++) {
+      text += percent(rng) < 2 ? 'X' : kAlphabet[letter(rng)];
+      if ((j + 1) % line == 0 || j + 1 == size) {
+        text += '\n';
+      }
+    }
+  }
+  return text;
+}
+
+
+inline std::string read_file(const std::string& filename) {
+  std::ifstream file(filename, std::ios_base::binary);
+  CHECK(file.is_open());
+  return std::string(std::istreambuf_iterator<char>(file),
+                     std::istreambuf_iterator<char>());
+}
+
+
+inline void write_file(const std::string& filename, const std::string& data) {
+  std::ofstream file(filename, std::ios_base::binary);
+  CHECK(file.is_open());
+  file.write(data.data(), static_cast<std::streamsize>(data.size()));
+}
+
+
+// A fresh directory laid out the way the encoder expects: the files of
+// input_dir copied into input/ and an empty output/.
+inline std::string encoder_run_dir(const std::string& name,
+  const std::string& input_dir) {
+  namespace fs = std::filesystem;
+  fs::remove_all(name);
+  fs::create_directories(name + "/output");
+  fs::copy(input_dir, name + "/input", fs::copy_options::recursive);
+  return name;
+}
+
+
+// Runs the encoder in dir with args and returns its exit status; its
+// output goes to dir/log.
+inline int run_encoder(const std::string& encoder, const std::string& dir,
+  const std::string& args) {
+  std::string command = "cd '" + dir + "' && '" + encoder + "' " + args +
+                        " > log 2>&1";
+  int status = std::system(command.c_str());
+  CHECK(status != -1 && WIFEXITED(status));
+  return WEXITSTATUS(status);
+}
+
+
+
+// Runs f in a child process and returns whether it ended the program, as
+// the encoder does on corrupt input. Its messages are discarded.
+template <class F>
+bool ends_program(F f) {
+  pid_t child = fork();
+  CHECK(child >= 0);
+  if (child == 0) {
+    std::freopen("/dev/null", "w", stderr);
+    std::freopen("/dev/null", "w", stdout);
+    f();
+    _exit(0);
+  }
+  int status;
+  CHECK(waitpid(child, &status, 0) == child);
+  return !(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+}
+
+#endif  // CONVERGE_ENCODER_TEST_SUPPORT_HPP_